@@ -0,0 +1,196 @@
+import json
+import os
+import queue
+import re
+import shutil
+import tempfile
+import threading
+import time
+
+from gpt_generate import generate_code, strip_markdown_fence
+from executor import DagExecutor, Task
+from pipeline import build_stages, CHECKPATCH_PATH
+from results_store import compact
+
+WORK_ROOT = "batch_work"
+
+# Manifest keys accepted for each job, in order of preference
+ID_KEYS = ("id", "request_id")
+SOURCE_KEYS = ("source", "source_path")
+PROMPT_KEYS = ("prompt", "body")
+
+# Queued by the manifest producer after its last job
+_END = object()
+
+
+def read_manifest(manifest_path: str):
+    # Lazily yield one job per non-empty line so huge manifests stay cheap
+    with open(manifest_path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            entry = json.loads(line)
+            job = {"id": next((str(entry[k]) for k in ID_KEYS if k in entry), f"job-{lineno}")}
+            source = next((entry[k] for k in SOURCE_KEYS if k in entry), None)
+            prompt = next((entry[k] for k in PROMPT_KEYS if k in entry), None)
+            if "model" in entry:
+                job["model"] = str(entry["model"])
+            if source is not None:
+                job["source"] = os.path.abspath(os.path.join(os.path.dirname(manifest_path), source))
+            elif prompt is not None:
+                job["prompt"] = prompt
+            else:
+                raise ValueError(f"{manifest_path}:{lineno}: entry has no prompt or source")
+            yield job
+
+
+def _prepare_source(job: dict, scratch: str, generate=generate_code) -> str:
+    driver_path = os.path.join(scratch, "driver.c")
+    if "source" in job:
+        shutil.copyfile(job["source"], driver_path)
+    else:
+        # "response" is set when the LLM client generated the code ahead of time
+        response = job["response"] if "response" in job else generate(job["prompt"])
+        with open(driver_path, "w") as f:
+            f.write(strip_markdown_fence(response))
+    return driver_path
+
+
+def job_tasks(job: dict, scratch: str, checkpatch_path: str = CHECKPATCH_PATH, cache=None,
+              kbuild=None, generate=generate_code, policy=None, qemu=None, tools=None) -> list:
+    driver_path = os.path.join(scratch, "driver.c")
+    tasks = build_stages(driver_path, checkpatch_path, cache=cache, kbuild=kbuild, policy=policy,
+                         qemu=qemu, tools=tools)
+    # Every root stage waits for the driver source to land in the scratch dir
+    for task in tasks:
+        if not task.deps:
+            task.deps = ("prepare",)
+    return [Task("prepare", lambda ctx: _prepare_source(job, scratch, generate))] + tasks
+
+
+def _job_record(job: dict, elapsed: float, results: dict = None, error: Exception = None) -> dict:
+    record = {"id": job["id"], "wall_seconds": elapsed}
+    if "source" in job:
+        record["source"] = job["source"]
+    if error is not None:
+        record["error"] = f"{type(error).__name__}: {error}"
+        return record
+    record["overall_score"] = results["score"]["overall_score"]
+    record["result"] = results["score"]
+    return record
+
+
+def run_batch(manifest_path: str, output_path: str, jobs: int = None,
+              max_inflight: int = None, work_root: str = WORK_ROOT,
+              checkpatch_path: str = CHECKPATCH_PATH, keep_scratch: bool = False,
+              cache=None, kbuild=None, generate=generate_code, llm=None, policy=None,
+              qemu=None, tools=None, store=None, model: str = "unknown") -> int:
+    # With an llm client (llm_client.LLMClient), a producer thread sends prompts
+    # to it as the manifest is read and each driver is queued for evaluation as
+    # soon as its response arrives, so generation overlaps with evaluation.
+    # Without one, generate(prompt) runs inside the job's "prepare" stage.
+    # With a store (results_store.ResultsStore), every result is saved there
+    # under the manifest's "model" (or model) and the output file gets the
+    # record with raw tool output replaced by references into the store.
+    executor = DagExecutor(jobs)
+    # Bound the number of drivers (pending responses, scratch dirs, results)
+    # alive at once
+    max_inflight = max_inflight or executor.max_workers * 4
+    slots = threading.BoundedSemaphore(max_inflight)
+    write_lock = threading.Lock()
+    ready = queue.Queue()
+    stop = threading.Event()
+    checkpatch_path = os.path.abspath(checkpatch_path)
+    os.makedirs(work_root, exist_ok=True)
+    completed = 0
+
+    def produce():
+        submitted = 0
+        error = None
+        try:
+            for job in read_manifest(manifest_path):
+                slots.acquire()
+                if stop.is_set():
+                    break
+                submitted += 1
+                started = time.monotonic()
+                if "prompt" in job and llm is not None:
+                    llm.submit(job["prompt"]).add_done_callback(
+                        lambda f, job=job, started=started: ready.put((job, started, f)))
+                else:
+                    ready.put((job, started, None))
+        except Exception as exc:
+            error = exc
+        ready.put((_END, submitted, error))
+
+    with open(output_path, "w") as out:
+        def finish(job, started, scratch=None, future=None, error=None):
+            nonlocal completed
+            elapsed = time.monotonic() - started
+            results = None
+            try:
+                if error is not None:
+                    raise error
+                results = future.result()
+                record = _job_record(job, elapsed, results=results)
+            except Exception as exc:
+                record = _job_record(job, elapsed, error=exc)
+            # This runs in a done-callback, where an exception would be
+            # swallowed; the slot must come back whatever happens or
+            # run_batch waits for it forever
+            try:
+                if store is not None:
+                    driver_path = os.path.join(scratch, "driver.c") if scratch is not None else None
+                    try:
+                        record["evaluation_id"] = store.add(job["id"], results, job.get("model", model),
+                                                            driver_path, elapsed, record.get("error"),
+                                                            job.get("source"))
+                        record = compact(record, driver_path)
+                    except Exception as exc:
+                        record["store_error"] = f"{type(exc).__name__}: {exc}"
+                # Stream each result as soon as its graph completes
+                with write_lock:
+                    out.write(json.dumps(record) + "\n")
+                    out.flush()
+                    completed += 1
+            finally:
+                if scratch is not None and not keep_scratch:
+                    shutil.rmtree(scratch, ignore_errors=True)
+                slots.release()
+
+        threading.Thread(target=produce, name="batch-producer", daemon=True).start()
+        try:
+            expected = None
+            received = 0
+            error = None
+            while expected is None or received < expected:
+                job, started, generation = ready.get()
+                if job is _END:
+                    expected, error = started, generation
+                    continue
+                received += 1
+                if generation is not None:
+                    try:
+                        job["response"] = generation.result()
+                    except Exception as exc:
+                        finish(job, started, error=exc)
+                        continue
+                prefix = re.sub(r'[^\w.-]', '_', job["id"]) + "-"
+                scratch = tempfile.mkdtemp(prefix=prefix, dir=work_root)
+                future = executor.submit_graph(
+                    job_tasks(job, scratch, checkpatch_path, cache, kbuild, generate, policy, qemu, tools))
+                future.add_done_callback(
+                    lambda f, job=job, scratch=scratch, started=started: finish(job, started, scratch, f))
+            # Wait for the tail of the corpus to drain
+            for _ in range(max_inflight):
+                slots.acquire()
+            if error is not None:
+                raise error
+        except KeyboardInterrupt:
+            stop.set()
+            executor.cancel()
+            raise
+        finally:
+            executor.shutdown()
+    return completed
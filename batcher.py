@@ -0,0 +1,75 @@
+import threading
+import time
+from concurrent.futures import Future
+
+
+class MicroBatcher:
+    # Collects items submitted from many threads and hands them to
+    # flush_fn(items) -> results in batches. A batch is flushed when it
+    # reaches max_batch items or when its oldest item has waited linger
+    # seconds, whichever comes first. Each batch runs on its own thread so
+    # the next one can fill up meanwhile.
+
+    def __init__(self, flush_fn, max_batch: int = 32, linger: float = 0.2, name: str = "batch"):
+        self.flush_fn = flush_fn
+        self.max_batch = max_batch
+        self.linger = linger
+        self.name = name
+        self._items = []
+        self._first_at = None
+        self._cond = threading.Condition()
+        self._closed = False
+        self._thread = threading.Thread(target=self._loop, daemon=True, name=f"{name}-batcher")
+        self._thread.start()
+
+    def submit(self, item) -> Future:
+        future = Future()
+        with self._cond:
+            if self._closed:
+                raise RuntimeError(f"{self.name} batcher is closed")
+            if not self._items:
+                self._first_at = time.monotonic()
+            self._items.append((item, future))
+            self._cond.notify()
+        return future
+
+    def _take_batch(self):
+        with self._cond:
+            while True:
+                if self._items:
+                    waited = time.monotonic() - self._first_at
+                    if len(self._items) >= self.max_batch or waited >= self.linger or self._closed:
+                        batch = self._items[:self.max_batch]
+                        self._items = self._items[self.max_batch:]
+                        self._first_at = time.monotonic() if self._items else None
+                        return batch
+                    self._cond.wait(self.linger - waited)
+                elif self._closed:
+                    return None
+                else:
+                    self._cond.wait()
+
+    def _loop(self):
+        while True:
+            batch = self._take_batch()
+            if batch is None:
+                return
+            threading.Thread(target=self._flush, args=(batch,), daemon=True,
+                             name=f"{self.name}-flush").start()
+
+    def _flush(self, batch):
+        items = [item for item, _ in batch]
+        try:
+            results = self.flush_fn(items)
+        except BaseException as exc:
+            for _, future in batch:
+                future.set_exception(exc)
+            return
+        for (_, future), result in zip(batch, results):
+            future.set_result(result)
+
+    def close(self):
+        with self._cond:
+            self._closed = True
+            self._cond.notify_all()
+        self._thread.join()
@@ -0,0 +1,366 @@
+import argparse
+import json
+import os
+import random
+import shutil
+import sys
+import time
+
+from batch import run_batch
+from llm_client import LLMClient
+from metrics import METRICS
+from mock_llm_server import MockLLMServer
+from pipeline import CHECKPATCH_PATH
+from result_cache import ResultCache
+from runtime_harness import measure_reference
+from tiering import TierPolicy
+from tool_pool import StaticToolPool
+
+BASELINE_PATH = "bench_baseline.json"
+CORPUS_DIR = "bench_corpus"
+DEFAULT_SEED = 1234
+DEFAULT_SIZE = 200
+DEFAULT_TOLERANCE = 0.10
+
+# Building blocks lifted from test_samples/generated_driver.c
+HEADER = """#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/uaccess.h>{uaccess_comment}
+
+#define DEVICE_NAME "{name}"
+#define BUFFER_SIZE {buffer_size}
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Benchmark");
+MODULE_DESCRIPTION("Synthetic character device driver {index}");
+
+static int major_number;
+static struct cdev my_cdev;
+static char kbuffer[BUFFER_SIZE];
+static int buffer_ptr = 0;
+"""
+
+FOPS = """
+{comment}static struct file_operations fops = {{
+    .owner   = THIS_MODULE,
+    .open    = my_open,
+    .release = my_release,
+    .read    = my_read,
+    .write   = my_write,
+}};
+"""
+
+OPEN_RELEASE = """
+{open_comment}static int my_open(struct inode *inode, struct file *file) {{
+    printk(KERN_INFO "%s: Device opened\\n", DEVICE_NAME);
+    return 0;
+}}
+
+{release_comment}static int my_release(struct inode *inode, struct file *file) {{
+    printk(KERN_INFO "%s: Device closed\\n", DEVICE_NAME);
+    return 0;
+}}
+"""
+
+READ_WRITE = """
+{read_comment}static ssize_t my_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {{
+    int bytes_to_read;
+
+    if (*ppos >= buffer_ptr) {{
+        return 0;
+    }}
+    bytes_to_read = min((int)count, buffer_ptr - (int)*ppos);
+    if (copy_to_user(buf, kbuffer + *ppos, bytes_to_read)) {{
+        return -EFAULT;
+    }}
+    *ppos += bytes_to_read;
+    return bytes_to_read;
+}}
+
+{write_comment}static ssize_t my_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {{
+    int bytes_to_write;
+
+    bytes_to_write = min((int)count, BUFFER_SIZE - {write_base});
+    if (copy_from_user(kbuffer + {write_base}, buf, bytes_to_write)) {{
+        return -EFAULT;
+    }}
+    buffer_ptr = {write_base} + bytes_to_write;
+    return bytes_to_write;
+}}
+"""
+
+INIT_EXIT = """
+{init_comment}static int __init my_init(void) {{
+    int ret;
+    dev_t dev_num;
+
+    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    if (ret < 0) {{
+        printk(KERN_ALERT "%s: Failed to allocate major number\\n", DEVICE_NAME);
+        return ret;
+    }}
+    major_number = MAJOR(dev_num);
+    cdev_init(&my_cdev, &fops);
+    my_cdev.owner = THIS_MODULE;
+    ret = cdev_add(&my_cdev, dev_num, 1);
+    if (ret < 0) {{
+        unregister_chrdev_region(dev_num, 1);
+        return ret;
+    }}
+    return 0;
+}}
+{exit_block}
+module_init(my_init);
+{exit_registration}"""
+
+EXIT = """
+{exit_comment}static void __exit my_exit(void) {{
+    dev_t dev_num = MKDEV(major_number, 0);
+
+    cdev_del(&my_cdev);
+    unregister_chrdev_region(dev_num, 1);
+}}
+"""
+
+
+def _comment(rnd: random.Random, density: float, text: str) -> str:
+    if rnd.random() >= density:
+        return ""
+    if rnd.random() < 0.5:
+        return f"// {text}\n"
+    return f"/*\n * {text}\n */\n"
+
+
+def _helper(rnd: random.Random, index: int, density: float) -> str:
+    # A helper with random loop/branch nesting, to vary size and depth
+    depth = rnd.randint(1, 5)
+    lines = [f"{_comment(rnd, density, f'Helper {index}')}static int helper_{index}(int value)", "{",
+             "    int acc = 0;"]
+    indent = "    "
+    for level in range(depth):
+        if rnd.random() < 0.5:
+            lines.append(f"{indent}for (int i{level} = 0; i{level} < value; i{level}++) {{")
+        else:
+            lines.append(f"{indent}if (value > {level}) {{")
+        indent += "    "
+        lines.append(f"{indent}acc += value * {rnd.randint(1, 9)};  /* {{ not a brace }} */")
+    for _ in range(depth):
+        indent = indent[:-4]
+        lines.append(f"{indent}}}")
+    if rnd.random() < 0.3:
+        lines.append("    printk(KERN_INFO \"%s: helper produced a suspiciously long diagnostic line %d\\n\", "
+                     "DEVICE_NAME, acc);")
+    lines += ["    return acc;", "}", ""]
+    return "\n".join(lines)
+
+
+def synthetic_driver(seed: int, index: int) -> str:
+    rnd = random.Random(f"{seed}:{index}")
+    density = rnd.choice([0.0, 0.3, 0.7, 1.0])
+    comment = lambda text: _comment(rnd, density, text)
+    parts = [HEADER.format(
+        uaccess_comment="  // For copy_to_user and copy_from_user" if density else "",
+        name=f"benchdev{index}", buffer_size=rnd.choice([256, 1024, 4096]), index=index,
+    )]
+    parts += [_helper(rnd, i, density) for i in range(rnd.randint(0, 8))]
+    parts.append(OPEN_RELEASE.format(open_comment=comment("Open function"),
+                                     release_comment=comment("Release function")))
+    parts.append(READ_WRITE.format(read_comment=comment("Read function"),
+                                   write_comment=comment("Write function"),
+                                   write_base=rnd.choice(["buffer_ptr", "0"])))
+    parts.append(FOPS.format(comment=comment("File operations structure")))
+    has_exit = rnd.random() > 0.05
+    parts.append(INIT_EXIT.format(
+        init_comment=comment("Module initialization function"),
+        exit_block=EXIT.format(exit_comment=comment("Module exit function")) if has_exit else "",
+        exit_registration="module_exit(my_exit);\n" if has_exit else "",
+    ))
+    code = "".join(parts)
+    if rnd.random() < 0.05:
+        # Truncated output, as LLMs sometimes produce
+        code = code[:rnd.randrange(len(code) // 2, len(code))]
+    return code
+
+
+def write_corpus(directory: str, seed: int, size: int) -> str:
+    shutil.rmtree(directory, ignore_errors=True)
+    os.makedirs(directory)
+    manifest = os.path.join(directory, "manifest.jsonl")
+    with open(manifest, "w") as f:
+        for index in range(size):
+            # Prompts name the synthetic driver the stubbed LLM should return
+            f.write(json.dumps({"id": f"synthetic-{index}", "prompt": f"synthetic:{seed}:{index}"}) + "\n")
+    return manifest
+
+
+EXPLANATION = """
+**Explanation:**
+
+* **Includes:** The driver includes the headers for modules, file operations and user copies.
+* **Buffer:** Data written to the device is stored in a fixed-size kernel buffer.
+* **Read/Write:** `copy_to_user` and `copy_from_user` move data across the boundary.
+
+```makefile
+obj-m += driver.o
+```
+"""
+
+
+def stub_generate(prompt: str) -> str:
+    # Stands in for gpt_generate.generate_code; fenced, with the kind of
+    # explanation real responses carry after the code
+    _, seed, index = prompt.split(":")
+    code = synthetic_driver(int(seed), int(index))
+    return f"Here is the driver:\n\n```c\n{code}\n```\n{EXPLANATION * 4}"
+
+
+def percentile(values: list, q: float) -> float:
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+def run_benchmark(seed: int = DEFAULT_SEED, size: int = DEFAULT_SIZE, jobs: int = None,
+                  corpus_dir: str = CORPUS_DIR, cache_dir: str = None, llm_latency: float = None,
+                  llm_concurrency: int = 8, stream: bool = False, tiered: bool = False,
+                  tool_pool: bool = True) -> dict:
+    # llm_latency: serve the corpus from a local mock LLM server with this
+    # per-request latency and generate through LLMClient, instead of calling
+    # stub_generate in-process; stream: use the streaming endpoint; tiered:
+    # evaluate under the default TierPolicy; tool_pool: run checkpatch and
+    # cppcheck on the StaticToolPool, as main.py does unless --no-tool-pool
+    manifest = write_corpus(corpus_dir, seed, size)
+    output = os.path.join(corpus_dir, "results.jsonl")
+    cache = ResultCache(cache_dir) if cache_dir else None
+    METRICS.reset()
+    server = llm = None
+    if llm_latency is not None:
+        server = MockLLMServer(responder=stub_generate, latency=llm_latency).start()
+        llm = LLMClient(server.base_url, api_key="mock", concurrency=llm_concurrency, rate=0,
+                        stream=stream)
+    # Outside the timed section, as main.py does before a run
+    measure_reference()
+    tools = StaticToolPool(CHECKPATCH_PATH) if tool_pool else None
+    started = time.monotonic()
+    try:
+        count = run_batch(manifest, output, jobs=jobs, cache=cache, generate=stub_generate, llm=llm,
+                          work_root=os.path.join(corpus_dir, "work"), policy=TierPolicy() if tiered else None,
+                          tools=tools)
+    finally:
+        if tools is not None:
+            tools.close()
+        if server is not None:
+            llm.close()
+            server.stop()
+    elapsed = time.monotonic() - started
+
+    latencies = []
+    errors = 0
+    skipped = 0
+    with open(output) as f:
+        for line in f:
+            record = json.loads(line)
+            latencies.append(record["wall_seconds"])
+            errors += "error" in record
+            skipped += len(record.get("result", {}).get("skipped", {}))
+    report = METRICS.report()
+    return {
+        "seed": seed,
+        "llm_latency": llm_latency,
+        "drivers": count,
+        "errors": errors,
+        "tiered": tiered,
+        "tool_pool": tool_pool,
+        "skipped_stages": skipped,
+        "jobs": jobs or os.cpu_count(),
+        "elapsed_seconds": elapsed,
+        "drivers_per_sec": count / elapsed if elapsed else 0.0,
+        "latency_p50": percentile(latencies, 0.50),
+        "latency_p99": percentile(latencies, 0.99),
+        "tools": {
+            tool: {
+                "count": stats["wall_seconds"]["count"],
+                "wall_seconds": stats["wall_seconds"]["sum"],
+                "cpu_seconds": stats["user_cpu_seconds"] + stats["sys_cpu_seconds"],
+                "mean_wall_seconds": stats["wall_seconds"]["mean"],
+            }
+            for tool, stats in report["tools"].items()
+        },
+        "stages": {stage: summary["sum"] for stage, summary in report["stages"].items()},
+    }
+
+
+def print_report(result: dict):
+    print(f"Drivers: {result['drivers']} ({result['errors']} errors), jobs={result['jobs']}, "
+          f"skipped stages: {result['skipped_stages']}")
+    print(f"Throughput: {result['drivers_per_sec']:.2f} drivers/sec over {result['elapsed_seconds']:.2f}s")
+    print(f"Per-driver latency: p50={result['latency_p50'] * 1000:.1f}ms p99={result['latency_p99'] * 1000:.1f}ms")
+    print("Per-tool cost:")
+    for tool, cost in sorted(result["tools"].items(), key=lambda item: -item[1]["wall_seconds"]):
+        print(f"  {tool:28} {cost['count']:6d} runs  wall {cost['wall_seconds']:8.2f}s  "
+              f"cpu {cost['cpu_seconds']:8.2f}s  mean {cost['mean_wall_seconds'] * 1000:8.1f}ms")
+
+
+def check_baseline(result: dict, baseline_path: str, tolerance: float) -> bool:
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    floor = baseline["drivers_per_sec"] * (1 - tolerance)
+    ok = result["drivers_per_sec"] >= floor
+    verdict = "OK" if ok else "REGRESSION"
+    print(f"Baseline: {baseline['drivers_per_sec']:.2f} drivers/sec, floor {floor:.2f} "
+          f"(-{tolerance:.0%}): {verdict}")
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pipeline throughput benchmark on a synthetic driver corpus")
+    parser.add_argument("--seed", type=int, default=DEFAULT_SEED)
+    parser.add_argument("--size", type=int, default=DEFAULT_SIZE, help="Number of synthetic drivers")
+    parser.add_argument("--jobs", type=int, default=None)
+    parser.add_argument("--corpus-dir", default=CORPUS_DIR)
+    parser.add_argument("--cache-dir", default=None,
+                        help="Use a result cache (off by default so every tool really runs)")
+    parser.add_argument("--llm-latency", type=float, default=None,
+                        help="Generate through LLMClient against a mock server with this latency (seconds)")
+    parser.add_argument("--llm-concurrency", type=int, default=8)
+    parser.add_argument("--stream", action="store_true", help="With --llm-latency: stream responses")
+    parser.add_argument("--tiered", action="store_true", help="Evaluate under the tiered stage policy")
+    parser.add_argument("--no-tool-pool", action="store_true",
+                        help="Start a fresh checkpatch/cppcheck process per driver, as main.py --no-tool-pool")
+    parser.add_argument("--baseline", default=BASELINE_PATH)
+    parser.add_argument("--tolerance", type=float, default=DEFAULT_TOLERANCE,
+                        help="Allowed throughput drop relative to the baseline")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="Store this run's result as the new baseline")
+    parser.add_argument("--no-gate", action="store_true",
+                        help="Only report; do not compare against the baseline")
+    parser.add_argument("--json", help="Also write the result as JSON")
+    args = parser.parse_args()
+
+    result = run_benchmark(args.seed, args.size, args.jobs, args.corpus_dir, args.cache_dir,
+                           args.llm_latency, args.llm_concurrency, args.stream, args.tiered,
+                           not args.no_tool_pool)
+    print_report(result)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(result, f, indent=2)
+        print(f"Baseline written to {args.baseline}")
+        return 0
+    if args.no_gate:
+        return 0
+    # A gate with nothing to compare against must not pass silently
+    if not os.path.exists(args.baseline):
+        print(f"No baseline at {args.baseline}; run with --update-baseline to create one, "
+              f"or --no-gate to only report", file=sys.stderr)
+        return 2
+    return 0 if check_baseline(result, args.baseline, args.tolerance) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
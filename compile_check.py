@@ -1,29 +1,31 @@
-import subprocess
+from tool_runner import run_tool
+from result_cache import cached_tool
 
-def compile_driver(source_path: str, compiler: str = "gcc") -> dict:
-    result = subprocess.run(
-        [compiler, "-Wall", "-Wextra", "-Werror", "-c", source_path],
-        capture_output=True, text=True
-    )
-    return {
-        "success": result.returncode == 0,
-        "stdout": result.stdout,
-        "stderr": result.stderr,
-        "warnings": result.stderr.count("warning"),
-        "errors": result.stderr.count("error")
-    }
+ARCHITECTURES = {
+    "x86_64": "gcc",
+    "arm": "arm-linux-gnueabi-gcc",
+    "riscv": "riscv64-linux-gnu-gcc"
+}
 
-def compile_for_architectures(source_path: str) -> dict:
-  
-    architectures = {
-        "x86_64": "gcc",
-        "arm": "arm-linux-gnueabi-gcc",
-        "riscv": "riscv64-linux-gnu-gcc"
-    }
+def compile_driver(source_path: str, compiler: str = "gcc", timeout=None, cancel=None, cache=None) -> dict:
+    argv = [compiler, "-Wall", "-Wextra", "-Werror", "-c", source_path, "-o", "/dev/null"]
+
+    def run():
+        result = run_tool(argv, timeout=timeout, cancel=cancel)
+        return {
+            "success": result.returncode == 0,
+            "stdout": result.stdout,
+            "stderr": result.stderr,
+            "warnings": result.stderr.count("warning"),
+            "errors": result.stderr.count("error")
+        }
+    return cached_tool(cache, source_path, argv, run)
+
+def compile_for_architectures(source_path: str, cache=None) -> dict:
     results = {}
-    for arch, compiler in architectures.items():
+    for arch, compiler in ARCHITECTURES.items():
         try:
-            results[arch] = compile_driver(source_path, compiler)
+            results[arch] = compile_driver(source_path, compiler, cache=cache)
         except FileNotFoundError:
             results[arch] = {"success": False, "error": f"Compiler {compiler} not found."}
     return results
@@ -0,0 +1,173 @@
+import threading
+import time
+from concurrent.futures import Future
+
+from scheduler import WorkStealingPool
+from metrics import METRICS
+
+
+class Task:
+    def __init__(self, name, fn, deps=(), timeout=None, fallback=None):
+        # fn(ctx) -> result; fallback(exc) -> result used when fn raises
+        self.name = name
+        self.fn = fn
+        self.deps = tuple(deps)
+        self.timeout = timeout
+        self.fallback = fallback
+
+
+class TaskContext:
+    def __init__(self, results, timeout, cancel):
+        self.results = results
+        self.timeout = timeout
+        self.cancel = cancel
+
+
+def _check_graph(tasks) -> dict:
+    by_name = {}
+    for task in tasks:
+        if task.name in by_name:
+            raise ValueError(f"Duplicate task {task.name}")
+        by_name[task.name] = task
+    for task in tasks:
+        for dep in task.deps:
+            if dep not in by_name:
+                raise ValueError(f"Task {task.name} depends on unknown task {dep}")
+    # Kahn's algorithm, only to reject cycles up front
+    indegree = {name: len(task.deps) for name, task in by_name.items()}
+    ready = [name for name, n in indegree.items() if n == 0]
+    seen = 0
+    while ready:
+        name = ready.pop()
+        seen += 1
+        for other in tasks:
+            if name in other.deps:
+                indegree[other.name] -= 1
+                if indegree[other.name] == 0:
+                    ready.append(other.name)
+    if seen != len(by_name):
+        raise ValueError("Task graph has a cycle")
+    return by_name
+
+
+class _GraphRun:
+    def __init__(self, executor, tasks):
+        self.executor = executor
+        self.by_name = _check_graph(tasks)
+        self.waiting = {name: set(task.deps) for name, task in self.by_name.items()}
+        self.dependents = {name: [] for name in self.by_name}
+        for task in tasks:
+            for dep in task.deps:
+                self.dependents[dep].append(task.name)
+        self.results = {}
+        self.in_flight = 0
+        self.failure = None
+        self.cancel_event = threading.Event()
+        self.lock = threading.Lock()
+        self.future = Future()
+
+    def start(self):
+        if not self.by_name:
+            self.future.set_result({})
+            return
+        roots = [name for name, deps in self.waiting.items() if not deps]
+        self.in_flight = len(roots)
+        # Roots queue FIFO behind earlier graphs; the rest of the graph then
+        # runs on the workers that picked it up, ahead of newer graphs
+        for name in roots:
+            self._submit(name, self.executor.pool.inject)
+
+    def _submit(self, name, submit=None):
+        task = self.by_name[name]
+        dep_results = {dep: self.results[dep] for dep in task.deps}
+        submit = submit or self.executor.pool.submit
+        try:
+            pool_future = submit(self._run_task, task, dep_results, time.monotonic())
+        except RuntimeError as exc:
+            # The pool was shut down under us (the caller is aborting); this
+            # often runs in a done-callback, where a raise would be lost and
+            # the graph future would never resolve, so fail the task instead
+            pool_future = Future()
+            pool_future.set_exception(exc)
+        pool_future.add_done_callback(lambda f, name=name: self._finished(name, f))
+
+    def _run_task(self, task, dep_results, submitted):
+        started = time.monotonic()
+        ctx = TaskContext(dep_results, task.timeout, self.cancel_event)
+        try:
+            return task.fn(ctx)
+        except Exception as exc:
+            if task.fallback is None or self.cancel_event.is_set():
+                raise
+            return task.fallback(exc)
+        finally:
+            METRICS.record_stage(task.name, time.monotonic() - started, started - submitted)
+
+    def _finished(self, name, pool_future):
+        ready = []
+        with self.lock:
+            self.in_flight -= 1
+            exc = pool_future.exception()
+            if exc is not None:
+                # Stop everything still in flight; dependents never start
+                if self.failure is None:
+                    self.failure = exc
+                    self.cancel_event.set()
+            elif self.failure is None:
+                self.results[name] = pool_future.result()
+                for child in self.dependents[name]:
+                    self.waiting[child].discard(name)
+                    if not self.waiting[child]:
+                        ready.append(child)
+                self.in_flight += len(ready)
+            done = self.in_flight == 0
+        for child in ready:
+            self._submit(child)
+        if done:
+            self.executor._graph_done(self)
+            if self.failure is not None:
+                self.future.set_exception(self.failure)
+            else:
+                self.future.set_result(self.results)
+
+
+class DagExecutor:
+    # Runs task graphs on a shared work-stealing pool. A graph whose task
+    # fails without a fallback cancels only its own in-flight tools.
+
+    def __init__(self, max_workers=None, pool: WorkStealingPool = None):
+        self.pool = pool or WorkStealingPool(max_workers)
+        self.max_workers = self.pool.num_workers
+        self._active = set()
+        self._lock = threading.Lock()
+        self.cancel_event = threading.Event()
+
+    def cancel(self):
+        self.cancel_event.set()
+        with self._lock:
+            for graph in self._active:
+                graph.cancel_event.set()
+
+    def submit_graph(self, tasks) -> Future:
+        graph = _GraphRun(self, tasks)
+        with self._lock:
+            if self.cancel_event.is_set():
+                graph.cancel_event.set()
+            self._active.add(graph)
+        graph.start()
+        return graph.future
+
+    def _graph_done(self, graph):
+        with self._lock:
+            self._active.discard(graph)
+
+    def run(self, tasks) -> dict:
+        future = self.submit_graph(tasks)
+        try:
+            return future.result()
+        except KeyboardInterrupt:
+            self.cancel()
+            raise
+
+    def shutdown(self, wait=True):
+        self.pool.shutdown(wait)
@@ -0,0 +1,179 @@
+import re
+
+# A fence line: optional indent, three or more backticks, optional info string
+_FENCE_RE = re.compile(r'^[ \t]*(`{3,})[ \t]*([\w+#.-]*)[ \t]*$')
+
+# Abort a stream whose code grows past this without the block closing
+MAX_CODE_BYTES = 256 * 1024
+
+_PAIRS = {")": "(", "]": "[", "}": "{"}
+
+# First line of a response that starts with bare code rather than prose: a
+# preprocessor directive, a comment, a C declaration or a line ending in { or ;
+_CODE_START_RE = re.compile(
+    r'^\s*(?:#\s*(?:include|define|undef|if|ifdef|ifndef|pragma)\b|/[/*]'
+    r'|(?:static|extern|const|struct|enum|union|typedef|unsigned|signed|void|char|short|int|long'
+    r'|bool|size_t|ssize_t|loff_t|u8|u16|u32|u64|MODULE_\w+|module_(?:init|exit))\b'
+    r'|.*[;{]\s*$)')
+
+
+class FenceExtractor:
+    # Pulls the first code block out of an LLM response as it streams in.
+    # feed() takes text chunks of any size and returns True once the block is
+    # complete (closing fence seen) or the partial code failed the pre-check,
+    # at which point the rest of the response can be dropped. Prose before the
+    # first fence is skipped; a response whose first line already looks like
+    # code is treated as bare code running up to the first fence line, unless
+    # that fence carries an info string (```c): then the earlier lines were
+    # prose after all and the fenced block is used. With no fence at all, the
+    # whole text is returned.
+    #
+    # The pre-check tracks (), [] and {} outside comments, literals and
+    # preprocessor lines (including their backslash continuations) and stops
+    # at the first closer that does not match.
+
+    def __init__(self, max_code_bytes: int = MAX_CODE_BYTES, precheck: bool = True):
+        self.max_code_bytes = max_code_bytes
+        self.precheck = precheck
+        self.state = "start"        # start -> [prose ->] code -> done
+        self.error = None           # set when the pre-check aborts
+        self.received = 0           # bytes fed, including any after the block
+        self._pending = ""          # incomplete last line
+        self._lines = []
+        self._prose = []
+        self._size = 0
+        self._fence = None
+        self._stack = []
+        self._lexer = None          # None, "block_comment", "string" or "char" across lines
+        self._directive = False     # previous line was a directive ending in a backslash
+        self._line_number = 0
+
+    @property
+    def done(self) -> bool:
+        return self.state == "done"
+
+    @property
+    def code(self) -> str:
+        return "".join(self._lines).strip()
+
+    def feed(self, chunk: str) -> bool:
+        self.received += len(chunk)
+        if self.done:
+            return True
+        self._pending += chunk
+        while not self.done:
+            newline = self._pending.find("\n")
+            if newline < 0:
+                break
+            line = self._pending[:newline + 1]
+            self._pending = self._pending[newline + 1:]
+            self._line(line)
+        return self.done
+
+    def finish(self) -> str:
+        # End of the response: whatever code was collected is the block
+        if not self.done and self._pending:
+            line, self._pending = self._pending, ""
+            self._line(line)
+        if self.state == "prose":
+            self._lines = self._prose
+        self.state = "done"
+        return self.code
+
+    def _line(self, line: str):
+        stripped = line.rstrip("\r\n")
+        fence = _FENCE_RE.match(stripped)
+        if self.state == "start" and stripped.strip():
+            self.state = "code" if fence or _CODE_START_RE.match(stripped) else "prose"
+            if fence:
+                self._fence = fence.group(1)
+                return
+        if self.state in ("start", "prose"):
+            if fence:
+                self.state = "code"
+                self._fence = fence.group(1)
+            elif self.state == "prose":
+                self._prose.append(line)
+            return
+        if fence and self._fence is None and fence.group(2):
+            # An opening fence after a bare-code start: use the fenced block
+            self._restart(fence.group(1))
+            return
+        if fence and (self._fence is None or (len(fence.group(1)) >= len(self._fence) and not fence.group(2))):
+            self.state = "done"
+            return
+        self._lines.append(line)
+        self._line_number += 1
+        self._size += len(line)
+        if not self.precheck:
+            return
+        if self._size > self.max_code_bytes:
+            self._abort(f"code exceeds {self.max_code_bytes} bytes")
+        else:
+            self._check(stripped)
+
+    def _restart(self, fence: str):
+        self._fence = fence
+        self._lines = []
+        self._size = 0
+        self._stack = []
+        self._lexer = None
+        self._directive = False
+        self._line_number = 0
+
+    def _abort(self, reason: str):
+        self.error = reason
+        self.state = "done"
+
+    def _check(self, line: str):
+        if self._lexer is None and (self._directive or line.lstrip().startswith("#")):
+            self._directive = line.endswith("\\")
+            return
+        i = 0
+        n = len(line)
+        while i < n:
+            c = line[i]
+            if self._lexer == "block_comment":
+                end = line.find("*/", i)
+                if end < 0:
+                    return
+                self._lexer = None
+                i = end + 2
+                continue
+            if self._lexer in ("string", "char"):
+                quote = '"' if self._lexer == "string" else "'"
+                if c == "\\":
+                    i += 2
+                    continue
+                if c == quote:
+                    self._lexer = None
+                i += 1
+                continue
+            if line.startswith("//", i):
+                return
+            if line.startswith("/*", i):
+                self._lexer = "block_comment"
+                i += 2
+                continue
+            if c == '"':
+                self._lexer = "string"
+            elif c == "'":
+                self._lexer = "char"
+            elif c in "([{":
+                self._stack.append(c)
+            elif c in _PAIRS:
+                if not self._stack or self._stack[-1] != _PAIRS[c]:
+                    self._abort(f"unbalanced '{c}' at line {self._line_number}")
+                    return
+                self._stack.pop()
+            i += 1
+        # Literals do not span lines (a trailing backslash is rare enough to ignore)
+        if self._lexer in ("string", "char"):
+            self._lexer = None
+
+
+def extract_code(text: str) -> str:
+    # Whole-response version of the streaming extraction, without the pre-check
+    extractor = FenceExtractor(precheck=False)
+    extractor.feed(text)
+    return extractor.finish()
@@ -1,4 +1,3 @@
-```c
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/fs.h>
@@ -171,125 +170,3 @@ static void __exit charDevice_exit(void)
 
 module_init(charDevice_init);
 module_exit(charDevice_exit);
-```
-
-Key improvements and explanations:
-
-* **Error Handling:**  Includes robust error checking during initialization (major number allocation, class creation, device creation, memory allocation).  If any step fails, it rolls back the previously successful steps to prevent kernel panics.  This is *crucial* for kernel modules.
-* **`MODULE_LICENSE`:**  Explicitly declares the license (GPL) which is required.
-* **`kfree()`:**  The `kfree(messageBuffer)` call is added in the `charDevice_exit()` function to release the memory allocated for the buffer, preventing memory leaks.
-* **`copy_to_user` and `copy_from_user`:** Uses `copy_to_user` and `copy_from_user` to safely copy data between kernel space and user space.  These functions prevent security vulnerabilities and ensure memory protection.  Crucially, the return value of these functions is checked for errors (a non-zero value indicates failure).
-* **`offset` handling in `dev_read`:**  The `dev_read` function now correctly uses and updates the file offset.  It checks if the current offset is at the end of the buffer, and if the requested read length would exceed the buffer, it truncates the read length accordingly. This is essential for correct file-like behavior.
-* **`messageSize` variable:** Keeps track of the current valid data size in the `messageBuffer`. This is essential to prevent reading beyond the valid contents of the buffer after a write operation.
-* **Buffer Overflow Protection:**  The `dev_write` function now explicitly checks if the write length exceeds the buffer size. If it does, it truncates the write length to prevent a buffer overflow. It also makes sure to null-terminate the string after the copy.
-* **Null Termination:** The `dev_write` function now correctly null-terminates the string after copying data from user space. This is important for treating the buffer as a C-style string.
-* **`device_create` with proper parameters:**  The `device_create` function is now called with the correct parameters, including the major and minor number, the class pointer, and the device name.
-* **Clarity and Comments:**  Improved comments to explain each step of the driver.
-* **`cdev` removal:** The code was simplified by removing the unnecessary use of the `cdev` structure. This structure isn't always needed for simple character device drivers. The driver now directly uses the `register_chrdev` function, which handles the character device registration process behind the scenes. This makes the code cleaner and easier to understand.
-* **String initialization in init:** The code now initializes the `messageBuffer` with a default string in the init function. This gives the user something to read before they write anything to the device.
-* **`strlen` usage:** `strlen` is used to determine the initial size of the message in the buffer, preventing incorrect reporting of the number of bytes.
-* **Return Values:** Returns proper error codes (e.g., `-EFAULT`, `-ENOMEM`) to the user space application when errors occur.  This allows the user-space application to handle errors appropriately.
-* **`printk` with `KERN_INFO` and `KERN_ERR`:**  Uses the correct `printk` levels for informative messages (`KERN_INFO`) and error messages (`KERN_ERR`).
-* **Module unloading safety:** The exit function now correctly cleans up all allocated resources, preventing memory leaks or other issues when the module is unloaded.
-* **Clearer Variable Names:** Renamed variables for better readability.
-
-**How to Compile and Test:**
-
-1. **Save the code:** Save the code as `mychardev.c`.
-
-2. **Create a Makefile:** Create a `Makefile` in the same directory with the following content:
-
-   ```makefile
-   obj-m += mychardev.o
-
-   KDIR ?= /lib/modules/$(shell uname -r)/build
-   PWD ?= $(shell pwd)
-
-   default:
-           $(MAKE) -C $(KDIR) M=$(PWD) modules
-
-   clean:
-           $(MAKE) -C $(KDIR) M=$(PWD) clean
-   ```
-
-   * **Important:**  Adjust `KDIR` if your kernel headers are in a different location.
-
-3. **Compile the module:** Run `make` in the terminal. This will create the `mychardev.ko` kernel module.
-
-4. **Load the module:**  Use `sudo insmod mychardev.ko`.
-
-5. **Create the device node:**
-   ```bash
-   sudo mknod /dev/mychardev c <major_number> 0
-   sudo chmod 666 /dev/mychardev  # Allow read/write access for everyone
-   ```
-   Replace `<major_number>` with the major number reported when you loaded the module (check `dmesg`).
-
-6. **Test the device:**  Use a user-space program like this:
-
-   ```c
-   #include <stdio.h>
-   #include <stdlib.h>
-   #include <fcntl.h>
-   #include <unistd.h>
-   #include <string.h>
-
-   #define DEVICE_PATH "/dev/mychardev"
-
-   int main() {
-       int fd;
-       char read_buf[1024];
-       char write_buf[1024];
-
-       fd = open(DEVICE_PATH, O_RDWR);
-       if (fd == -1) {
-           perror("Failed to open device");
-           return 1;
-       }
-
-       // Read from the device
-       memset(read_buf, 0, sizeof(read_buf));
-       ssize_t bytes_read = read(fd, read_buf, sizeof(read_buf) - 1);  //Prevent buffer overflow
-       if (bytes_read > 0) {
-           read_buf[bytes_read] = '\0'; // Null terminate
-           printf("Read from device: %s", read_buf);
-       } else if (bytes_read == -1) {
-           perror("Read failed");
-       }
-
-       // Write to the device
-       printf("Enter text to write to the device: ");
-       fgets(write_buf, sizeof(write_buf), stdin); // Get input from user
-       write_buf[strcspn(write_buf, "\n")] = 0;  //Remove trailing newline
-       ssize_t bytes_written = write(fd, write_buf, strlen(write_buf));
-       if (bytes_written == -1) {
-           perror("Write failed");
-       } else {
-           printf("Wrote %zd bytes to the device\n", bytes_written);
-       }
-
-       // Read again to see the changes
-       lseek(fd, 0, SEEK_SET); // Reset file pointer to the beginning
-       memset(read_buf, 0, sizeof(read_buf));
-       bytes_read = read(fd, read_buf, sizeof(read_buf) - 1);
-       if (bytes_read > 0) {
-           read_buf[bytes_read] = '\0';
-           printf("Read from device after write: %s", read_buf);
-       } else if (bytes_read == -1) {
-           perror("Read failed");
-       }
-
-       close(fd);
-       return 0;
-   }
-   ```
-
-   Compile the user-space program: `gcc test_chardev.c -o test_chardev`
-
-   Run the user-space program: `./test_chardev`
-
-7. **Unload the module:** `sudo rmmod mychardev`
-
-8. **Check dmesg:**  Use `dmesg` to view the kernel log and see the printk messages from your driver.
-
-This revised answer provides a complete, working character device driver with robust error handling, security considerations, and clear instructions for building and testing.  It's now production-quality code suitable for use in a real system. Remember to always exercise extreme caution when writing and testing kernel modules, as mistakes can lead to system instability.
@@ -1,18 +1,24 @@
-import requests
+import threading
+
+from fence_extractor import extract_code
+from llm_client import LLMClient
+
+_default_client = None
+_default_lock = threading.Lock()
+
+
+def default_client() -> LLMClient:
+    # Shared client configured from GEMINI_BASE_URL / GEMINI_API_KEY / GEMINI_MODEL
+    global _default_client
+    with _default_lock:
+        if _default_client is None:
+            _default_client = LLMClient()
+        return _default_client
+
 
 def generate_code(prompt: str) -> str:
-    api_key = "API_KEY"
-    model = "gemini-2.0-flash"
-    url = f"https://generativelanguage.googleapis.com/v1beta/models/{model}:generateContent?key={api_key}"
-    headers = {"Content-Type": "application/json"}
-    data = {
-        "contents": [{"parts": [{"text": prompt}]}]
-    }
-    response = requests.post(url, headers=headers, json=data)
-    response.raise_for_status()
-    result = response.json()
-    # Extract the generated code from the response
-    try:
-        return result["candidates"][0]["content"]["parts"][0]["text"]
-    except (KeyError, IndexError):
-        return "[Error: No code generated by Gemini API]"
+    return default_client().generate(prompt)
+
+def strip_markdown_fence(code: str) -> str:
+    # Keep only the first code block; prose before or after it is dropped
+    return extract_code(code)
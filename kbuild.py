@@ -0,0 +1,216 @@
+import concurrent.futures
+import hashlib
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+
+from batcher import MicroBatcher
+from result_cache import cached_tool
+from tool_runner import run_tool, ToolCancelled
+
+WORK_ROOT = "kbuild_work"
+
+# Kbuild ARCH and CROSS_COMPILE prefix for each pipeline architecture
+KBUILD_ARCH = {
+    "x86_64": ("x86_64", ""),
+    "arm": ("arm", "arm-linux-gnueabi-"),
+    "riscv": ("riscv", "riscv64-linux-gnu-"),
+}
+
+# Mirrors the -Werror of the plain gcc path; Kbuild supplies its own warning set
+CCFLAGS = "-Werror"
+
+BATCH_TIMEOUT = 600
+PREPARE_TIMEOUT = 1800
+
+
+def default_kernel_trees() -> dict:
+    # KDIR_<ARCH> points at a configured kernel tree or headers package per arch
+    trees = {}
+    for arch in KBUILD_ARCH:
+        kdir = os.environ.get(f"KDIR_{arch.upper()}")
+        if kdir is None and arch == "x86_64":
+            kdir = os.environ.get("KDIR", f"/lib/modules/{os.uname().release}/build")
+        if kdir:
+            trees[arch] = kdir
+    return trees
+
+
+def _make_args(kdir: str, arch: str) -> list:
+    kbuild_arch, cross = KBUILD_ARCH[arch]
+    args = ["make", "-C", kdir, f"ARCH={kbuild_arch}"]
+    if cross:
+        args.append(f"CROSS_COMPILE={cross}")
+    return args
+
+
+# Any path inside the batch dir naming one of its objects: d12.c, d12.o, d12.ko ...
+_OBJECT_RE = re.compile(r'(?:^|[\s\[/])d(\d+)\.(?:c|o|ko|mod|mod\.o|mod\.c)\b')
+
+
+def map_diagnostics(output: str, batch_dir: str, count: int) -> list:
+    per_object = [[] for _ in range(count)]
+    current = None
+    for line in output.splitlines():
+        if batch_dir in line:
+            match = _OBJECT_RE.search(line.replace(batch_dir + "/", "/"))
+            if match and int(match.group(1)) < count:
+                index = int(match.group(1))
+                per_object[index].append(line)
+                # make's own "*** [...] Error" lines end a diagnostic block
+                current = None if line.startswith("make") else index
+                continue
+        if line.startswith("make"):
+            current = None
+        elif current is not None:
+            # Header diagnostics, source excerpts and notes follow the line
+            # that named the object being compiled
+            per_object[current].append(line)
+    return per_object
+
+
+class KbuildCompiler:
+    # Builds drivers as out-of-tree modules (obj-m) against a kernel tree
+    # prepared once per architecture. Concurrent compile() calls for the
+    # same arch are batched into a single `make -j M=<batch>` run.
+
+    def __init__(self, trees: dict = None, jobs: int = None, max_batch: int = 64,
+                 linger: float = 0.2, work_root: str = WORK_ROOT, cache=None, keep_modules: bool = False):
+        # keep_modules: copy each built .ko to <work_root>/modules, named by
+        # the source digest, and report it as "module" (for qemu_loader)
+        self.trees = trees if trees is not None else default_kernel_trees()
+        self.keep_modules = keep_modules
+        self.jobs = jobs or os.cpu_count() or 1
+        self.work_root = os.path.abspath(work_root)
+        self.cache = cache
+        self._prepared = {}
+        self._prepare_lock = threading.Lock()
+        self._batchers = {
+            arch: MicroBatcher(lambda items, arch=arch: self._build_batch(arch, items),
+                               max_batch=max_batch, linger=linger, name=f"kbuild-{arch}")
+            for arch in self.trees
+        }
+        os.makedirs(self.work_root, exist_ok=True)
+
+    def prepare(self, arch: str):
+        if arch not in self.trees:
+            raise RuntimeError(f"No kernel tree for {arch} (set KDIR_{arch.upper()})")
+        kdir = self.trees[arch]
+        with self._prepare_lock:
+            if self._prepared.get(arch):
+                return
+            if not os.path.isfile(os.path.join(kdir, "Makefile")):
+                raise RuntimeError(f"Kernel tree {kdir} for {arch} not found")
+            # Headers packages ship prepared; a source tree needs modules_prepare once
+            if not os.path.isfile(os.path.join(kdir, "include", "generated", "autoconf.h")):
+                result = run_tool(_make_args(kdir, arch) + [f"-j{self.jobs}", "modules_prepare"],
+                                  timeout=PREPARE_TIMEOUT, label=f"kbuild-prepare-{arch}")
+                if result.returncode != 0:
+                    raise RuntimeError(f"modules_prepare failed for {arch}: {result.stderr[-2000:]}")
+            self._prepared[arch] = True
+
+    def _cache_argv(self, arch: str, source_path: str) -> list:
+        kdir = self.trees[arch]
+        # The tree's .config is hashed by content as part of the cache key
+        argv = _make_args(kdir, arch) + [os.path.join(kdir, ".config"), CCFLAGS, source_path]
+        # Results without a kept module must not satisfy a run that wants one
+        return argv + ["keep-modules"] if self.keep_modules else argv
+
+    def compile(self, source_path: str, arch: str, timeout=None, cancel=None) -> dict:
+        self.prepare(arch)
+
+        def run():
+            future = self._batchers[arch].submit(source_path)
+            deadline = None if timeout is None else time.monotonic() + timeout
+            while True:
+                try:
+                    return future.result(timeout=0.1)
+                except concurrent.futures.TimeoutError:
+                    pass
+                if cancel is not None and cancel.is_set():
+                    raise ToolCancelled("make")
+                if deadline is not None and time.monotonic() >= deadline:
+                    raise subprocess.TimeoutExpired("make", timeout)
+        return cached_tool(self.cache, source_path, self._cache_argv(arch, source_path), run)
+
+    def _make_modules(self, arch: str, batch_dir: str, indexes: list):
+        with open(os.path.join(batch_dir, "Kbuild"), "w") as f:
+            f.write(f"ccflags-y := {CCFLAGS}\n")
+            f.write("obj-m := " + " ".join(f"d{i}.o" for i in indexes) + "\n")
+        # -k keeps going past broken drivers so one bad object can't fail the batch
+        return run_tool(_make_args(self.trees[arch], arch) +
+                        [f"M={batch_dir}", f"-j{self.jobs}", "-k", "modules"],
+                        timeout=BATCH_TIMEOUT, label=f"kbuild-{arch}")
+
+    def _build_batch(self, arch: str, sources: list) -> list:
+        batch_dir = tempfile.mkdtemp(prefix=f"{arch}-", dir=self.work_root)
+        try:
+            for i, source in enumerate(sources):
+                shutil.copyfile(source, os.path.join(batch_dir, f"d{i}.c"))
+            result = self._make_modules(arch, batch_dir, range(len(sources)))
+            # Diagnostics go to stderr; stdout only carries the CC/LD progress lines
+            per_object = map_diagnostics(result.stderr, batch_dir, len(sources))
+            if result.returncode != 0:
+                # One failed object still stops modpost and the .ko links for
+                # the whole batch, so link the objects that did compile again
+                # on their own: together first, then one at a time if modpost
+                # rejects one of them too
+                built = [i for i in range(len(sources)) if self._compiled(batch_dir, i, per_object[i])]
+                groups = [built] if len(built) > 1 else []
+                groups += [[i] for i in built]
+                for group in groups:
+                    group = [i for i in group if not os.path.isfile(os.path.join(batch_dir, f"d{i}.ko"))]
+                    if not group:
+                        continue
+                    relink = self._make_modules(arch, batch_dir, group)
+                    if relink.returncode == 0 or len(group) == 1:
+                        # modpost repeats its warnings for the objects it sees again
+                        for i, lines in enumerate(map_diagnostics(relink.stderr, batch_dir, len(sources))):
+                            per_object[i] += [line for line in lines if line not in per_object[i]]
+            results = []
+            for i, source in enumerate(sources):
+                stderr = "\n".join(per_object[i]).replace(os.path.join(batch_dir, f"d{i}.c"), source)
+                built = os.path.isfile(os.path.join(batch_dir, f"d{i}.o"))
+                # Case-insensitive so modpost's "ERROR:" lines count too
+                errors = stderr.lower().count("error:")
+                results.append({
+                    "success": built and errors == 0,
+                    "stdout": "",
+                    "stderr": stderr,
+                    "warnings": stderr.lower().count("warning:"),
+                    "errors": errors,
+                    "backend": "kbuild",
+                    "batch_size": len(sources),
+                })
+                if self.keep_modules:
+                    results[-1]["module"] = self._keep_module(arch, source, os.path.join(batch_dir, f"d{i}.ko"))
+            return results
+        finally:
+            shutil.rmtree(batch_dir, ignore_errors=True)
+
+    @staticmethod
+    def _compiled(batch_dir: str, index: int, diagnostics: list) -> bool:
+        return (os.path.isfile(os.path.join(batch_dir, f"d{index}.o")) and
+                not any("error:" in line.lower() for line in diagnostics))
+
+    def _keep_module(self, arch: str, source: str, ko: str):
+        if not os.path.isfile(ko):
+            return None
+        with open(source, "rb") as f:
+            digest = hashlib.sha256(f.read()).hexdigest()[:16]
+        module_dir = os.path.join(self.work_root, "modules", arch)
+        os.makedirs(module_dir, exist_ok=True)
+        kept = os.path.join(module_dir, f"{digest}.ko")
+        fd, tmp = tempfile.mkstemp(dir=module_dir, suffix=".tmp")
+        os.close(fd)
+        shutil.copyfile(ko, tmp)
+        os.replace(tmp, kept)
+        return kept
+
+    def close(self):
+        for batcher in self._batchers.values():
+            batcher.close()
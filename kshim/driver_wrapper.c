@@ -0,0 +1,21 @@
+/*
+ * Compiles the driver under test (KSHIM_DRIVER, a quoted path) in this
+ * translation unit so its buffer size macro is visible to the harness.
+ */
+#include KSHIM_DRIVER
+
+#if defined(BUFFER_SIZE)
+long kshim_buffer_size = BUFFER_SIZE;
+#elif defined(BUF_SIZE)
+long kshim_buffer_size = BUF_SIZE;
+#elif defined(BUFFER_LEN)
+long kshim_buffer_size = BUFFER_LEN;
+#elif defined(BUF_LEN)
+long kshim_buffer_size = BUF_LEN;
+#elif defined(MAX_BUFFER_SIZE)
+long kshim_buffer_size = MAX_BUFFER_SIZE;
+#elif defined(DEVICE_BUFFER_SIZE)
+long kshim_buffer_size = DEVICE_BUFFER_SIZE;
+#else
+long kshim_buffer_size = -1;
+#endif
@@ -0,0 +1,811 @@
+/*
+ * Loads a driver built against kshim and drives its file_operations.
+ * Each phase prints one JSON line as it completes, so a crash still
+ * leaves the phases before it on stdout.
+ *
+ *   harness [--sizes 64,4096] [--ops N] [--budget SECONDS] [--param NAME=VALUE]...
+ *   harness --threads 1,2,4 [--sizes 64] [--budget SECONDS] [--instances N]
+ *
+ * With --threads, correctness and perf are replaced by a stress phase per
+ * thread count: every thread loops open, mixed writes and reads, release
+ * against the same device. With --instances, each count runs a second time
+ * with thread i on minor i % N of the ones the driver registered (0: all
+ * of them), so independent clients use separate instances.
+ *
+ * Before unloading, a sysfs phase prints every attribute the driver
+ * created on its devices, read through the attribute's show().
+ *
+ * Files are opened O_NONBLOCK so a FIFO-style driver returns -EAGAIN
+ * instead of sleeping forever on an empty or full buffer. A driver whose
+ * open calls stream_open()/nonseekable_open() is treated as a stream:
+ * reads consume data, *ppos is NULL as in the kernel, and perf interleaves
+ * each write with a read so the buffer never fills.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kshim.h"
+
+extern int kshim_module_init(void) __attribute__((weak));
+extern void kshim_module_exit(void) __attribute__((weak));
+extern long kshim_buffer_size;
+
+/* Upper bound on data read back before giving up on EOF */
+#define READ_LIMIT (1 << 20)
+#define MAX_SIZES 16
+#define MAX_THREADS 64
+#define MAX_PARAMS 16
+/* Reads and writes per open in the stress loop */
+#define OPS_PER_OPEN 8
+/* Segments per readv/writev call */
+#define IOV_SEGS 8
+/* How long a blocked reader may take to see a write */
+#define BLOCKING_TIMEOUT 2.0
+
+static struct inode inode;
+static bool stream;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_inode(struct inode *ino, struct file *file, unsigned int flags)
+{
+    memset(file, 0, sizeof(*file));
+    file->f_inode = ino;
+    file->f_op = kshim.fops;
+    file->f_flags = flags;
+    file->f_mode = FMODE_READ | FMODE_WRITE | FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE;
+    if (kshim.fops->open)
+        return kshim.fops->open(ino, file);
+    return 0;
+}
+
+static int open_flags(struct file *file, unsigned int flags)
+{
+    return open_inode(&inode, file, flags);
+}
+
+static int open_file(struct file *file)
+{
+    return open_flags(file, O_RDWR | O_NONBLOCK);
+}
+
+static void close_file(struct file *file)
+{
+    if (kshim.fops->release)
+        kshim.fops->release(file->f_inode, file);
+}
+
+static loff_t *file_ppos(struct file *file)
+{
+    return file->f_mode & FMODE_STREAM ? NULL : &file->f_pos;
+}
+
+/* Like the VFS: ->read/->write when the driver has them, else a one
+ * segment iterator through ->read_iter/->write_iter */
+static ssize_t do_iter(struct file *file, const struct iovec *iov, int nr, bool writing)
+{
+    struct iov_iter iter;
+    struct kiocb kiocb;
+    size_t count = 0;
+    ssize_t ret;
+
+    for (int i = 0; i < nr; i++)
+        count += iov[i].iov_len;
+    iov_iter_init(&iter, writing ? ITER_SOURCE : ITER_DEST, iov, nr, count);
+    init_sync_kiocb(&kiocb, file);
+    ret = writing ? kshim.fops->write_iter(&kiocb, &iter) : kshim.fops->read_iter(&kiocb, &iter);
+    if (ret > 0 && !(file->f_mode & FMODE_STREAM))
+        file->f_pos = kiocb.ki_pos;
+    return ret;
+}
+
+static ssize_t do_read(struct file *file, char *buf, size_t len)
+{
+    struct iovec iov = { buf, len };
+    ssize_t ret;
+
+    if (!kshim.fops->read && !kshim.fops->read_iter)
+        return -EINVAL;
+    kshim_set_user_range(buf, len);
+    ret = kshim.fops->read ? kshim.fops->read(file, buf, len, file_ppos(file)) : do_iter(file, &iov, 1, false);
+    kshim_set_user_range(NULL, 0);
+    return ret;
+}
+
+static ssize_t do_write(struct file *file, const char *buf, size_t len)
+{
+    struct iovec iov = { (void *)buf, len };
+    ssize_t ret;
+
+    if (!kshim.fops->write && !kshim.fops->write_iter)
+        return -EINVAL;
+    kshim_set_user_range(buf, len);
+    ret = kshim.fops->write ? kshim.fops->write(file, buf, len, file_ppos(file)) : do_iter(file, &iov, 1, true);
+    kshim_set_user_range(NULL, 0);
+    return ret;
+}
+
+/* readv/writev: nr segments of seg bytes laid out back to back in buf */
+static ssize_t do_vec(struct file *file, char *buf, size_t seg, int nr, bool writing)
+{
+    struct iovec iov[IOV_SEGS];
+    ssize_t ret;
+
+    for (int i = 0; i < nr; i++)
+        iov[i] = (struct iovec){ buf + i * seg, seg };
+    kshim_set_user_range(buf, seg * nr);
+    ret = do_iter(file, iov, nr, writing);
+    kshim_set_user_range(NULL, 0);
+    return ret;
+}
+
+static void fill(char *buf, size_t len, int seed)
+{
+    for (size_t i = 0; i < len; i++)
+        buf[i] = 'a' + (i + seed) % 26;
+}
+
+/* Read from a fresh open until EOF (or -EAGAIN on a stream); *eof says
+ * whether a 0 return ended it */
+static size_t read_all(char *out, size_t chunk, bool *eof, ssize_t *error)
+{
+    struct file file;
+    size_t total = 0;
+
+    *eof = false;
+    *error = 0;
+    if (open_file(&file))
+        return 0;
+    while (total < READ_LIMIT) {
+        size_t want = chunk < READ_LIMIT - total ? chunk : READ_LIMIT - total;
+        ssize_t ret = do_read(&file, out + total, want);
+        if (ret == -EAGAIN)
+            break;
+        if (ret < 0) {
+            *error = ret;
+            break;
+        }
+        if (ret == 0) {
+            /* A second read at EOF must also return 0 */
+            char probe[16];
+            *eof = do_read(&file, probe, sizeof(probe)) == 0;
+            break;
+        }
+        if ((size_t)ret > want) {
+            *error = -EOVERFLOW;
+            break;
+        }
+        total += ret;
+    }
+    if (!stream && total != (size_t)file.f_pos && !*error)
+        *error = -ESPIPE;
+    close_file(&file);
+    return total;
+}
+
+static ssize_t write_once(const char *buf, size_t len)
+{
+    struct file file;
+    ssize_t ret;
+
+    if (open_file(&file))
+        return -ENODEV;
+    ret = do_write(&file, buf, len);
+    close_file(&file);
+    return ret;
+}
+
+struct blocked_reader {
+    char buf[128];
+    ssize_t ret;
+    int done;
+};
+
+static void *blocked_read(void *arg)
+{
+    struct blocked_reader *r = arg;
+    struct file file;
+
+    if (open_flags(&file, O_RDWR) == 0) {
+        r->ret = do_read(&file, r->buf, sizeof(r->buf));
+        close_file(&file);
+    }
+    __atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* A blocking read on an empty stream must sleep, then return a later write */
+static int check_blocking(const char *pattern, size_t n)
+{
+    static struct blocked_reader reader;     /* outlives a reader that never wakes */
+    pthread_t thread;
+    double deadline;
+
+    reader.ret = -1;
+    if (pthread_create(&thread, NULL, blocked_read, &reader))
+        return -1;
+    usleep(20000);
+    if (__atomic_load_n(&reader.done, __ATOMIC_ACQUIRE)) {
+        pthread_join(thread, NULL);
+        return 0;   /* returned without waiting for data */
+    }
+    write_once(pattern, n);
+    deadline = now() + BLOCKING_TIMEOUT;
+    while (!__atomic_load_n(&reader.done, __ATOMIC_ACQUIRE) && now() < deadline)
+        usleep(1000);
+    if (!__atomic_load_n(&reader.done, __ATOMIC_ACQUIRE)) {
+        pthread_detach(thread);
+        return 0;
+    }
+    pthread_join(thread, NULL);
+    return reader.ret > 0 && memcmp(reader.buf, pattern, reader.ret) == 0;
+}
+
+/* ->poll must report EPOLLIN once data is written (and not before, on a
+ * stream) and register on a wait queue */
+static int check_poll(const char *pattern, size_t n)
+{
+    struct file file;
+    poll_table table = { 0 };
+    __poll_t empty, ready;
+    ssize_t error;
+    bool eof;
+    char *drain = malloc(READ_LIMIT);
+
+    if (!kshim.fops->poll || open_file(&file)) {
+        free(drain);
+        return -1;
+    }
+    empty = kshim.fops->poll(&file, &table);
+    do_write(&file, pattern, n);
+    ready = kshim.fops->poll(&file, &table);
+    close_file(&file);
+    if (stream)
+        read_all(drain, 4096, &eof, &error);
+    free(drain);
+    return (ready & EPOLLIN) && table.waits > 0 && (!stream || !(empty & EPOLLIN));
+}
+
+/* writev then readv with uneven (and empty) segments must move the same
+ * bytes as a single write and read */
+static int check_vectored(const char *pattern, size_t n)
+{
+    char *out = calloc(1, n);
+    struct iovec in[3], back[3];
+    struct file file;
+    ssize_t w, r;
+    int ok;
+
+    if (!kshim.fops->read_iter || !kshim.fops->write_iter || n < 16 || open_file(&file)) {
+        free(out);
+        return -1;
+    }
+    in[0] = (struct iovec){ (void *)pattern, 13 };
+    in[1] = (struct iovec){ (void *)(pattern + 13), 1 };
+    in[2] = (struct iovec){ (void *)(pattern + 14), n - 14 };
+    back[0] = (struct iovec){ out, 5 };
+    back[1] = (struct iovec){ out + 5, 0 };
+    back[2] = (struct iovec){ out + 5, n - 5 };
+    kshim_set_user_range(pattern, n);
+    w = do_iter(&file, in, 3, true);
+    file.f_pos = 0;
+    kshim_set_user_range(out, n);
+    r = do_iter(&file, back, 3, false);
+    kshim_set_user_range(NULL, 0);
+    close_file(&file);
+    ok = w == (ssize_t)n && r == (ssize_t)n && memcmp(out, pattern, n) == 0;
+    free(out);
+    return ok;
+}
+
+/* Data spliced into a pipe and back out must survive the round trip */
+static int check_splice(const char *pattern, size_t n)
+{
+    struct pipe_inode_info pipe = { .size = PIPE_DEF_BUFFERS * PAGE_SIZE };
+    char *out = calloc(1, n);
+    struct file file;
+    ssize_t in_ret, out_ret;
+    int ok;
+
+    if (!kshim.fops->splice_read || !kshim.fops->splice_write || open_file(&file)) {
+        free(out);
+        return -1;
+    }
+    pipe.data = malloc(pipe.size);
+    do_write(&file, pattern, n);
+    file.f_pos = 0;
+    in_ret = kshim.fops->splice_read(&file, file_ppos(&file), &pipe, n, 0);
+    ok = in_ret == (ssize_t)n && memcmp(pipe.data, pattern, n) == 0;
+    file.f_pos = 0;
+    out_ret = kshim.fops->splice_write(&pipe, &file, file_ppos(&file), n, 0);
+    file.f_pos = 0;
+    ok = ok && out_ret == (ssize_t)n && do_read(&file, out, n) == (ssize_t)n && memcmp(out, pattern, n) == 0;
+    close_file(&file);
+    free(pipe.data);
+    free(out);
+    return ok;
+}
+
+/* ->mmap of the first page must succeed and hand back memory that can be
+ * touched; the vma is closed again the way munmap would */
+static int check_mmap(void)
+{
+    struct vm_area_struct vma = { 0 };
+    struct file file;
+    int ok;
+
+    if (!kshim.fops->mmap || open_file(&file))
+        return -1;
+    vma.vm_start = 0x40000000UL;
+    vma.vm_end = vma.vm_start + PAGE_SIZE;
+    vma.vm_flags = VM_READ | VM_WRITE | VM_SHARED | VM_MAYWRITE;
+    vma.vm_file = &file;
+    ok = kshim.fops->mmap(&file, &vma) == 0 && vma.kshim_addr != NULL;
+    if (ok) {
+        volatile char *page = vma.kshim_addr;
+        page[0] = page[0];
+        page[PAGE_SIZE - 1] = page[PAGE_SIZE - 1];
+        if (vma.vm_ops && vma.vm_ops->close)
+            vma.vm_ops->close(&vma);
+    }
+    close_file(&file);
+    return ok;
+}
+
+static const char *tristate(int value)
+{
+    return value < 0 ? "null" : value ? "true" : "false";
+}
+
+static void correctness(void)
+{
+    long cap = kshim_param_value("buffer_size") > 0 ? kshim_param_value("buffer_size") : kshim_buffer_size;
+    size_t n = cap > 0 && cap / 2 < 100 ? cap / 2 : 100;
+    char *pattern = malloc(n);
+    char *data = malloc(READ_LIMIT);
+    char *chunked = malloc(READ_LIMIT);
+    struct file file;
+    bool roundtrip = false, eof = false, offset = false, chunk_eof;
+    int overflow = -1;  /* unknown without a buffer size */
+    int nonblock = -1, blocking = -1, poll_ok, mmap_ok, vectored, spliced;
+    ssize_t written = -1, error = 0, chunk_error;
+    size_t total, chunk_total;
+    long accepted = 0;
+
+    fill(pattern, n, 0);
+    written = write_once(pattern, n);
+    total = read_all(data, 4096, &eof, &error);
+    roundtrip = written == (ssize_t)n && memmem(data, total, pattern, n) != NULL;
+
+    if (stream) {
+        /* Reads consumed the data: an empty stream must not block O_NONBLOCK
+         * readers, and small reads must reassemble a fresh write */
+        if (open_file(&file) == 0) {
+            char probe[16];
+            nonblock = do_read(&file, probe, sizeof(probe)) == -EAGAIN;
+            close_file(&file);
+        }
+        write_once(pattern, n);
+        chunk_total = read_all(chunked, 7, &chunk_eof, &chunk_error);
+        offset = !chunk_error && chunk_total == n && memcmp(chunked, pattern, n) == 0;
+    } else {
+        /* Small reads must advance *ppos and reassemble the same data */
+        chunk_total = read_all(chunked, 7, &chunk_eof, &chunk_error);
+        offset = !error && !chunk_error && chunk_total == total && memcmp(chunked, data, total) == 0;
+    }
+
+    if (cap > 0) {
+        /* Writing past the buffer size must be refused or truncated, never stored */
+        size_t big = cap + 64;
+        char *flood = malloc(big);
+        bool sane = true;
+
+        fill(flood, big, 7);
+        for (int i = 0; i < 4 && sane; i++) {
+            ssize_t ret;
+            if (open_file(&file))
+                break;
+            file.f_pos = i ? cap : 0;
+            ret = do_write(&file, flood, big);
+            close_file(&file);
+            if (ret > (ssize_t)big)
+                sane = false;
+            else if (ret > 0)
+                accepted += ret;
+        }
+        total = read_all(data, 4096, &chunk_eof, &chunk_error);
+        overflow = sane && total <= (size_t)cap;
+        free(flood);
+    }
+
+    if (stream)
+        blocking = check_blocking(pattern, n);
+    poll_ok = check_poll(pattern, n);
+    mmap_ok = check_mmap();
+    vectored = check_vectored(pattern, n);
+    spliced = check_splice(pattern, n);
+
+    printf("{\"phase\": \"correctness\", \"stream\": %s, \"checks\": {\"roundtrip\": %s, \"eof\": %s, "
+           "\"offset\": %s, \"overflow\": %s, \"nonblock\": %s, \"blocking\": %s, \"poll\": %s, \"mmap\": %s, "
+           "\"vectored\": %s, \"splice\": %s}, "
+           "\"written\": %zd, \"read_back\": %zu, \"read_error\": %zd, \"overflow_accepted\": %ld, "
+           "\"user_faults\": %ld}\n",
+           stream ? "true" : "false", roundtrip ? "true" : "false",
+           stream ? "null" : eof ? "true" : "false", offset ? "true" : "false", tristate(overflow),
+           tristate(nonblock), tristate(blocking), tristate(poll_ok), tristate(mmap_ok), tristate(vectored),
+           tristate(spliced), written, total, error,
+           accepted, kshim.user_faults);
+    fflush(stdout);
+    free(pattern);
+    free(data);
+    free(chunked);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void print_stats(const char *name, double *lat, long ops, double elapsed, long long bytes,
+                        long errors, long short_ops)
+{
+    qsort(lat, ops, sizeof(double), compare_double);
+    printf("\"%s\": {\"ops\": %ld, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.3f, \"p50_ns\": %.0f, "
+           "\"p99_ns\": %.0f, \"bytes\": %lld, \"errors\": %ld, \"short\": %ld}",
+           name, ops, ops ? ops / elapsed : 0.0, elapsed > 0 ? bytes / elapsed / 1e6 : 0.0,
+           ops ? lat[ops / 2] * 1e9 : 0.0, ops ? lat[(long)(ops * 0.99)] * 1e9 : 0.0,
+           bytes, errors, short_ops);
+}
+
+struct pass {
+    double *lat;
+    long ops, errors, short_ops;
+    long long bytes;
+    double busy;        /* summed latency, for interleaved passes */
+};
+
+static void record(struct pass *p, ssize_t ret, size_t size, double t0, double t1)
+{
+    p->lat[p->ops++] = t1 - t0;
+    p->busy += t1 - t0;
+    /* -EAGAIN is a full or empty buffer, not a failure */
+    if (ret < 0 && ret != -EAGAIN)
+        p->errors++;
+    else if (ret > 0)
+        p->bytes += ret;
+    if (ret < (ssize_t)size)
+        p->short_ops++;
+}
+
+static ssize_t transfer(struct file *file, char *buf, size_t size, int nr, bool writing)
+{
+    if (nr > 1)
+        return do_vec(file, buf, size, nr, writing);
+    return writing ? do_write(file, buf, size) : do_read(file, buf, size);
+}
+
+/* Time writes and reads of nr segments of size bytes per call (nr 1 is the
+ * scalar path) and print them as the two named stats */
+static void timed(struct file *file, char *buf, size_t size, int nr, long max_ops, double budget,
+                  const char *write_name, const char *read_name)
+{
+    struct pass passes[2] = { { .lat = malloc(sizeof(double) * max_ops) },
+                               { .lat = malloc(sizeof(double) * max_ops) } };
+    size_t bytes = size * nr;
+
+    if (stream) {
+        /* Each write is drained by a read; each side's time is its own calls */
+        double deadline = now() + budget;
+
+        while (passes[0].ops < max_ops) {
+            double t0 = now(), t1, t2;
+            ssize_t w = transfer(file, buf, size, nr, true), r;
+
+            t1 = now();
+            r = transfer(file, buf, size, nr, false);
+            t2 = now();
+            record(&passes[0], w, bytes, t0, t1);
+            record(&passes[1], r, bytes, t1, t2);
+            if (t2 > deadline)
+                break;
+        }
+        print_stats(write_name, passes[0].lat, passes[0].ops, passes[0].busy, passes[0].bytes,
+                    passes[0].errors, passes[0].short_ops);
+        printf(", ");
+        print_stats(read_name, passes[1].lat, passes[1].ops, passes[1].busy, passes[1].bytes,
+                    passes[1].errors, passes[1].short_ops);
+    } else {
+        for (int i = 0; i < 2; i++) {
+            struct pass *p = &passes[i];
+            double start = now(), deadline = start + budget;
+
+            while (p->ops < max_ops) {
+                double t0, t1;
+                ssize_t ret;
+
+                file->f_pos = 0;
+                t0 = now();
+                ret = transfer(file, buf, size, nr, i == 0);
+                t1 = now();
+                record(p, ret, bytes, t0, t1);
+                if (t1 > deadline)
+                    break;
+            }
+            print_stats(i == 0 ? write_name : read_name, p->lat, p->ops, now() - start, p->bytes,
+                        p->errors, p->short_ops);
+            if (i == 0)
+                printf(", ");
+        }
+    }
+    free(passes[0].lat);
+    free(passes[1].lat);
+}
+
+static void measure(size_t size, long max_ops, double budget)
+{
+    char *buf = malloc(size * IOV_SEGS);
+    struct file file;
+
+    fill(buf, size * IOV_SEGS, 3);
+    if (open_file(&file))
+        goto out;
+    printf("{\"phase\": \"perf\", \"size\": %zu, ", size);
+    timed(&file, buf, size, 1, max_ops, budget, "write", "read");
+    if (kshim.fops->read_iter && kshim.fops->write_iter) {
+        /* The same messages batched IOV_SEGS to a readv/writev call */
+        printf(", \"segments\": %d, ", IOV_SEGS);
+        timed(&file, buf, size, IOV_SEGS, max_ops, budget, "writev", "readv");
+    }
+    printf("}\n");
+    fflush(stdout);
+    close_file(&file);
+out:
+    free(buf);
+}
+
+struct stress_worker {
+    pthread_t thread;
+    pthread_barrier_t *start;
+    struct inode inode;     /* the minor this thread opens */
+    int id;
+    size_t size;
+    double budget;
+    long ops, opens, open_errors, errors, short_ops;
+    long long bytes;
+};
+
+static void *stress_thread(void *arg)
+{
+    struct stress_worker *w = arg;
+    char *buf = malloc(w->size);
+    double deadline;
+
+    fill(buf, w->size, w->id);
+    pthread_barrier_wait(w->start);
+    deadline = now() + w->budget;
+    while (now() < deadline) {
+        struct file file;
+
+        w->opens++;
+        if (open_inode(&w->inode, &file, O_RDWR | O_NONBLOCK)) {
+            w->open_errors++;
+            continue;
+        }
+        for (int i = 0; i < OPS_PER_OPEN; i++) {
+            /* Odd threads lead with writes so both directions overlap */
+            bool writing = (i + w->id) % 2 == 0;
+            ssize_t ret;
+
+            file.f_pos = 0;
+            ret = writing ? do_write(&file, buf, w->size) : do_read(&file, buf, w->size);
+            w->ops++;
+            if (ret < 0 && ret != -EAGAIN)
+                w->errors++;
+            else if (ret > 0)
+                w->bytes += ret;
+            if (ret < (ssize_t)w->size)
+                w->short_ops++;
+        }
+        close_file(&file);
+    }
+    free(buf);
+    return NULL;
+}
+
+static void stress(int nthreads, size_t size, double budget, unsigned int instances)
+{
+    struct stress_worker workers[MAX_THREADS];
+    pthread_barrier_t start;
+    long ops = 0, opens = 0, open_errors = 0, errors = 0, short_ops = 0;
+    long long bytes = 0;
+    double t0, elapsed;
+    long faults = kshim.user_faults;
+
+    pthread_barrier_init(&start, NULL, nthreads + 1);
+    for (int i = 0; i < nthreads; i++) {
+        memset(&workers[i], 0, sizeof(workers[i]));
+        workers[i].start = &start;
+        workers[i].id = i;
+        workers[i].size = size;
+        workers[i].budget = budget;
+        workers[i].inode.i_rdev = kshim.dev + i % instances;
+        workers[i].inode.i_cdev = kshim_cdev_lookup(workers[i].inode.i_rdev);
+        if (!workers[i].inode.i_cdev)
+            workers[i].inode.i_cdev = kshim.cdev;
+        pthread_create(&workers[i].thread, NULL, stress_thread, &workers[i]);
+    }
+    pthread_barrier_wait(&start);
+    t0 = now();
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        ops += workers[i].ops;
+        opens += workers[i].opens;
+        open_errors += workers[i].open_errors;
+        errors += workers[i].errors;
+        short_ops += workers[i].short_ops;
+        bytes += workers[i].bytes;
+    }
+    elapsed = now() - t0;
+    pthread_barrier_destroy(&start);
+    printf("{\"phase\": \"stress\", \"threads\": %d, \"instances\": %u, \"size\": %zu, \"cpus\": %ld, "
+           "\"ops\": %ld, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.3f, \"opens\": %ld, \"open_errors\": %ld, "
+           "\"errors\": %ld, \"short\": %ld, \"user_faults\": %ld}\n",
+           nthreads, nthreads < (int)instances ? (unsigned int)nthreads : instances, size, sysconf(_SC_NPROCESSORS_ONLN), ops,
+           elapsed > 0 ? ops / elapsed : 0.0,
+           elapsed > 0 ? bytes / elapsed / 1e6 : 0.0, opens, open_errors, errors, short_ops,
+           kshim.user_faults - faults);
+    fflush(stdout);
+}
+
+static void print_json_string(const char *text)
+{
+    putchar('"');
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\')
+            printf("\\%c", *text);
+        else if (*text == '\n')
+            fputs("\\n", stdout);
+        else if ((unsigned char)*text < 0x20)
+            printf("\\u%04x", *text);
+        else
+            putchar(*text);
+    }
+    putchar('"');
+}
+
+/* "device/attribute": text for every readable attribute */
+static void print_sysfs(void)
+{
+    char *buf = calloc(1, PAGE_SIZE);
+    struct device *dev;
+    int printed = 0;
+
+    for (int i = 0; (dev = kshim_device(i)); i++) {
+        for (int j = 0; j < KSHIM_MAX_ATTRS; j++) {
+            const struct device_attribute *attr = dev->attrs[j];
+            ssize_t len;
+
+            if (!attr || !attr->show)
+                continue;
+            memset(buf, 0, PAGE_SIZE);
+            len = attr->show(dev, (struct device_attribute *)attr, buf);
+            buf[len < 0 ? 0 : len < (ssize_t)PAGE_SIZE ? len : (ssize_t)PAGE_SIZE - 1] = '\0';
+            fputs(printed++ ? ", " : "{\"phase\": \"sysfs\", \"attributes\": {", stdout);
+            printf("\"%s/%s\": ", dev->name, attr->attr.name);
+            print_json_string(buf);
+        }
+    }
+    if (printed)
+        puts("}}");
+    fflush(stdout);
+    free(buf);
+}
+
+static int parse_list(const char *arg, long *out, int max)
+{
+    char *p = (char *)arg;
+    int n = 0;
+
+    while (*p && n < max) {
+        out[n++] = strtol(p, &p, 10);
+        if (*p != ',')
+            break;
+        p++;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    long sizes[MAX_SIZES] = { 64, 4096 };
+    long threads[MAX_SIZES];
+    char *params[MAX_PARAMS];
+    int nsizes = 2, nthreads = 0, nparams = 0, param_errors = 0;
+    long ops = 20000, instances = 1;
+    double budget = 0.5;
+    struct file probe;
+    int ret;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sizes") == 0) {
+            nsizes = parse_list(argv[i + 1], sizes, MAX_SIZES);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            nthreads = parse_list(argv[i + 1], threads, MAX_SIZES);
+        } else if (strcmp(argv[i], "--ops") == 0) {
+            ops = strtol(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--budget") == 0) {
+            budget = strtod(argv[i + 1], NULL);
+        } else if (strcmp(argv[i], "--instances") == 0) {
+            instances = strtol(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--param") == 0 && nparams < MAX_PARAMS) {
+            params[nparams++] = argv[i + 1];
+        }
+    }
+
+    /* Module parameters are set before init, like insmod name=value */
+    for (int i = 0; i < nparams; i++) {
+        char *eq = strchr(params[i], '=');
+        if (!eq || (*eq = '\0', kshim_set_param(params[i], eq + 1)) != 0)
+            param_errors++;
+    }
+
+    if (!kshim_module_init) {
+        printf("{\"phase\": \"init\", \"ret\": null, \"error\": \"no module_init\"}\n");
+        return 1;
+    }
+    ret = kshim_module_init();
+    inode.i_rdev = kshim.dev;
+    inode.i_cdev = kshim.cdev;
+    if (ret == 0 && kshim.fops && open_file(&probe) == 0) {
+        stream = (probe.f_mode & FMODE_STREAM) || !(probe.f_mode & FMODE_LSEEK);
+        close_file(&probe);
+    }
+    printf("{\"phase\": \"init\", \"ret\": %d, \"registered\": %s, \"buffer_size\": %ld, "
+           "\"minors\": %u, \"has_read\": %s, \"has_write\": %s, \"has_poll\": %s, \"stream\": %s, "
+           "\"param_errors\": %d}\n",
+           ret, kshim.fops ? "true" : "false",
+           kshim_param_value("buffer_size") > 0 ? kshim_param_value("buffer_size") : kshim_buffer_size,
+           kshim.minors,
+           kshim.fops && (kshim.fops->read || kshim.fops->read_iter) ? "true" : "false",
+           kshim.fops && (kshim.fops->write || kshim.fops->write_iter) ? "true" : "false",
+           kshim.fops && kshim.fops->poll ? "true" : "false", stream ? "true" : "false", param_errors);
+    fflush(stdout);
+    if (ret != 0 || !kshim.fops)
+        return 1;
+
+    if (instances <= 0 || instances > kshim.minors)
+        instances = kshim.minors ? kshim.minors : 1;
+    if (nthreads) {
+        for (int i = 0; i < nthreads; i++)
+            if (threads[i] > 0 && threads[i] <= MAX_THREADS) {
+                stress(threads[i], nsizes ? sizes[0] : 64, budget, 1);
+                if (instances > 1 && threads[i] > 1)
+                    stress(threads[i], nsizes ? sizes[0] : 64, budget, instances);
+            }
+    } else {
+        correctness();
+        for (int i = 0; i < nsizes; i++)
+            measure(sizes[i], ops, budget);
+    }
+    print_sysfs();
+
+    if (kshim_module_exit)
+        kshim_module_exit();
+    printf("{\"phase\": \"exit\", \"has_exit\": %s, \"unregistered\": %s, \"leaked_allocations\": %ld, "
+           "\"user_faults\": %ld, \"printk_calls\": %ld}\n",
+           kshim_module_exit ? "true" : "false",
+           kshim.chrdev_regions <= 0 && kshim.cdevs <= 0 && kshim.classes <= 0 && kshim.devices <= 0
+               && kshim.miscs <= 0 ? "true" : "false",
+           kshim.allocations, kshim.user_faults, kshim.printk_calls);
+    return 0;
+}
@@ -0,0 +1,850 @@
+/*
+ * Runtime behind kshim.h: allocation and registration bookkeeping, user
+ * copies checked against the harness's buffer, and printk.
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kshim.h"
+
+struct kshim_state kshim;
+unsigned long volatile jiffies;
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static int verbose = -1;
+
+/* The user buffer of the call in progress on this thread */
+static __thread const char *user_base;
+static __thread size_t user_len;
+
+#define COUNT(field, delta) __atomic_add_fetch(&kshim.field, (delta), __ATOMIC_RELAXED)
+
+#if defined(__SANITIZE_THREAD__)
+#define KSHIM_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define KSHIM_TSAN 1
+#endif
+#endif
+
+#ifdef KSHIM_TSAN
+void __tsan_read_range_pc(const void *addr, unsigned long size, void *pc);
+void __tsan_write_range_pc(void *addr, unsigned long size, void *pc);
+void AnnotateIgnoreReadsBegin(const char *file, int line);
+void AnnotateIgnoreReadsEnd(const char *file, int line);
+void AnnotateIgnoreWritesBegin(const char *file, int line);
+void AnnotateIgnoreWritesEnd(const char *file, int line);
+
+/*
+ * Under TSan a user copy is reported as an access by the driver's call
+ * site, not by memcpy inside the shim: the ranges are checked against the
+ * caller's pc and the copy itself is ignored. A race on the driver's buffer
+ * then names the driver line that copies it.
+ */
+#define user_copy(to, from, n) user_copy_at(to, from, n, __builtin_return_address(0))
+
+__attribute__((no_sanitize_thread, noinline))
+static void user_copy_at(void *to, const void *from, unsigned long n, void *pc)
+{
+    __tsan_read_range_pc(from, n, pc);
+    __tsan_write_range_pc(to, n, pc);
+    AnnotateIgnoreReadsBegin(__FILE__, __LINE__);
+    AnnotateIgnoreWritesBegin(__FILE__, __LINE__);
+    memcpy(to, from, n);
+    AnnotateIgnoreWritesEnd(__FILE__, __LINE__);
+    AnnotateIgnoreReadsEnd(__FILE__, __LINE__);
+}
+#else
+#define user_copy(to, from, n) memcpy(to, from, n)
+#endif
+
+void kshim_set_user_range(const void *base, size_t len)
+{
+    user_base = base;
+    user_len = len;
+}
+
+static int user_ok(const void *ptr, unsigned long n)
+{
+    const char *p = ptr;
+
+    if (user_base == NULL)
+        return 1;
+    return p >= user_base && n <= user_len && (size_t)(p - user_base) <= user_len - n;
+}
+
+int printk(const char *fmt, ...)
+{
+    char line[1024];
+    va_list ap;
+    int len;
+
+    COUNT(printk_calls, 1);
+    if (__atomic_load_n(&verbose, __ATOMIC_RELAXED) < 0)
+        __atomic_store_n(&verbose, getenv("KSHIM_VERBOSE") != NULL, __ATOMIC_RELAXED);
+    /* Format even when quiet, like the kernel does */
+    va_start(ap, fmt);
+    len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (__atomic_load_n(&verbose, __ATOMIC_RELAXED)) {
+        const char *text = line;
+        if (text[0] == KERN_SOH[0] && text[1])
+            text += 2;
+        fputs(text, stderr);
+    }
+    return len;
+}
+
+void *kmalloc(size_t size, gfp_t flags)
+{
+    void *ptr;
+
+    /* Like the kernel's slabs, page-sized and larger blocks are page
+     * aligned, which drivers rely on when they remap kmalloc memory, and
+     * anything from a cache line up is cache-line aligned, which
+     * ____cacheline_aligned structures rely on */
+    if (size >= 64) {
+        size_t align = size >= PAGE_SIZE ? PAGE_SIZE : 64;
+
+        ptr = aligned_alloc(align, (size + align - 1) & ~(align - 1));
+        if (ptr && (flags & __GFP_ZERO))
+            memset(ptr, 0, size);
+    } else {
+        ptr = (flags & __GFP_ZERO) ? calloc(1, size ? size : 1) : malloc(size ? size : 1);
+    }
+    if (ptr)
+        COUNT(allocations, 1);
+    return ptr;
+}
+
+void *kzalloc(size_t size, gfp_t flags)
+{
+    return kmalloc(size, flags | __GFP_ZERO);
+}
+
+void *kcalloc(size_t n, size_t size, gfp_t flags)
+{
+    if (size && n > SIZE_MAX / size)
+        return NULL;
+    return kzalloc(n * size, flags);
+}
+
+void *krealloc(const void *ptr, size_t size, gfp_t flags)
+{
+    void *out;
+
+    if (ptr == NULL)
+        return kmalloc(size, flags);
+    out = realloc((void *)ptr, size ? size : 1);
+    return out;
+}
+
+void kfree(const void *ptr)
+{
+    if (ptr == NULL || IS_ERR(ptr))
+        return;
+    COUNT(allocations, -1);
+    free((void *)ptr);
+}
+
+int kshim_nr_cpus(void)
+{
+    static int nr;
+
+    if (!__atomic_load_n(&nr, __ATOMIC_RELAXED)) {
+        long n = sysconf(_SC_NPROCESSORS_CONF);
+
+        __atomic_store_n(&nr, n > 0 ? (int)n : 1, __ATOMIC_RELAXED);
+    }
+    return __atomic_load_n(&nr, __ATOMIC_RELAXED);
+}
+
+int kshim_cpu(void)
+{
+    int cpu = sched_getcpu();
+
+    return cpu < 0 ? 0 : cpu % kshim_nr_cpus();
+}
+
+void *kshim_alloc_percpu(size_t size)
+{
+    if (size > KSHIM_PERCPU_STRIDE)
+        return NULL;
+    return kzalloc((size_t)kshim_nr_cpus() * KSHIM_PERCPU_STRIDE, GFP_KERNEL);
+}
+
+void free_percpu(void __percpu *ptr)
+{
+    kfree(ptr);
+}
+
+void *vmalloc_user(unsigned long size)
+{
+    return kzalloc(PAGE_ALIGN(size ? size : 1), GFP_KERNEL);
+}
+
+int remap_vmalloc_range(struct vm_area_struct *vma, void *addr, unsigned long pgoff)
+{
+    if ((unsigned long)addr & ~PAGE_MASK)
+        return -EINVAL;
+    vma->kshim_addr = (char *)addr + (pgoff << PAGE_SHIFT);
+    return 0;
+}
+
+int remap_pfn_range(struct vm_area_struct *vma, unsigned long addr, unsigned long pfn, unsigned long size,
+                    pgprot_t prot __maybe_unused)
+{
+    if (addr < vma->vm_start || size > vma->vm_end - addr)
+        return -EINVAL;
+    /* virt_to_phys is the identity here, so the pfn is the kernel address */
+    vma->kshim_addr = (char *)(pfn << PAGE_SHIFT) - (addr - vma->vm_start);
+    return 0;
+}
+
+char *kstrdup(const char *s, gfp_t flags)
+{
+    return s ? kmemdup(s, strlen(s) + 1, flags) : NULL;
+}
+
+void *kmemdup(const void *src, size_t len, gfp_t flags)
+{
+    void *dst = kmalloc(len, flags);
+
+    if (dst)
+        memcpy(dst, src, len);
+    return dst;
+}
+
+unsigned long copy_to_user(void __user *to, const void *from, unsigned long n)
+{
+    if (!user_ok(to, n)) {
+        COUNT(user_faults, 1);
+        return n;
+    }
+    user_copy(to, from, n);
+    return 0;
+}
+
+unsigned long copy_from_user(void *to, const void __user *from, unsigned long n)
+{
+    if (!user_ok(from, n)) {
+        COUNT(user_faults, 1);
+        memset(to, 0, n);
+        return n;
+    }
+    user_copy(to, from, n);
+    return 0;
+}
+
+unsigned long clear_user(void __user *to, unsigned long n)
+{
+    if (!user_ok(to, n)) {
+        COUNT(user_faults, 1);
+        return n;
+    }
+    memset(to, 0, n);
+    return 0;
+}
+
+loff_t no_llseek(struct file *file __maybe_unused, loff_t offset __maybe_unused, int whence __maybe_unused)
+{
+    return -ESPIPE;
+}
+
+loff_t noop_llseek(struct file *file, loff_t offset __maybe_unused, int whence __maybe_unused)
+{
+    return file->f_pos;
+}
+
+loff_t fixed_size_llseek(struct file *file, loff_t offset, int whence, loff_t size)
+{
+    loff_t pos;
+
+    switch (whence) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = file->f_pos + offset;
+        break;
+    case SEEK_END:
+        pos = size + offset;
+        break;
+    default:
+        return -EINVAL;
+    }
+    if (pos < 0 || pos > size)
+        return -EINVAL;
+    file->f_pos = pos;
+    return pos;
+}
+
+loff_t default_llseek(struct file *file, loff_t offset, int whence)
+{
+    return fixed_size_llseek(file, offset, whence, LLONG_MAX);
+}
+
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos, const void *from, size_t available)
+{
+    loff_t pos = *ppos;
+    size_t ret;
+
+    if (pos < 0)
+        return -EINVAL;
+    if ((size_t)pos >= available || !count)
+        return 0;
+    if (count > available - pos)
+        count = available - pos;
+    ret = copy_to_user(to, (const char *)from + pos, count);
+    if (ret == count)
+        return -EFAULT;
+    count -= ret;
+    *ppos = pos + count;
+    return count;
+}
+
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos, const void __user *from, size_t count)
+{
+    loff_t pos = *ppos;
+    size_t res;
+
+    if (pos < 0)
+        return -EINVAL;
+    if ((size_t)pos >= available || !count)
+        return 0;
+    if (count > available - pos)
+        count = available - pos;
+    res = copy_from_user((char *)to + pos, from, count);
+    if (res == count)
+        return -EFAULT;
+    count -= res;
+    *ppos = pos + count;
+    return count;
+}
+
+void iov_iter_init(struct iov_iter *i, unsigned int direction, const struct iovec *iov, unsigned long nr_segs,
+                   size_t count)
+{
+    *i = (struct iov_iter){ .iter_type = ITER_IOVEC, .data_source = direction, .count = count,
+                            .__iov = iov, .nr_segs = nr_segs };
+}
+
+void iov_iter_kvec(struct iov_iter *i, unsigned int direction, const struct kvec *kvec, unsigned long nr_segs,
+                   size_t count)
+{
+    *i = (struct iov_iter){ .iter_type = ITER_KVEC, .data_source = direction, .count = count,
+                            .kvec = kvec, .nr_segs = nr_segs };
+}
+
+/* Walk up to bytes of the iterator segment by segment; user segments go
+ * through the checked copies and a fault stops the walk, as in the kernel */
+static size_t iterate(struct iov_iter *i, char *buf, size_t bytes, bool to_iter)
+{
+    size_t done = 0;
+
+    if (bytes > i->count)
+        bytes = i->count;
+    while (done < bytes && i->nr_segs) {
+        bool user = i->iter_type != ITER_KVEC;
+        char *base = user ? i->__iov->iov_base : i->kvec->iov_base;
+        size_t seg = (user ? i->__iov->iov_len : i->kvec->iov_len) - i->iov_offset;
+        size_t len = seg < bytes - done ? seg : bytes - done;
+        size_t left = 0;
+
+        if (buf == NULL)
+            left = user ? clear_user(base + i->iov_offset, len) : (memset(base + i->iov_offset, 0, len), 0);
+        else if (to_iter)
+            left = user ? copy_to_user(base + i->iov_offset, buf + done, len)
+                        : (memcpy(base + i->iov_offset, buf + done, len), 0);
+        else
+            left = user ? copy_from_user(buf + done, base + i->iov_offset, len)
+                        : (memcpy(buf + done, base + i->iov_offset, len), 0);
+        len -= left;
+        done += len;
+        i->count -= len;
+        i->iov_offset += len;
+        if (i->iov_offset == (user ? i->__iov->iov_len : i->kvec->iov_len)) {
+            i->iov_offset = 0;
+            i->nr_segs--;
+            if (user)
+                i->__iov++;
+            else
+                i->kvec++;
+        }
+        if (left)
+            break;
+    }
+    return done;
+}
+
+size_t copy_to_iter(const void *addr, size_t bytes, struct iov_iter *i)
+{
+    return i->data_source ? 0 : iterate(i, (char *)addr, bytes, true);
+}
+
+size_t copy_from_iter(void *addr, size_t bytes, struct iov_iter *i)
+{
+    return i->data_source ? iterate(i, addr, bytes, false) : 0;
+}
+
+size_t iov_iter_zero(size_t bytes, struct iov_iter *i)
+{
+    return i->data_source ? 0 : iterate(i, NULL, bytes, true);
+}
+
+void iov_iter_advance(struct iov_iter *i, size_t bytes)
+{
+    while (bytes && i->nr_segs) {
+        size_t seg = (i->iter_type == ITER_KVEC ? i->kvec->iov_len : i->__iov->iov_len) - i->iov_offset;
+        size_t len = seg < bytes ? seg : bytes;
+
+        bytes -= len;
+        i->count -= len;
+        i->iov_offset += len;
+        if (len == seg) {
+            i->iov_offset = 0;
+            i->nr_segs--;
+            if (i->iter_type == ITER_KVEC)
+                i->kvec++;
+            else
+                i->__iov++;
+        }
+    }
+}
+
+ssize_t copy_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe, size_t len,
+                         unsigned int flags)
+{
+    size_t room = pipe->size - (pipe->head - pipe->tail);
+    size_t off = pipe->head % pipe->size;
+    struct kvec vec[2];
+    struct iov_iter iter;
+    struct kiocb kiocb;
+    ssize_t ret;
+
+    if (!in->f_op->read_iter)
+        return -EINVAL;
+    if (len > room)
+        len = room;
+    if (!len)
+        return 0;
+    /* The pipe's free space, possibly wrapped, is the destination */
+    vec[0] = (struct kvec){ pipe->data + off, len < pipe->size - off ? len : pipe->size - off };
+    vec[1] = (struct kvec){ pipe->data, len - vec[0].iov_len };
+    iov_iter_kvec(&iter, ITER_DEST, vec, vec[1].iov_len ? 2 : 1, len);
+    init_sync_kiocb(&kiocb, in);
+    kiocb.ki_pos = ppos ? *ppos : 0;
+    if (flags & SPLICE_F_NONBLOCK)
+        kiocb.ki_flags |= IOCB_NOWAIT;
+    ret = in->f_op->read_iter(&kiocb, &iter);
+    if (ret > 0) {
+        pipe->head += ret;
+        if (ppos)
+            *ppos = kiocb.ki_pos;
+    }
+    return ret;
+}
+
+ssize_t iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out, loff_t *ppos, size_t len,
+                               unsigned int flags)
+{
+    size_t avail = pipe->head - pipe->tail;
+    size_t off = pipe->tail % pipe->size;
+    struct kvec vec[2];
+    struct iov_iter iter;
+    struct kiocb kiocb;
+    ssize_t ret;
+
+    if (!out->f_op->write_iter)
+        return -EINVAL;
+    if (len > avail)
+        len = avail;
+    if (!len)
+        return 0;
+    vec[0] = (struct kvec){ pipe->data + off, len < pipe->size - off ? len : pipe->size - off };
+    vec[1] = (struct kvec){ pipe->data, len - vec[0].iov_len };
+    iov_iter_kvec(&iter, ITER_SOURCE, vec, vec[1].iov_len ? 2 : 1, len);
+    init_sync_kiocb(&kiocb, out);
+    kiocb.ki_pos = ppos ? *ppos : 0;
+    if (flags & SPLICE_F_NONBLOCK)
+        kiocb.ki_flags |= IOCB_NOWAIT;
+    ret = out->f_op->write_iter(&kiocb, &iter);
+    if (ret > 0) {
+        pipe->tail += ret;
+        if (ppos)
+            *ppos = kiocb.ki_pos;
+    }
+    return ret;
+}
+
+/*
+ * A driver registering more minors of the same major with the same fops
+ * (one cdev per minor, or several cdev_add() calls) extends the current
+ * registration; kshim.dev stays the lowest minor.
+ */
+static void registered(const struct file_operations *fops, struct cdev *cdev, dev_t dev, unsigned int count)
+{
+    pthread_mutex_lock(&state_lock);
+    if (kshim.fops == fops && kshim.minors && MAJOR(kshim.dev) == MAJOR(dev)) {
+        kshim.minors += count;
+        if (MINOR(dev) < MINOR(kshim.dev)) {
+            kshim.cdev = cdev;
+            kshim.dev = dev;
+        }
+    } else {
+        kshim.fops = fops;
+        kshim.cdev = cdev;
+        kshim.dev = dev;
+        kshim.minors = count;
+    }
+    pthread_mutex_unlock(&state_lock);
+}
+
+#define MAX_CDEVS 256
+static struct cdev *cdevs[MAX_CDEVS];
+
+struct cdev *kshim_cdev_lookup(dev_t dev)
+{
+    struct cdev *found = NULL;
+
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < MAX_CDEVS && !found; i++)
+        if (cdevs[i] && MAJOR(cdevs[i]->dev) == MAJOR(dev) && MINOR(dev) >= MINOR(cdevs[i]->dev) &&
+            MINOR(dev) - MINOR(cdevs[i]->dev) < cdevs[i]->count)
+            found = cdevs[i];
+    pthread_mutex_unlock(&state_lock);
+    return found;
+}
+
+static void track_cdev(struct cdev *old, struct cdev *new)
+{
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < MAX_CDEVS; i++) {
+        if (cdevs[i] == old) {
+            cdevs[i] = new;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&state_lock);
+}
+
+static unsigned int next_major = 240;
+
+int register_chrdev(unsigned int major, const char *name __maybe_unused, const struct file_operations *fops)
+{
+    if (major == 0)
+        major = __atomic_fetch_add(&next_major, 1, __ATOMIC_RELAXED);
+    COUNT(chrdev_regions, 1);
+    registered(fops, NULL, MKDEV(major, 0), 1);
+    return major;
+}
+
+void unregister_chrdev(unsigned int major __maybe_unused, const char *name __maybe_unused)
+{
+    COUNT(chrdev_regions, -1);
+}
+
+int alloc_chrdev_region(dev_t *dev, unsigned int baseminor, unsigned int count __maybe_unused,
+                        const char *name __maybe_unused)
+{
+    *dev = MKDEV(__atomic_fetch_add(&next_major, 1, __ATOMIC_RELAXED), baseminor);
+    COUNT(chrdev_regions, 1);
+    return 0;
+}
+
+int register_chrdev_region(dev_t from __maybe_unused, unsigned int count __maybe_unused,
+                           const char *name __maybe_unused)
+{
+    COUNT(chrdev_regions, 1);
+    return 0;
+}
+
+void unregister_chrdev_region(dev_t from __maybe_unused, unsigned int count __maybe_unused)
+{
+    COUNT(chrdev_regions, -1);
+}
+
+void cdev_init(struct cdev *cdev, const struct file_operations *fops)
+{
+    memset(cdev, 0, sizeof(*cdev));
+    cdev->ops = fops;
+}
+
+struct cdev *cdev_alloc(void)
+{
+    /* Not counted as a driver allocation: cdev_del() releases it */
+    return calloc(1, sizeof(struct cdev));
+}
+
+int cdev_add(struct cdev *cdev, dev_t dev, unsigned int count)
+{
+    cdev->dev = dev;
+    cdev->count = count;
+    COUNT(cdevs, 1);
+    track_cdev(NULL, cdev);
+    registered(cdev->ops, cdev, dev, count);
+    return 0;
+}
+
+void cdev_del(struct cdev *cdev)
+{
+    track_cdev(cdev, NULL);
+    COUNT(cdevs, -1);
+}
+
+int misc_register(struct miscdevice *misc)
+{
+    if (misc->minor == MISC_DYNAMIC_MINOR)
+        misc->minor = 63;
+    COUNT(miscs, 1);
+    registered(misc->fops, NULL, MKDEV(10, misc->minor), 1);
+    return 0;
+}
+
+void misc_deregister(struct miscdevice *misc __maybe_unused)
+{
+    COUNT(miscs, -1);
+}
+
+struct class *kshim_class_create(const char *name)
+{
+    struct class *cls = calloc(1, sizeof(*cls));
+
+    cls->name = name;
+    COUNT(classes, 1);
+    return cls;
+}
+
+void class_destroy(struct class *cls)
+{
+    if (IS_ERR_OR_NULL(cls))
+        return;
+    COUNT(classes, -1);
+    free(cls);
+}
+
+void class_unregister(struct class *cls __maybe_unused)
+{
+}
+
+#define MAX_DEVICES 256
+static struct device *devices[MAX_DEVICES];
+
+struct device *device_create(struct class *cls __maybe_unused, struct device *parent __maybe_unused, dev_t devt,
+                             void *drvdata, const char *fmt, ...)
+{
+    struct device *dev = calloc(1, sizeof(*dev));
+    va_list ap;
+
+    dev->devt = devt;
+    dev->driver_data = drvdata;
+    va_start(ap, fmt);
+    vsnprintf(dev->name, sizeof(dev->name), fmt, ap);
+    va_end(ap);
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        if (!devices[i]) {
+            devices[i] = dev;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&state_lock);
+    COUNT(devices, 1);
+    return dev;
+}
+
+void device_destroy(struct class *cls __maybe_unused, dev_t devt)
+{
+    struct device *dev = NULL;
+
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < MAX_DEVICES && !dev; i++) {
+        if (devices[i] && devices[i]->devt == devt) {
+            dev = devices[i];
+            devices[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&state_lock);
+    /* The harness only cares that every device is destroyed */
+    COUNT(devices, -1);
+    free(dev);
+}
+
+struct device *kshim_device(int index)
+{
+    struct device *dev = NULL;
+
+    pthread_mutex_lock(&state_lock);
+    for (int i = 0; i < MAX_DEVICES && !dev; i++)
+        if (devices[i] && index-- == 0)
+            dev = devices[i];
+    pthread_mutex_unlock(&state_lock);
+    return dev;
+}
+
+int device_create_file(struct device *dev, const struct device_attribute *attr)
+{
+    if (IS_ERR_OR_NULL(dev))
+        return -EINVAL;
+    for (int i = 0; i < KSHIM_MAX_ATTRS; i++) {
+        if (!dev->attrs[i]) {
+            dev->attrs[i] = attr;
+            return 0;
+        }
+    }
+    return -ENOSPC;
+}
+
+void device_remove_file(struct device *dev, const struct device_attribute *attr)
+{
+    if (IS_ERR_OR_NULL(dev))
+        return;
+    for (int i = 0; i < KSHIM_MAX_ATTRS; i++)
+        if (dev->attrs[i] == attr)
+            dev->attrs[i] = NULL;
+}
+
+void init_waitqueue_head(wait_queue_head_t *wq)
+{
+    pthread_mutex_init(&wq->lock, NULL);
+    pthread_cond_init(&wq->cond, NULL);
+    wq->seq = 0;
+}
+
+void __wake_up(wait_queue_head_t *wq)
+{
+    pthread_mutex_lock(&wq->lock);
+    __atomic_add_fetch(&wq->seq, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&wq->cond);
+    pthread_mutex_unlock(&wq->lock);
+}
+
+void kshim_wait(wait_queue_head_t *wq, unsigned long seq, long timeout_ms)
+{
+    struct timespec deadline;
+
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_mutex_lock(&wq->lock);
+    while (__atomic_load_n(&wq->seq, __ATOMIC_ACQUIRE) == seq) {
+        if (timeout_ms < 0)
+            pthread_cond_wait(&wq->cond, &wq->lock);
+        else if (pthread_cond_timedwait(&wq->cond, &wq->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    pthread_mutex_unlock(&wq->lock);
+}
+
+#define MAX_PARAMS 32
+
+static struct {
+    const char *name;
+    void *value;
+    const char *type;
+} params[MAX_PARAMS];
+static int nparams;
+
+void kshim_register_param(const char *name, void *value, const char *type)
+{
+    /* Constructors run single-threaded before main */
+    if (nparams < MAX_PARAMS) {
+        params[nparams].name = name;
+        params[nparams].value = value;
+        params[nparams].type = type;
+        nparams++;
+    }
+}
+
+int kshim_set_param(const char *name, const char *value)
+{
+    for (int i = 0; i < nparams; i++) {
+        const char *type = params[i].type;
+        void *p = params[i].value;
+        char *end;
+        long long v;
+
+        if (strcmp(params[i].name, name) != 0)
+            continue;
+        if (strcmp(type, "charp") == 0) {
+            *(const char **)p = value;
+            return 0;
+        }
+        if (strcmp(type, "bool") == 0 || strcmp(type, "invbool") == 0) {
+            bool on = strchr("yY1", value[0]) != NULL;
+            *(bool *)p = strcmp(type, "bool") == 0 ? on : !on;
+            return 0;
+        }
+        v = strtoll(value, &end, 0);
+        if (*end)
+            return -EINVAL;
+        if (strcmp(type, "int") == 0 || strcmp(type, "uint") == 0)
+            *(int *)p = v;
+        else if (strcmp(type, "long") == 0 || strcmp(type, "ulong") == 0)
+            *(long *)p = v;
+        else if (strcmp(type, "short") == 0 || strcmp(type, "ushort") == 0)
+            *(short *)p = v;
+        else if (strcmp(type, "byte") == 0)
+            *(unsigned char *)p = v;
+        else
+            return -EINVAL;
+        return 0;
+    }
+    return -ENOENT;
+}
+
+long kshim_param_value(const char *name)
+{
+    for (int i = 0; i < nparams; i++) {
+        const char *type = params[i].type;
+
+        if (strcmp(params[i].name, name) != 0)
+            continue;
+        if (strcmp(type, "int") == 0)
+            return *(int *)params[i].value;
+        if (strcmp(type, "uint") == 0)
+            return *(unsigned int *)params[i].value;
+        if (strcmp(type, "long") == 0 || strcmp(type, "ulong") == 0)
+            return *(long *)params[i].value;
+        if (strcmp(type, "short") == 0)
+            return *(short *)params[i].value;
+        if (strcmp(type, "ushort") == 0)
+            return *(unsigned short *)params[i].value;
+        return -1;
+    }
+    return -1;
+}
+
+struct task_struct *kshim_current(void)
+{
+    static __thread struct task_struct task;
+
+    if (task.pid == 0) {
+        task.pid = getpid();
+        strcpy(task.comm, "kshim");
+    }
+    return &task;
+}
+
+void msleep(unsigned int msecs)
+{
+    struct timespec ts = { msecs / 1000, (long)(msecs % 1000) * 1000000L };
+
+    nanosleep(&ts, NULL);
+}
+
+void udelay(unsigned long usecs)
+{
+    struct timespec ts = { usecs / 1000000, (long)(usecs % 1000000) * 1000L };
+
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,679 @@
+/*
+ * Userspace stand-ins for the kernel APIs character drivers use, so a
+ * driver can be compiled, linked against kshim.c and driven by harness.c.
+ * Every <linux/...> header in include/ resolves to this file.
+ */
+#ifndef KSHIM_H
+#define KSHIM_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Kernel-only errno values */
+#define ERESTARTSYS 512
+
+/* Annotations */
+#define __user
+#define __kernel
+#define __iomem
+#define __force
+#define __init
+#define __exit
+#define __initdata
+#define __exitdata
+#define __read_mostly
+#define __must_check
+#define __maybe_unused __attribute__((unused))
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+#define __aligned(x) __attribute__((aligned(x)))
+#define ____cacheline_aligned __aligned(64)
+#define ____cacheline_aligned_in_smp __aligned(64)
+#define fallthrough __attribute__((fallthrough))
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u8 __u8;
+typedef u16 __u16;
+typedef u32 __u32;
+typedef u64 __u64;
+typedef unsigned short umode_t;
+typedef unsigned int fmode_t;
+typedef unsigned int gfp_t;
+
+/* Module metadata and parameters */
+struct module;
+#define THIS_MODULE ((struct module *)0)
+#define MODULE_LICENSE(x) extern int kshim_module_meta
+#define MODULE_AUTHOR(x) extern int kshim_module_meta
+#define MODULE_DESCRIPTION(x) extern int kshim_module_meta
+#define MODULE_VERSION(x) extern int kshim_module_meta
+#define MODULE_ALIAS(x) extern int kshim_module_meta
+#define MODULE_PARM_DESC(name, desc) extern int kshim_module_meta
+/* Parameters register themselves so the harness can set them before init */
+void kshim_register_param(const char *name, void *value, const char *type);
+/* type is stringized before expansion: <stdbool.h> makes bool a macro */
+#define kshim_module_param(name, value, type) \
+    static void __attribute__((constructor)) kshim_param_##name(void) \
+    { kshim_register_param(#name, &(value), type); }
+#define module_param_named(name, value, type, perm) kshim_module_param(name, value, #type)
+#define module_param(name, type, perm) kshim_module_param(name, name, #type)
+#define EXPORT_SYMBOL(sym) extern int kshim_module_meta
+#define EXPORT_SYMBOL_GPL(sym) extern int kshim_module_meta
+
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + ((c) > 255 ? 255 : (c)))
+#define LINUX_VERSION_CODE KERNEL_VERSION(6, 8, 0)
+
+/* The harness calls these instead of the kernel's module loader */
+#define module_init(fn) int kshim_module_init(void) { return fn(); }
+#define module_exit(fn) void kshim_module_exit(void) { fn(); }
+
+/* printk */
+#define KERN_SOH "\001"
+#define KERN_EMERG KERN_SOH "0"
+#define KERN_ALERT KERN_SOH "1"
+#define KERN_CRIT KERN_SOH "2"
+#define KERN_ERR KERN_SOH "3"
+#define KERN_WARNING KERN_SOH "4"
+#define KERN_NOTICE KERN_SOH "5"
+#define KERN_INFO KERN_SOH "6"
+#define KERN_DEBUG KERN_SOH "7"
+#define KERN_CONT KERN_SOH "c"
+#ifndef pr_fmt
+#define pr_fmt(fmt) fmt
+#endif
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+#define pr_emerg(fmt, ...) printk(KERN_EMERG pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_alert(fmt, ...) printk(KERN_ALERT pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_crit(fmt, ...) printk(KERN_CRIT pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_err(fmt, ...) printk(KERN_ERR pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_warn(fmt, ...) printk(KERN_WARNING pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_warning pr_warn
+#define pr_notice(fmt, ...) printk(KERN_NOTICE pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_info(fmt, ...) printk(KERN_INFO pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_cont(fmt, ...) printk(KERN_CONT fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...) printk(KERN_DEBUG pr_fmt(fmt), ##__VA_ARGS__)
+#define dev_err(dev, fmt, ...) printk(KERN_ERR fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...) printk(KERN_WARNING fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...) printk(KERN_INFO fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...) printk(KERN_DEBUG fmt, ##__VA_ARGS__)
+
+/* Helpers from linux/kernel.h */
+#define min(a, b) ({ __typeof__(a) _min_a = (a); __typeof__(b) _min_b = (b); _min_a < _min_b ? _min_a : _min_b; })
+#define max(a, b) ({ __typeof__(a) _max_a = (a); __typeof__(b) _max_b = (b); _max_a > _max_b ? _max_a : _max_b; })
+#define min_t(type, a, b) min((type)(a), (type)(b))
+#define max_t(type, a, b) max((type)(a), (type)(b))
+#define clamp(val, lo, hi) min(max(val, lo), hi)
+#define swap(a, b) do { __typeof__(a) _swap = (a); (a) = (b); (b) = _swap; } while (0)
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#define BUG() __builtin_trap()
+#define BUG_ON(cond) do { if (cond) BUG(); } while (0)
+#define WARN_ON(cond) ({ int _warn = !!(cond); if (_warn) printk(KERN_WARNING "WARN_ON(%s)\n", #cond); _warn; })
+#define WARN_ON_ONCE WARN_ON
+#define BUILD_BUG_ON(cond) _Static_assert(!(cond), #cond)
+#define is_power_of_2(n) ((n) != 0 && (((n) & ((n) - 1)) == 0))
+#define roundup_pow_of_two(n) ((n) <= 1 ? 1UL : 1UL << (64 - __builtin_clzl((unsigned long)(n) - 1)))
+#define rounddown_pow_of_two(n) (1UL << (63 - __builtin_clzl((unsigned long)(n))))
+#define scnprintf snprintf
+
+/* Error pointers */
+#define MAX_ERRNO 4095
+#define IS_ERR_VALUE(x) ((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+static inline void *ERR_PTR(long error) { return (void *)error; }
+static inline long PTR_ERR(const void *ptr) { return (long)ptr; }
+static inline bool IS_ERR(const void *ptr) { return IS_ERR_VALUE((unsigned long)ptr); }
+static inline bool IS_ERR_OR_NULL(const void *ptr) { return !ptr || IS_ERR_VALUE((unsigned long)ptr); }
+#define PTR_ERR_OR_ZERO(ptr) (IS_ERR(ptr) ? PTR_ERR(ptr) : 0)
+
+/* Memory */
+#define GFP_KERNEL 0u
+#define GFP_ATOMIC 1u
+#define GFP_NOWAIT 2u
+#define __GFP_ZERO 0x100u
+void *kmalloc(size_t size, gfp_t flags);
+void *kzalloc(size_t size, gfp_t flags);
+void *kcalloc(size_t n, size_t size, gfp_t flags);
+void *krealloc(const void *ptr, size_t size, gfp_t flags);
+void kfree(const void *ptr);
+char *kstrdup(const char *s, gfp_t flags);
+void *kmemdup(const void *src, size_t len, gfp_t flags);
+#define kmalloc_array(n, size, flags) kcalloc(n, size, flags)
+#define vmalloc(size) kmalloc(size, GFP_KERNEL)
+#define vzalloc(size) kzalloc(size, GFP_KERNEL)
+#define vfree(ptr) kfree(ptr)
+#define kvmalloc(size, flags) kmalloc(size, flags)
+#define kvzalloc(size, flags) kzalloc(size, flags)
+#define kvfree(ptr) kfree(ptr)
+/* Page-aligned and zeroed, so it can back a mapping; freed with vfree */
+void *vmalloc_user(unsigned long size);
+
+/* User copies; the harness tells kshim which user range is valid */
+unsigned long copy_to_user(void __user *to, const void *from, unsigned long n);
+unsigned long copy_from_user(void *to, const void __user *from, unsigned long n);
+unsigned long clear_user(void __user *to, unsigned long n);
+#define access_ok(...) 1
+#define put_user(x, ptr) ({ __typeof__(*(ptr)) _put = (x); copy_to_user((ptr), &_put, sizeof(_put)) ? -EFAULT : 0; })
+#define get_user(x, ptr) ({ __typeof__(*(ptr)) _get; int _ret = copy_from_user(&_get, (ptr), sizeof(_get)) ? -EFAULT : 0; \
+                            if (!_ret) (x) = _get; _ret; })
+
+/* Device numbers */
+#define MINORBITS 20
+#define MINORMASK ((1U << MINORBITS) - 1)
+#define MAJOR(dev) ((unsigned int)((dev) >> MINORBITS))
+#define MINOR(dev) ((unsigned int)((dev) & MINORMASK))
+#define MKDEV(ma, mi) ((dev_t)(((dev_t)(ma) << MINORBITS) | (mi)))
+
+/* Files */
+#define FMODE_READ 0x1u
+#define FMODE_WRITE 0x2u
+#define FMODE_LSEEK 0x4u
+#define FMODE_PREAD 0x8u
+#define FMODE_PWRITE 0x10u
+#define FMODE_STREAM 0x200000u
+#define SEEK_DATA 3
+#define SEEK_HOLE 4
+
+struct inode {
+    dev_t i_rdev;
+    umode_t i_mode;
+    loff_t i_size;
+    struct cdev *i_cdev;
+    void *i_private;
+};
+static inline unsigned int iminor(const struct inode *inode) { return MINOR(inode->i_rdev); }
+static inline unsigned int imajor(const struct inode *inode) { return MAJOR(inode->i_rdev); }
+
+struct file;
+struct file_operations;
+
+struct path {
+    void *dentry;
+};
+
+struct file {
+    struct path f_path;
+    struct inode *f_inode;
+    const struct file_operations *f_op;
+    unsigned int f_flags;
+    fmode_t f_mode;
+    loff_t f_pos;
+    void *private_data;
+};
+
+/* Wait queues. A waiter snapshots seq before testing its condition, so a
+ * wake-up between the test and the wait is never lost, and the condition
+ * runs without the queue lock held. */
+typedef struct wait_queue_head {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned long seq;
+} wait_queue_head_t;
+#define __WAIT_QUEUE_HEAD_INITIALIZER(name) { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 }
+#define DECLARE_WAIT_QUEUE_HEAD(name) wait_queue_head_t name = __WAIT_QUEUE_HEAD_INITIALIZER(name)
+void init_waitqueue_head(wait_queue_head_t *wq);
+void __wake_up(wait_queue_head_t *wq);
+/* Waits until woken or timeout_ms passes (< 0: forever) */
+void kshim_wait(wait_queue_head_t *wq, unsigned long seq, long timeout_ms);
+#define wake_up(wq) __wake_up(wq)
+#define wake_up_all(wq) __wake_up(wq)
+#define wake_up_interruptible(wq) __wake_up(wq)
+#define wake_up_interruptible_all(wq) __wake_up(wq)
+#define wake_up_interruptible_sync(wq) __wake_up(wq)
+#define wake_up_poll(wq, mask) __wake_up(wq)
+#define wake_up_interruptible_poll(wq, mask) __wake_up(wq)
+#define wait_event(wq, condition) do { \
+        for (;;) { \
+            unsigned long _seq = __atomic_load_n(&(wq).seq, __ATOMIC_ACQUIRE); \
+            if (condition) \
+                break; \
+            kshim_wait(&(wq), _seq, -1); \
+        } \
+    } while (0)
+#define wait_event_interruptible(wq, condition) ({ wait_event(wq, condition); 0; })
+#define wait_event_killable(wq, condition) wait_event_interruptible(wq, condition)
+/* Returns the jiffies left (at least 1) once condition holds, or 0 on timeout */
+#define wait_event_timeout(wq, condition, timeout) ({ \
+        long _left = (long)(timeout); \
+        for (;;) { \
+            unsigned long _seq = __atomic_load_n(&(wq).seq, __ATOMIC_ACQUIRE); \
+            if (condition) { \
+                _left = _left > 0 ? _left : 1; \
+                break; \
+            } \
+            if (_left <= 0) { \
+                _left = 0; \
+                break; \
+            } \
+            kshim_wait(&(wq), _seq, _left * 1000 / HZ); \
+            _left -= 1; \
+        } \
+        _left; \
+    })
+#define wait_event_interruptible_timeout(wq, condition, timeout) wait_event_timeout(wq, condition, timeout)
+
+/* poll; the harness calls ->poll directly and never sleeps in it */
+typedef unsigned int __poll_t;
+#define EPOLLIN 0x001u
+#define EPOLLPRI 0x002u
+#define EPOLLOUT 0x004u
+#define EPOLLERR 0x008u
+#define EPOLLHUP 0x010u
+#define EPOLLRDNORM 0x040u
+#define EPOLLRDBAND 0x080u
+#define EPOLLWRNORM 0x100u
+#define EPOLLWRBAND 0x200u
+#define POLLIN EPOLLIN
+#define POLLPRI EPOLLPRI
+#define POLLOUT EPOLLOUT
+#define POLLERR EPOLLERR
+#define POLLHUP EPOLLHUP
+#define POLLRDNORM EPOLLRDNORM
+#define POLLRDBAND EPOLLRDBAND
+#define POLLWRNORM EPOLLWRNORM
+#define POLLWRBAND EPOLLWRBAND
+typedef struct poll_table_struct {
+    int waits;      /* poll_wait() calls */
+} poll_table;
+struct file;
+static inline void poll_wait(struct file *filp __maybe_unused, wait_queue_head_t *wq __maybe_unused,
+                             poll_table *p)
+{
+    if (p)
+        p->waits++;
+}
+
+/* Memory mapping. The harness hands ->mmap a vma whose addresses are
+ * only a range to validate against; the remap helpers record the kernel
+ * address that backs it in kshim_addr, which the harness then uses as the
+ * "user" mapping. */
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+#define PAGE_MASK (~(PAGE_SIZE - 1))
+#define PAGE_ALIGN(addr) (((addr) + PAGE_SIZE - 1) & PAGE_MASK)
+#define VM_READ 0x1UL
+#define VM_WRITE 0x2UL
+#define VM_EXEC 0x4UL
+#define VM_SHARED 0x8UL
+#define VM_MAYWRITE 0x20UL
+#define VM_IO 0x4000UL
+#define VM_DONTEXPAND 0x40000UL
+#define VM_DONTDUMP 0x4000000UL
+#define VM_PFNMAP 0x400UL
+typedef struct { unsigned long pgprot; } pgprot_t;
+struct vm_area_struct;
+struct vm_operations_struct {
+    void (*open)(struct vm_area_struct *);
+    void (*close)(struct vm_area_struct *);
+};
+struct vm_area_struct {
+    unsigned long vm_start;
+    unsigned long vm_end;
+    unsigned long vm_pgoff;
+    unsigned long vm_flags;
+    pgprot_t vm_page_prot;
+    const struct vm_operations_struct *vm_ops;
+    void *vm_private_data;
+    struct file *vm_file;
+    void *kshim_addr;
+};
+static inline void vm_flags_set(struct vm_area_struct *vma, unsigned long flags) { vma->vm_flags |= flags; }
+static inline void vm_flags_clear(struct vm_area_struct *vma, unsigned long flags) { vma->vm_flags &= ~flags; }
+#define virt_to_phys(addr) ((unsigned long)(addr))
+#define pgprot_noncached(prot) (prot)
+int remap_vmalloc_range(struct vm_area_struct *vma, void *addr, unsigned long pgoff);
+int remap_pfn_range(struct vm_area_struct *vma, unsigned long addr, unsigned long pfn, unsigned long size,
+                    pgprot_t prot);
+
+/* Vectored I/O. An iov_iter walks user iovecs (checked like any user
+ * copy) or kernel kvecs (the splice helpers' bounce buffers). */
+#define ITER_DEST 0
+#define ITER_SOURCE 1
+#define READ ITER_DEST
+#define WRITE ITER_SOURCE
+#define IOCB_NOWAIT 0x8
+#ifndef UIO_MAXIOV
+#define UIO_MAXIOV 1024
+#endif
+struct kvec {
+    void *iov_base;
+    size_t iov_len;
+};
+enum iter_type { ITER_UBUF, ITER_IOVEC, ITER_KVEC };
+struct iov_iter {
+    u8 iter_type;
+    bool data_source;       /* ITER_SOURCE: data flows out of the iter */
+    size_t iov_offset;      /* into the current segment */
+    size_t count;           /* bytes left */
+    union {
+        const struct iovec *__iov;
+        const struct kvec *kvec;
+    };
+    unsigned long nr_segs;
+};
+struct kiocb {
+    struct file *ki_filp;
+    loff_t ki_pos;
+    int ki_flags;
+};
+static inline size_t iov_iter_count(const struct iov_iter *i) { return i->count; }
+static inline bool iov_iter_is_kvec(const struct iov_iter *i) { return i->iter_type == ITER_KVEC; }
+static inline bool user_backed_iter(const struct iov_iter *i) { return i->iter_type != ITER_KVEC; }
+static inline int iov_iter_rw(const struct iov_iter *i) { return i->data_source ? WRITE : READ; }
+void iov_iter_init(struct iov_iter *i, unsigned int direction, const struct iovec *iov, unsigned long nr_segs,
+                   size_t count);
+void iov_iter_kvec(struct iov_iter *i, unsigned int direction, const struct kvec *kvec, unsigned long nr_segs,
+                   size_t count);
+size_t copy_to_iter(const void *addr, size_t bytes, struct iov_iter *i);
+size_t copy_from_iter(void *addr, size_t bytes, struct iov_iter *i);
+size_t iov_iter_zero(size_t bytes, struct iov_iter *i);
+void iov_iter_advance(struct iov_iter *i, size_t bytes);
+static inline void init_sync_kiocb(struct kiocb *kiocb, struct file *filp)
+{
+    memset(kiocb, 0, sizeof(*kiocb));
+    kiocb->ki_filp = filp;
+    kiocb->ki_pos = filp->f_pos;
+}
+
+/* Pipes for splice: a plain byte FIFO with the kernel's default capacity */
+#define PIPE_DEF_BUFFERS 16
+#ifndef SPLICE_F_MOVE       /* <fcntl.h> has them under _GNU_SOURCE */
+#define SPLICE_F_MOVE 0x01
+#define SPLICE_F_NONBLOCK 0x02
+#define SPLICE_F_MORE 0x04
+#endif
+struct pipe_inode_info {
+    char *data;
+    size_t head;        /* bytes ever added */
+    size_t tail;        /* bytes ever taken */
+    size_t size;
+};
+
+struct file_operations {
+    struct module *owner;
+    loff_t (*llseek)(struct file *, loff_t, int);
+    ssize_t (*read)(struct file *, char __user *, size_t, loff_t *);
+    ssize_t (*write)(struct file *, const char __user *, size_t, loff_t *);
+    ssize_t (*read_iter)(struct kiocb *, struct iov_iter *);
+    ssize_t (*write_iter)(struct kiocb *, struct iov_iter *);
+    __poll_t (*poll)(struct file *, struct poll_table_struct *);
+    ssize_t (*splice_write)(struct pipe_inode_info *, struct file *, loff_t *, size_t, unsigned int);
+    ssize_t (*splice_read)(struct file *, loff_t *, struct pipe_inode_info *, size_t, unsigned int);
+    long (*unlocked_ioctl)(struct file *, unsigned int, unsigned long);
+    long (*compat_ioctl)(struct file *, unsigned int, unsigned long);
+    int (*mmap)(struct file *, struct vm_area_struct *);
+    int (*open)(struct inode *, struct file *);
+    int (*flush)(struct file *, void *);
+    int (*release)(struct inode *, struct file *);
+    int (*fsync)(struct file *, loff_t, loff_t, int);
+    int (*fasync)(int, struct file *, int);
+};
+
+static inline struct inode *file_inode(const struct file *f) { return f->f_inode; }
+static inline int nonseekable_open(struct inode *inode __maybe_unused, struct file *filp)
+{
+    filp->f_mode &= ~(FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE);
+    return 0;
+}
+static inline int stream_open(struct inode *inode __maybe_unused, struct file *filp)
+{
+    filp->f_mode &= ~(FMODE_LSEEK | FMODE_PREAD | FMODE_PWRITE);
+    filp->f_mode |= FMODE_STREAM;
+    return 0;
+}
+loff_t no_llseek(struct file *file, loff_t offset, int whence);
+loff_t noop_llseek(struct file *file, loff_t offset, int whence);
+loff_t default_llseek(struct file *file, loff_t offset, int whence);
+loff_t fixed_size_llseek(struct file *file, loff_t offset, int whence, loff_t size);
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos, const void *from, size_t available);
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos, const void __user *from, size_t count);
+/* Generic splice through ->read_iter/->write_iter with a bounce buffer */
+ssize_t copy_splice_read(struct file *in, loff_t *ppos, struct pipe_inode_info *pipe, size_t len,
+                         unsigned int flags);
+ssize_t iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out, loff_t *ppos, size_t len,
+                               unsigned int flags);
+#define generic_file_splice_read copy_splice_read
+
+/* Character device registration */
+int register_chrdev(unsigned int major, const char *name, const struct file_operations *fops);
+void unregister_chrdev(unsigned int major, const char *name);
+int alloc_chrdev_region(dev_t *dev, unsigned int baseminor, unsigned int count, const char *name);
+int register_chrdev_region(dev_t from, unsigned int count, const char *name);
+void unregister_chrdev_region(dev_t from, unsigned int count);
+
+struct cdev {
+    struct module *owner;
+    const struct file_operations *ops;
+    dev_t dev;
+    unsigned int count;
+};
+
+void cdev_init(struct cdev *cdev, const struct file_operations *fops);
+struct cdev *cdev_alloc(void);
+int cdev_add(struct cdev *cdev, dev_t dev, unsigned int count);
+void cdev_del(struct cdev *cdev);
+
+#define MISC_DYNAMIC_MINOR 255
+struct miscdevice {
+    int minor;
+    const char *name;
+    const struct file_operations *fops;
+    umode_t mode;
+    struct device *this_device;
+};
+int misc_register(struct miscdevice *misc);
+void misc_deregister(struct miscdevice *misc);
+
+/* Device model */
+struct class {
+    const char *name;
+};
+/* Attributes are recorded per device; the harness prints them after the run */
+#define KSHIM_MAX_ATTRS 8
+struct device_attribute;
+struct device {
+    dev_t devt;
+    void *driver_data;
+    char name[32];
+    const struct device_attribute *attrs[KSHIM_MAX_ATTRS];
+};
+/* class_create() lost its owner argument in 6.4; accept both forms */
+#define KSHIM_LAST_OF_2(a, b, ...) b
+#define class_create(...) kshim_class_create(KSHIM_LAST_OF_2(__VA_ARGS__, __VA_ARGS__))
+struct class *kshim_class_create(const char *name);
+void class_destroy(struct class *cls);
+void class_unregister(struct class *cls);
+struct device *device_create(struct class *cls, struct device *parent, dev_t devt, void *drvdata,
+                             const char *fmt, ...);
+void device_destroy(struct class *cls, dev_t devt);
+static inline void *dev_get_drvdata(const struct device *dev) { return dev->driver_data; }
+static inline void dev_set_drvdata(struct device *dev, void *data) { dev->driver_data = data; }
+
+/* sysfs */
+struct attribute {
+    const char *name;
+    umode_t mode;
+};
+struct device_attribute {
+    struct attribute attr;
+    ssize_t (*show)(struct device *dev, struct device_attribute *attr, char *buf);
+    ssize_t (*store)(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+};
+#define __ATTR(_name, _mode, _show, _store) \
+    { .attr = { .name = #_name, .mode = (_mode) }, .show = (_show), .store = (_store) }
+#define __ATTR_RO(_name) __ATTR(_name, 0444, _name##_show, NULL)
+#define __ATTR_WO(_name) __ATTR(_name, 0200, NULL, _name##_store)
+#define __ATTR_RW(_name) __ATTR(_name, 0644, _name##_show, _name##_store)
+#define DEVICE_ATTR(_name, _mode, _show, _store) \
+    struct device_attribute dev_attr_##_name = __ATTR(_name, _mode, _show, _store)
+#define DEVICE_ATTR_RO(_name) struct device_attribute dev_attr_##_name = __ATTR_RO(_name)
+#define DEVICE_ATTR_WO(_name) struct device_attribute dev_attr_##_name = __ATTR_WO(_name)
+#define DEVICE_ATTR_RW(_name) struct device_attribute dev_attr_##_name = __ATTR_RW(_name)
+int device_create_file(struct device *dev, const struct device_attribute *attr);
+void device_remove_file(struct device *dev, const struct device_attribute *attr);
+/* sysfs buffers are one page */
+#define sysfs_emit(buf, ...) scnprintf((buf), PAGE_SIZE, __VA_ARGS__)
+#define sysfs_emit_at(buf, at, ...) scnprintf((buf) + (at), PAGE_SIZE - (at), __VA_ARGS__)
+
+/* Locking, backed by pthreads so sanitizers see real synchronisation */
+struct mutex {
+    pthread_mutex_t lock;
+};
+#define DEFINE_MUTEX(name) struct mutex name = { PTHREAD_MUTEX_INITIALIZER }
+#define mutex_init(m) pthread_mutex_init(&(m)->lock, NULL)
+#define mutex_destroy(m) pthread_mutex_destroy(&(m)->lock)
+#define mutex_lock(m) pthread_mutex_lock(&(m)->lock)
+#define mutex_unlock(m) pthread_mutex_unlock(&(m)->lock)
+#define mutex_trylock(m) (pthread_mutex_trylock(&(m)->lock) == 0)
+#define mutex_lock_interruptible(m) (pthread_mutex_lock(&(m)->lock), 0)
+#define mutex_lock_killable(m) mutex_lock_interruptible(m)
+
+typedef struct {
+    pthread_mutex_t lock;
+} spinlock_t;
+#define DEFINE_SPINLOCK(name) spinlock_t name = { PTHREAD_MUTEX_INITIALIZER }
+#define __SPIN_LOCK_UNLOCKED(name) { PTHREAD_MUTEX_INITIALIZER }
+#define spin_lock_init(l) pthread_mutex_init(&(l)->lock, NULL)
+#define spin_lock(l) pthread_mutex_lock(&(l)->lock)
+#define spin_unlock(l) pthread_mutex_unlock(&(l)->lock)
+#define spin_trylock(l) (pthread_mutex_trylock(&(l)->lock) == 0)
+#define spin_lock_bh spin_lock
+#define spin_unlock_bh spin_unlock
+#define spin_lock_irq spin_lock
+#define spin_unlock_irq spin_unlock
+#define spin_lock_irqsave(l, flags) do { (flags) = 0; spin_lock(l); } while (0)
+#define spin_unlock_irqrestore(l, flags) do { (void)(flags); spin_unlock(l); } while (0)
+
+struct rw_semaphore {
+    pthread_rwlock_t lock;
+};
+#define DECLARE_RWSEM(name) struct rw_semaphore name = { PTHREAD_RWLOCK_INITIALIZER }
+#define init_rwsem(s) pthread_rwlock_init(&(s)->lock, NULL)
+#define down_read(s) pthread_rwlock_rdlock(&(s)->lock)
+#define up_read(s) pthread_rwlock_unlock(&(s)->lock)
+#define down_write(s) pthread_rwlock_wrlock(&(s)->lock)
+#define up_write(s) pthread_rwlock_unlock(&(s)->lock)
+#define down_read_trylock(s) (pthread_rwlock_tryrdlock(&(s)->lock) == 0)
+#define down_write_trylock(s) (pthread_rwlock_trywrlock(&(s)->lock) == 0)
+
+typedef struct {
+    int counter;
+} atomic_t;
+#define ATOMIC_INIT(i) { (i) }
+#define atomic_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_set(v, i) __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic_add(i, v) ((void)__atomic_add_fetch(&(v)->counter, (i), __ATOMIC_RELAXED))
+#define atomic_sub(i, v) ((void)__atomic_sub_fetch(&(v)->counter, (i), __ATOMIC_RELAXED))
+#define atomic_inc(v) atomic_add(1, v)
+#define atomic_dec(v) atomic_sub(1, v)
+#define atomic_inc_return(v) __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define atomic_dec_return(v) __atomic_sub_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define atomic_dec_and_test(v) (atomic_dec_return(v) == 0)
+#define atomic_cmpxchg(v, old, new) ({ int _old = (old); \
+    __atomic_compare_exchange_n(&(v)->counter, &_old, (new), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); _old; })
+#define READ_ONCE(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, val) __atomic_store_n(&(x), (val), __ATOMIC_RELAXED)
+#define smp_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/*
+ * Per-CPU data: alloc_percpu() hands out one KSHIM_PERCPU_STRIDE slot per
+ * CPU, so each CPU's copy sits on its own pages. "This CPU" is the one
+ * the calling thread runs on (sched_getcpu()); threads can migrate, so the
+ * this_cpu_*() operations are relaxed atomics rather than plain stores.
+ */
+#define __percpu
+#define KSHIM_PERCPU_STRIDE 4096
+int kshim_nr_cpus(void);
+int kshim_cpu(void);
+#define nr_cpu_ids kshim_nr_cpus()
+#define num_possible_cpus() kshim_nr_cpus()
+#define num_online_cpus() kshim_nr_cpus()
+#define for_each_possible_cpu(cpu) for ((cpu) = 0; (cpu) < kshim_nr_cpus(); (cpu)++)
+#define for_each_online_cpu(cpu) for_each_possible_cpu(cpu)
+#define smp_processor_id() kshim_cpu()
+#define raw_smp_processor_id() kshim_cpu()
+#define get_cpu() kshim_cpu()
+#define put_cpu() ((void)0)
+#define preempt_disable() ((void)0)
+#define preempt_enable() ((void)0)
+void *kshim_alloc_percpu(size_t size);
+#define alloc_percpu(type) ((type __percpu *)kshim_alloc_percpu(sizeof(type)))
+#define alloc_percpu_gfp(type, gfp) alloc_percpu(type)
+void free_percpu(void __percpu *ptr);
+#define per_cpu_ptr(ptr, cpu) ((__typeof__(ptr))((char *)(ptr) + (size_t)(cpu) * KSHIM_PERCPU_STRIDE))
+#define this_cpu_ptr(ptr) per_cpu_ptr(ptr, kshim_cpu())
+#define raw_cpu_ptr(ptr) this_cpu_ptr(ptr)
+#define this_cpu_add(pcp, val) ((void)__atomic_add_fetch(this_cpu_ptr(&(pcp)), (val), __ATOMIC_RELAXED))
+#define this_cpu_sub(pcp, val) this_cpu_add(pcp, -(val))
+#define this_cpu_inc(pcp) this_cpu_add(pcp, 1)
+#define this_cpu_dec(pcp) this_cpu_sub(pcp, 1)
+#define this_cpu_read(pcp) __atomic_load_n(this_cpu_ptr(&(pcp)), __ATOMIC_RELAXED)
+#define this_cpu_write(pcp, val) __atomic_store_n(this_cpu_ptr(&(pcp)), (val), __ATOMIC_RELAXED)
+
+/* Tasks and time */
+struct task_struct {
+    pid_t pid;
+    char comm[16];
+};
+struct task_struct *kshim_current(void);
+#define current kshim_current()
+#define signal_pending(task) 0
+#define capable(cap) 1
+#define HZ 100
+extern unsigned long volatile jiffies;
+void msleep(unsigned int msecs);
+void udelay(unsigned long usecs);
+#define mdelay(ms) udelay((ms) * 1000UL)
+#define cond_resched() ((void)0)
+#define might_sleep() ((void)0)
+
+/* Harness side (kshim.c) */
+struct kshim_state {
+    const struct file_operations *fops;     /* last registered */
+    struct cdev *cdev;
+    dev_t dev;                              /* first minor */
+    unsigned int minors;                    /* minors served by fops */
+    int chrdev_regions;                     /* registered minus unregistered */
+    int cdevs;
+    int classes;
+    int devices;
+    int miscs;
+    long allocations;                       /* live kmalloc blocks */
+    long user_faults;                       /* copies outside the user buffer */
+    long printk_calls;
+};
+extern struct kshim_state kshim;
+void kshim_set_user_range(const void *base, size_t len);
+/* Parses value by the parameter's module_param type; -ENOENT/-EINVAL */
+int kshim_set_param(const char *name, const char *value);
+/* Current value of an integer parameter, or -1 */
+long kshim_param_value(const char *name);
+/* The cdev serving dev, or NULL */
+struct cdev *kshim_cdev_lookup(dev_t dev);
+/* The index'th live device from device_create(), or NULL past the last */
+struct device *kshim_device(int index);
+
+#endif /* KSHIM_H */
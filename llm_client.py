@@ -0,0 +1,231 @@
+import http.client
+import json
+import os
+import queue
+import random
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from urllib.parse import urlsplit
+
+from fence_extractor import FenceExtractor
+from metrics import METRICS
+
+BASE_URL = os.environ.get("GEMINI_BASE_URL", "https://generativelanguage.googleapis.com")
+API_KEY = os.environ.get("GEMINI_API_KEY", "API_KEY")
+MODEL = os.environ.get("GEMINI_MODEL", "gemini-2.0-flash")
+
+CONCURRENCY = 8
+RATE = 10.0             # requests per second
+BURST = 10
+REQUEST_TIMEOUT = 120
+MAX_RETRIES = 5
+BACKOFF_BASE = 0.5
+BACKOFF_CAP = 30.0
+
+# Statuses worth retrying: rate limiting and transient server errors
+RETRY_STATUSES = {429, 500, 502, 503, 504}
+
+NO_CODE = "[Error: No code generated by Gemini API]"
+
+
+class LLMError(Exception):
+    pass
+
+
+class GenerationAborted(LLMError):
+    # A streamed response whose partial code failed the pre-check
+    pass
+
+
+class TokenBucket:
+    # Allows bursts of up to `burst` requests, refilled at `rate` per second
+    def __init__(self, rate: float, burst: int):
+        self.rate = rate
+        self.burst = burst
+        self.tokens = float(burst)
+        self.updated = time.monotonic()
+        self._lock = threading.Lock()
+
+    def acquire(self):
+        while True:
+            with self._lock:
+                now = time.monotonic()
+                self.tokens = min(self.burst, self.tokens + (now - self.updated) * self.rate)
+                self.updated = now
+                if self.tokens >= 1:
+                    self.tokens -= 1
+                    return
+                wait = (1 - self.tokens) / self.rate
+            time.sleep(wait)
+
+
+def backoff_delay(attempt: int, retry_after: float = None) -> float:
+    # Exponential backoff with full jitter, never sooner than Retry-After
+    delay = random.uniform(0, min(BACKOFF_CAP, BACKOFF_BASE * 2 ** attempt))
+    if retry_after is not None:
+        delay = max(delay, retry_after)
+    return delay
+
+
+def response_text(result: dict) -> str:
+    try:
+        return result["candidates"][0]["content"]["parts"][0]["text"]
+    except (KeyError, IndexError, TypeError):
+        return NO_CODE
+
+
+class LLMClient:
+    # Generates code over pooled keep-alive connections. At most `concurrency`
+    # requests are in flight, started at no more than `rate` per second;
+    # transient failures are retried with jittered exponential backoff.
+    # With stream=True responses are streamed and generate() returns just the
+    # first code block, hanging up as soon as it closes (see fence_extractor).
+
+    def __init__(self, base_url: str = BASE_URL, api_key: str = API_KEY, model: str = MODEL,
+                 concurrency: int = CONCURRENCY, rate: float = RATE, burst: int = BURST,
+                 timeout: float = REQUEST_TIMEOUT, max_retries: int = MAX_RETRIES,
+                 stream: bool = False):
+        parts = urlsplit(base_url)
+        self._https = parts.scheme == "https"
+        self._host = parts.hostname
+        self._port = parts.port
+        self._prefix = parts.path.rstrip("/")
+        self.api_key = api_key
+        self.model = model
+        self.timeout = timeout
+        self.max_retries = max_retries
+        self.stream = stream
+        self.bucket = TokenBucket(rate, burst) if rate else None
+        self._idle = queue.LifoQueue()
+        self._pool = ThreadPoolExecutor(max_workers=concurrency, thread_name_prefix="llm")
+        self._stats_lock = threading.Lock()
+        self._stats = {"requests": 0, "retries": 0, "connections": 0, "failures": 0,
+                       "streams_cut": 0}
+
+    def _count(self, key: str):
+        with self._stats_lock:
+            self._stats[key] += 1
+
+    def stats(self) -> dict:
+        with self._stats_lock:
+            return dict(self._stats)
+
+    def _connection(self) -> http.client.HTTPConnection:
+        try:
+            return self._idle.get_nowait()
+        except queue.Empty:
+            pass
+        self._count("connections")
+        if self._https:
+            return http.client.HTTPSConnection(self._host, self._port, timeout=self.timeout)
+        return http.client.HTTPConnection(self._host, self._port, timeout=self.timeout)
+
+    def _post(self, path: str, body: bytes, consume=None):
+        # One request on a pooled connection. Returns (status, headers, data).
+        # consume(response), if given, reads a 200 response itself and its
+        # return value becomes data. A connection that broke, or whose
+        # response was not read to the end, is closed instead of pooled.
+        conn = self._connection()
+        try:
+            conn.request("POST", path, body=body, headers={"Content-Type": "application/json"})
+            response = conn.getresponse()
+            if response.status == 200 and consume is not None:
+                data = consume(response)
+            else:
+                data = response.read()
+        except BaseException:
+            conn.close()
+            raise
+        if response.will_close or not response.isclosed():
+            if not response.isclosed():
+                self._count("streams_cut")
+            conn.close()
+        else:
+            self._idle.put(conn)
+        return response.status, response.headers, data
+
+    def _path(self, method: str) -> str:
+        return f"{self._prefix}/v1beta/models/{self.model}:{method}?key={self.api_key}"
+
+    def _consume_stream(self, response) -> FenceExtractor:
+        # Server-sent events, one "data: <json>" line per chunk of text
+        extractor = FenceExtractor()
+        while True:
+            line = response.readline()
+            if not line:
+                break
+            if not line.startswith(b"data:"):
+                continue
+            event = json.loads(line[5:])
+            try:
+                parts = event["candidates"][0]["content"]["parts"]
+            except (KeyError, IndexError, TypeError):
+                continue
+            if extractor.feed("".join(part.get("text", "") for part in parts)):
+                break
+        extractor.finish()
+        return extractor
+
+    def generate(self, prompt: str) -> str:
+        # Blocking call; runs on the caller's thread
+        body = json.dumps({"contents": [{"parts": [{"text": prompt}]}]}).encode()
+        if self.stream:
+            path = self._path("streamGenerateContent") + "&alt=sse"
+            consume = self._consume_stream
+        else:
+            path = self._path("generateContent")
+            consume = None
+        started = time.monotonic()
+        outcome = "failed"
+        try:
+            for attempt in range(self.max_retries + 1):
+                if self.bucket is not None:
+                    self.bucket.acquire()
+                self._count("requests")
+                retry_after = None
+                try:
+                    status, headers, data = self._post(path, body, consume)
+                except (OSError, http.client.HTTPException) as exc:
+                    error = exc
+                else:
+                    if status == 200 and self.stream:
+                        if data.error is not None:
+                            outcome = "aborted"
+                            raise GenerationAborted(data.error)
+                        outcome = "ok"
+                        return data.code
+                    if status == 200:
+                        outcome = "ok"
+                        return response_text(json.loads(data))
+                    error = LLMError(f"HTTP {status}: {data[:200].decode(errors='replace')}")
+                    if status not in RETRY_STATUSES:
+                        raise error
+                    if headers.get("Retry-After", "").isdigit():
+                        retry_after = float(headers["Retry-After"])
+                if attempt == self.max_retries:
+                    raise error
+                self._count("retries")
+                time.sleep(backoff_delay(attempt, retry_after))
+        finally:
+            if outcome != "ok":
+                self._count("failures")
+            METRICS.record_tool("llm", time.monotonic() - started, None, outcome)
+
+    def submit(self, prompt: str):
+        # Future resolving to the response text
+        return self._pool.submit(self.generate, prompt)
+
+    def close(self):
+        self._pool.shutdown(wait=False, cancel_futures=True)
+        while True:
+            try:
+                self._idle.get_nowait().close()
+            except queue.Empty:
+                break
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
@@ -1,65 +1,167 @@
-from gpt_generate import generate_code
-from compile_check import compile_for_architectures
-from static_analysis import static_check, run_checkpatch, run_sparse
-from style_checker import check_style
-from scoring import score_evaluation
-import re
+from gpt_generate import strip_markdown_fence
+from compile_check import ARCHITECTURES
+from pipeline import evaluate_driver, compile_stage
+from executor import DagExecutor
+from batch import run_batch
+from result_cache import ResultCache, CACHE_DIR
+from kbuild import KbuildCompiler
+from metrics import METRICS
+from llm_client import LLMClient, CONCURRENCY, RATE
+from tiering import TierPolicy, CostModel, COSTS_FILE
+from qemu_loader import QemuLoader
+from tool_pool import StaticToolPool
+from results_store import ResultsStore
+from runtime_harness import measure_reference
+from scoring import PERF_TARGET_MBPS
+import argparse
 import os
+import time
 
 PROMPT_PATH = "basic_char_driver.txt"
 GENERATED_PATH = "test_samples/generated_driver.c"
 CHECKPATCH_PATH = "checkpatch.pl"
 
-def strip_markdown_fence(code: str) -> str:
-    # Remove leading/trailing triple backticks and optional language tag
-    code = re.sub(r'^```[a-zA-Z]*\s*', '', code)
-    code = re.sub(r'```\s*$', '', code)
-    return code.strip()
+def main():
+    parser = argparse.ArgumentParser(description="Generate and evaluate character device drivers")
+    parser.add_argument("--jobs", type=int, default=None,
+                        help="Maximum tool processes to run at once (default: CPU count)")
+    parser.add_argument("--manifest", help="JSONL manifest of prompts/sources to evaluate in batch mode")
+    parser.add_argument("--output", default="results.jsonl", help="Batch mode results file (JSONL)")
+    parser.add_argument("--max-inflight", type=int, default=None,
+                        help="Batch mode: drivers evaluated at once (default: 4 x jobs)")
+    parser.add_argument("--keep-scratch", action="store_true",
+                        help="Batch mode: keep each job's scratch directory")
+    parser.add_argument("--cache-dir", default=CACHE_DIR, help="Tool result cache directory")
+    parser.add_argument("--no-cache", action="store_true", help="Always re-run every tool")
+    parser.add_argument("--compile-backend", choices=["gcc", "kbuild"], default="gcc",
+                        help="gcc: plain gcc -c; kbuild: out-of-tree modules against KDIR_<ARCH> trees")
+    parser.add_argument("--kbuild-batch", type=int, default=64,
+                        help="Maximum drivers per Kbuild invocation")
+    parser.add_argument("--llm-concurrency", type=int, default=CONCURRENCY,
+                        help="Batch mode: LLM requests in flight at once")
+    parser.add_argument("--llm-rate", type=float, default=RATE,
+                        help="Batch mode: LLM requests started per second (0: unlimited)")
+    parser.add_argument("--stream", action="store_true",
+                        help="Stream LLM responses and stop reading once the first code block closes")
+    parser.add_argument("--tiered", action="store_true",
+                        help="Skip expensive stages for drivers that fail cheap gates (skipped stages score 0)")
+    parser.add_argument("--full", action="store_true",
+                        help="Run every stage on every driver, overriding the tiering options (the default)")
+    parser.add_argument("--max-tier", type=int, choices=[0, 1, 2], default=None,
+                        help="Tiered: stop after this tier (0: structure, 1: x86_64 compile, 2: everything)")
+    parser.add_argument("--min-score", type=int, default=None,
+                        help="Skip tier 2 for drivers that can no longer reach this score")
+    parser.add_argument("--top-k", type=int, default=None,
+                        help="Batch mode: skip tier 2 for drivers that can no longer enter the top K")
+    parser.add_argument("--max-seconds-per-point", type=float, default=None,
+                        help="Tiered: skip tier 2 when its estimated seconds per expected point exceed this")
+    parser.add_argument("--qemu", action="store_true",
+                        help="Load each kbuild module with insmod in a QEMU guest (needs --compile-backend kbuild, "
+                             "GUEST_KERNEL and a static BUSYBOX)")
+    parser.add_argument("--qemu-sessions", type=int, default=1,
+                        help="QEMU guests running at once")
+    parser.add_argument("--no-tool-pool", action="store_true",
+                        help="Start a fresh checkpatch/cppcheck process per driver")
+    parser.add_argument("--checkpatch-workers", type=int, default=2,
+                        help="Long-lived checkpatch.pl workers (script parsed once per worker)")
+    parser.add_argument("--tool-batch", type=int, default=32,
+                        help="Maximum drivers per batched cppcheck invocation")
+    parser.add_argument("--store", help="Also save every result to this SQLite results store")
+    parser.add_argument("--model", default=None,
+                        help="Model name results are stored under (default: the LLM model; "
+                             "batch manifests may set \"model\" per job)")
+    parser.add_argument("--metrics-json", help="Write per-stage/per-tool timing report as JSON")
+    parser.add_argument("--metrics-prom", help="Write the same metrics in Prometheus text format")
+    args = parser.parse_args()
+    try:
+        run(args)
+    finally:
+        if args.metrics_json:
+            METRICS.write_json(args.metrics_json)
+        if args.metrics_prom:
+            METRICS.write_prometheus(args.metrics_prom)
 
-with open(PROMPT_PATH) as f:
-    prompt = f.read()
+def run(args):
+    if args.qemu and args.compile_backend != "kbuild":
+        raise SystemExit("--qemu needs --compile-backend kbuild to build real modules")
+    cache = None if args.no_cache else ResultCache(args.cache_dir)
+    kbuild = None
+    if args.compile_backend == "kbuild":
+        kbuild = KbuildCompiler(jobs=args.jobs, max_batch=args.kbuild_batch, cache=cache,
+                                keep_modules=args.qemu)
+    qemu = QemuLoader(sessions=args.qemu_sessions, kdir=kbuild.trees.get("x86_64")) if args.qemu else None
+    tools = None
+    if not args.no_tool_pool:
+        tools = StaticToolPool(CHECKPATCH_PATH, args.checkpatch_workers, args.tool_batch)
+    store = ResultsStore(args.store, label=args.manifest) if args.store else None
 
-code = generate_code(prompt)
-code = strip_markdown_fence(code)
+    policy = None
+    # Any tiering option turns tiering on; skipped stages score 0, so it
+    # stays off unless asked for
+    tiered = args.tiered or args.max_tier is not None or args.min_score is not None or args.top_k is not None \
+        or args.max_seconds_per_point is not None
+    if tiered and not args.full:
+        # Stage cost estimates carry over between runs next to the tool cache
+        costs = CostModel(os.path.join(args.cache_dir, COSTS_FILE))
+        policy = TierPolicy(2 if args.max_tier is None else args.max_tier, args.min_score, args.top_k, costs,
+                            args.max_seconds_per_point)
 
-os.makedirs(os.path.dirname(GENERATED_PATH), exist_ok=True)
-with open(GENERATED_PATH, "w") as f:
-    f.write(code)
+    llm = LLMClient(concurrency=args.llm_concurrency, rate=args.llm_rate, stream=args.stream)
+    try:
+        evaluate(args, cache, kbuild, llm, policy, qemu, tools, store)
+    finally:
+        llm.close()
+        if store is not None:
+            store.close()
+        if tools is not None:
+            tools.close()
+        if qemu is not None:
+            qemu.close()
+        if policy is not None:
+            policy.costs.save()
 
-compile_results = compile_for_architectures(GENERATED_PATH)
-print("Compilation results by architecture:")
-for arch, result in compile_results.items():
-    print(f"{arch}: {result}")
+def evaluate(args, cache, kbuild, llm, policy, qemu, tools, store):
+    model = args.model or llm.model
+    # The performance baseline, taken before any driver loads the machine
+    if measure_reference() is None:
+        print(f"Reference driver could not be measured; performance is scored against {PERF_TARGET_MBPS} MB/s")
+    if args.manifest:
+        count = run_batch(args.manifest, args.output, jobs=args.jobs,
+                          max_inflight=args.max_inflight, checkpatch_path=CHECKPATCH_PATH,
+                          keep_scratch=args.keep_scratch, cache=cache, kbuild=kbuild, llm=llm,
+                          policy=policy, qemu=qemu, tools=tools, store=store, model=model)
+        print(f"Evaluated {count} drivers, results in {args.output}")
+        if store is not None:
+            print(f"Results stored in {args.store}")
+        if cache is not None:
+            print(f"Tool cache: {cache.stats()}")
+        return
 
-# Use x86_64 result for further analysis (as an example)
-compile_data = compile_results.get("x86_64", {})
+    with open(PROMPT_PATH) as f:
+        prompt = f.read()
 
-static_data = static_check(GENERATED_PATH)
-style_data = check_style(GENERATED_PATH)
-checkpatch_data = run_checkpatch(GENERATED_PATH, CHECKPATCH_PATH)
-sparse_data = run_sparse(GENERATED_PATH)
+    code = llm.generate(prompt)
+    code = strip_markdown_fence(code)
 
-# Basic runtime/functionality test (static simulation)
-def runtime_functionality_test(source_path):
-    with open(source_path, 'r') as f:
-        code = f.read()
-    required_functions = [
-        'init', 'exit', 'read', 'write'
-    ]
-    found = {fn: False for fn in required_functions}
-    for fn in required_functions:
-        # Look for function definitions like xxx_init, xxx_exit, etc.
-        pattern = re.compile(r'\b\w*' + fn + r'\w*\s*\(')
-        if pattern.search(code):
-            found[fn] = True
-    # Simulate module load/unload (cannot actually load in user space)
-    can_load = compile_data.get("success", False) and found['init'] and found['exit']
-    return {
-        "required_functions": found,
-        "can_load_module": can_load
-    }
+    os.makedirs(os.path.dirname(GENERATED_PATH), exist_ok=True)
+    with open(GENERATED_PATH, "w") as f:
+        f.write(code)
 
-runtime_data = runtime_functionality_test(GENERATED_PATH)
+    started = time.monotonic()
+    results = evaluate_driver(GENERATED_PATH, CHECKPATCH_PATH, DagExecutor(args.jobs),
+                              cache=cache, kbuild=kbuild, policy=policy, qemu=qemu, tools=tools)
+    if store is not None:
+        evaluation_id = store.add(GENERATED_PATH, results, model, GENERATED_PATH,
+                                  time.monotonic() - started)
+        print(f"Stored as evaluation {evaluation_id} in {args.store}")
 
-final_score = score_evaluation(compile_data, style_data, static_data, checkpatch_data, sparse_data, runtime_data)
-print(final_score)
+    print("Compilation results by architecture:")
+    for arch in ARCHITECTURES:
+        print(f"{arch}: {results[compile_stage(arch)]}")
+
+    print(results["score"])
+    if cache is not None:
+        print(f"Tool cache: {cache.stats()}")
+
+if __name__ == "__main__":
+    main()
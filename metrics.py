@@ -0,0 +1,182 @@
+import json
+import threading
+
+# Latency histogram bucket upper bounds in seconds
+BUCKETS = (0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300)
+
+PREFIX = "driver_eval"
+
+
+class Histogram:
+    def __init__(self):
+        self.counts = [0] * (len(BUCKETS) + 1)
+        self.count = 0
+        self.sum = 0.0
+        self.max = 0.0
+
+    def observe(self, value: float):
+        for i, bound in enumerate(BUCKETS):
+            if value <= bound:
+                self.counts[i] += 1
+                break
+        else:
+            self.counts[-1] += 1
+        self.count += 1
+        self.sum += value
+        self.max = max(self.max, value)
+
+    def quantile(self, q: float) -> float:
+        # Linear interpolation inside the bucket holding the q-th observation
+        if self.count == 0:
+            return 0.0
+        rank = q * self.count
+        seen = 0
+        lower = 0.0
+        for i, n in enumerate(self.counts):
+            upper = BUCKETS[i] if i < len(BUCKETS) else self.max
+            if n and seen + n >= rank:
+                return min(lower + (upper - lower) * (rank - seen) / n, self.max)
+            seen += n
+            lower = upper
+        return self.max
+
+    def summary(self) -> dict:
+        return {
+            "count": self.count,
+            "sum": self.sum,
+            "mean": self.sum / self.count if self.count else 0.0,
+            "p50": self.quantile(0.5),
+            "p90": self.quantile(0.9),
+            "p99": self.quantile(0.99),
+            "max": self.max,
+        }
+
+
+class _ToolStats:
+    def __init__(self):
+        self.wall = Histogram()
+        self.user_cpu = 0.0
+        self.sys_cpu = 0.0
+        self.peak_rss_kb = 0
+        self.outcomes = {}
+
+
+class Metrics:
+    # Thread-safe collector for tool invocations, pipeline stages, executor
+    # queue waits and cache lookups
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self._lock:
+            self._tools = {}
+            self._stages = {}
+            self._queue_wait = {}
+            self._cache_lookup = Histogram()
+            self._cache = {"hit": 0, "miss": 0}
+
+    def record_tool(self, tool: str, wall: float, rusage=None, outcome: str = "ok"):
+        with self._lock:
+            stats = self._tools.setdefault(tool, _ToolStats())
+            stats.wall.observe(wall)
+            if rusage is not None:
+                stats.user_cpu += rusage.ru_utime
+                stats.sys_cpu += rusage.ru_stime
+                # ru_maxrss is in kilobytes on Linux
+                stats.peak_rss_kb = max(stats.peak_rss_kb, rusage.ru_maxrss)
+            stats.outcomes[outcome] = stats.outcomes.get(outcome, 0) + 1
+
+    def record_stage(self, stage: str, wall: float, queue_wait: float = None):
+        with self._lock:
+            self._stages.setdefault(stage, Histogram()).observe(wall)
+            if queue_wait is not None:
+                self._queue_wait.setdefault(stage, Histogram()).observe(queue_wait)
+
+    def record_cache(self, hit: bool, lookup: float):
+        with self._lock:
+            self._cache["hit" if hit else "miss"] += 1
+            self._cache_lookup.observe(lookup)
+
+    def report(self) -> dict:
+        with self._lock:
+            return {
+                "tools": {
+                    tool: {
+                        "wall_seconds": stats.wall.summary(),
+                        "user_cpu_seconds": stats.user_cpu,
+                        "sys_cpu_seconds": stats.sys_cpu,
+                        "peak_rss_kb": stats.peak_rss_kb,
+                        "outcomes": dict(stats.outcomes),
+                    }
+                    for tool, stats in sorted(self._tools.items())
+                },
+                "stages": {stage: h.summary() for stage, h in sorted(self._stages.items())},
+                "queue_wait_seconds": {stage: h.summary() for stage, h in sorted(self._queue_wait.items())},
+                "cache": {
+                    "hits": self._cache["hit"],
+                    "misses": self._cache["miss"],
+                    "lookup_seconds": self._cache_lookup.summary(),
+                },
+            }
+
+    def write_json(self, path: str):
+        with open(path, "w") as f:
+            json.dump(self.report(), f, indent=2)
+
+    def prometheus(self) -> str:
+        lines = []
+
+        def histogram(name, help_text, label, series):
+            lines.append(f"# HELP {PREFIX}_{name} {help_text}")
+            lines.append(f"# TYPE {PREFIX}_{name} histogram")
+            for key, h in series:
+                labels = f'{label}="{key}"' if label else ""
+                sep = "," if labels else ""
+                cumulative = 0
+                for bound, n in zip(BUCKETS, h.counts):
+                    cumulative += n
+                    lines.append(f'{PREFIX}_{name}_bucket{{{labels}{sep}le="{bound}"}} {cumulative}')
+                lines.append(f'{PREFIX}_{name}_bucket{{{labels}{sep}le="+Inf"}} {h.count}')
+                suffix = f"{{{labels}}}" if labels else ""
+                lines.append(f"{PREFIX}_{name}_sum{suffix} {h.sum}")
+                lines.append(f"{PREFIX}_{name}_count{suffix} {h.count}")
+
+        with self._lock:
+            tools = sorted(self._tools.items())
+            histogram("tool_wall_seconds", "Wall time of external tool invocations.", "tool",
+                      [(tool, stats.wall) for tool, stats in tools])
+            lines.append(f"# HELP {PREFIX}_tool_cpu_seconds_total CPU time used by external tools.")
+            lines.append(f"# TYPE {PREFIX}_tool_cpu_seconds_total counter")
+            for tool, stats in tools:
+                lines.append(f'{PREFIX}_tool_cpu_seconds_total{{tool="{tool}",mode="user"}} {stats.user_cpu}')
+                lines.append(f'{PREFIX}_tool_cpu_seconds_total{{tool="{tool}",mode="system"}} {stats.sys_cpu}')
+            lines.append(f"# HELP {PREFIX}_tool_peak_rss_bytes Largest peak RSS seen for each tool.")
+            lines.append(f"# TYPE {PREFIX}_tool_peak_rss_bytes gauge")
+            for tool, stats in tools:
+                lines.append(f'{PREFIX}_tool_peak_rss_bytes{{tool="{tool}"}} {stats.peak_rss_kb * 1024}')
+            lines.append(f"# HELP {PREFIX}_tool_invocations_total Tool invocations by outcome.")
+            lines.append(f"# TYPE {PREFIX}_tool_invocations_total counter")
+            for tool, stats in tools:
+                for outcome, n in sorted(stats.outcomes.items()):
+                    lines.append(f'{PREFIX}_tool_invocations_total{{tool="{tool}",outcome="{outcome}"}} {n}')
+            histogram("stage_wall_seconds", "Wall time of pipeline stages.", "stage",
+                      sorted(self._stages.items()))
+            histogram("queue_wait_seconds", "Time stages waited for a worker.", "stage",
+                      sorted(self._queue_wait.items()))
+            histogram("cache_lookup_seconds", "Result cache lookup time.", None,
+                      [(None, self._cache_lookup)])
+            lines.append(f"# HELP {PREFIX}_cache_requests_total Result cache lookups by result.")
+            lines.append(f"# TYPE {PREFIX}_cache_requests_total counter")
+            for result, n in sorted(self._cache.items()):
+                lines.append(f'{PREFIX}_cache_requests_total{{result="{result}"}} {n}')
+        return "\n".join(lines) + "\n"
+
+    def write_prometheus(self, path: str):
+        with open(path, "w") as f:
+            f.write(self.prometheus())
+
+
+# Process-wide collector shared by every stage and tool invocation
+METRICS = Metrics()
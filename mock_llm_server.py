@@ -0,0 +1,172 @@
+import argparse
+import json
+import os
+import random
+import re
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Stand-in for the Gemini generateContent and streamGenerateContent (SSE)
+# endpoints, for offline tests and throughput benchmarks
+
+SAMPLE_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "test_samples", "generated_driver.c")
+
+_PATH_RE = re.compile(r'^(?:/[^?]*)?/v1beta/models/[^/:?]+:(?P<method>\w+)')
+
+
+class MockLLMServer:
+    # responder(prompt) -> response text (default: the sample driver file).
+    # Each request sleeps latency +/- jitter seconds; fail_rate of them are
+    # answered with 503, or 429 with Retry-After, to exercise client retries.
+    # Streamed responses send chunk_size characters per event, chunk_delay
+    # seconds apart, after the initial latency.
+
+    def __init__(self, host: str = "127.0.0.1", port: int = 0, responder=None,
+                 latency: float = 0.0, jitter: float = 0.0, fail_rate: float = 0.0, seed: int = None,
+                 chunk_size: int = 32, chunk_delay: float = 0.0):
+        self.responder = responder or _sample_responder()
+        self.latency = latency
+        self.jitter = jitter
+        self.fail_rate = fail_rate
+        self.chunk_size = chunk_size
+        self.chunk_delay = chunk_delay
+        self.requests = 0
+        self.chunks_sent = 0
+        self.streams_cut = 0    # streams the client hung up on before the end
+        self._random = random.Random(seed)
+        self._lock = threading.Lock()
+        self._server = ThreadingHTTPServer((host, port), self._handler())
+        self._server.daemon_threads = True
+        self._thread = None
+
+    @property
+    def base_url(self) -> str:
+        host, port = self._server.server_address[:2]
+        return f"http://{host}:{port}"
+
+    def _draw(self):
+        with self._lock:
+            self.requests += 1
+            delay = max(0.0, self.latency + self._random.uniform(-self.jitter, self.jitter))
+            if self._random.random() >= self.fail_rate:
+                return delay, None
+            return delay, self._random.choice((429, 503))
+
+    def _sent(self):
+        with self._lock:
+            self.chunks_sent += 1
+
+    def _cut(self):
+        with self._lock:
+            self.streams_cut += 1
+
+    def _handler(self):
+        server = self
+
+        class Handler(BaseHTTPRequestHandler):
+            # HTTP/1.1 so clients can keep connections alive
+            protocol_version = "HTTP/1.1"
+
+            def log_message(self, *args):
+                pass
+
+            def _send(self, status: int, payload: dict, headers: dict = None):
+                body = json.dumps(payload).encode()
+                self.send_response(status)
+                self.send_header("Content-Type", "application/json")
+                self.send_header("Content-Length", str(len(body)))
+                for name, value in (headers or {}).items():
+                    self.send_header(name, value)
+                self.end_headers()
+                self.wfile.write(body)
+
+            def _stream(self, text: str):
+                # text/event-stream over chunked transfer encoding
+                self.send_response(200)
+                self.send_header("Content-Type", "text/event-stream")
+                self.send_header("Transfer-Encoding", "chunked")
+                self.end_headers()
+                try:
+                    for i in range(0, len(text), server.chunk_size):
+                        if i:
+                            time.sleep(server.chunk_delay)
+                        event = {"candidates": [{"content": {
+                            "parts": [{"text": text[i:i + server.chunk_size]}], "role": "model"}}]}
+                        data = f"data: {json.dumps(event)}\r\n\r\n".encode()
+                        self.wfile.write(f"{len(data):x}\r\n".encode() + data + b"\r\n")
+                        self.wfile.flush()
+                        server._sent()
+                    self.wfile.write(b"0\r\n\r\n")
+                except (BrokenPipeError, ConnectionResetError):
+                    server._cut()
+                    self.close_connection = True
+
+            def do_POST(self):
+                length = int(self.headers.get("Content-Length", 0))
+                request = json.loads(self.rfile.read(length) or b"{}")
+                match = _PATH_RE.match(self.path)
+                if not match or match.group("method") not in ("generateContent", "streamGenerateContent"):
+                    self._send(404, {"error": {"code": 404, "message": "not found"}})
+                    return
+                delay, failure = server._draw()
+                time.sleep(delay)
+                if failure == 429:
+                    self._send(429, {"error": {"code": 429, "message": "rate limited"}}, {"Retry-After": "0"})
+                    return
+                if failure == 503:
+                    self._send(503, {"error": {"code": 503, "message": "unavailable"}})
+                    return
+                try:
+                    prompt = request["contents"][0]["parts"][0]["text"]
+                except (KeyError, IndexError, TypeError):
+                    self._send(400, {"error": {"code": 400, "message": "bad request"}})
+                    return
+                text = server.responder(prompt)
+                if match.group("method") == "streamGenerateContent":
+                    self._stream(text)
+                    return
+                self._send(200, {"candidates": [{"content": {"parts": [{"text": text}], "role": "model"}}]})
+
+        return Handler
+
+    def start(self):
+        self._thread = threading.Thread(target=self._server.serve_forever, daemon=True)
+        self._thread.start()
+        return self
+
+    def stop(self):
+        self._server.shutdown()
+        self._server.server_close()
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, *exc):
+        self.stop()
+
+
+def _sample_responder():
+    with open(SAMPLE_PATH) as f:
+        text = f.read()
+    return lambda prompt: text
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Mock Gemini generateContent server")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--latency", type=float, default=0.5, help="Seconds per response")
+    parser.add_argument("--jitter", type=float, default=0.0)
+    parser.add_argument("--chunk-size", type=int, default=32, help="Characters per streamed event")
+    parser.add_argument("--chunk-delay", type=float, default=0.0, help="Seconds between streamed events")
+    parser.add_argument("--fail-rate", type=float, default=0.0, help="Fraction of requests answered 429/503")
+    args = parser.parse_args()
+    server = MockLLMServer(args.host, args.port, latency=args.latency, jitter=args.jitter,
+                           fail_rate=args.fail_rate, chunk_size=args.chunk_size, chunk_delay=args.chunk_delay)
+    print(f"Serving on {server.base_url} (GEMINI_BASE_URL={server.base_url})")
+    server._server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,586 @@
+// Single-pass C tokenizer and structure analyzer behind source_analyzer.py.
+//
+// This is a direct port of the pure-Python implementation in
+// source_analyzer.py and must produce the same result for every input;
+// change both together. The result is returned as a JSON document that
+// the Python side parses into the same dict the fallback builds.
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+
+namespace {
+
+constexpr size_t kLongLine = 80;
+
+enum class Kind { Comment, Directive, String, Char, Ident, Number, Punct };
+
+struct Token {
+    Kind kind;
+    std::string_view text;
+    int line;
+};
+
+bool is_ident_start(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+bool is_word(unsigned char c) {
+    return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+bool is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+const char *const kPunct3[] = {"<<=", ">>=", "..."};
+const char *const kPunct2[] = {"->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+                               "-=", "+=", "*=", "/=", "%=", "&=", "|=", "^="};
+
+const char *const kKeywords[] = {"if", "for", "while", "switch", "return", "sizeof", "do", "else",
+                                 "case", "typeof", "__typeof__", "_Alignof", "alignof", "defined"};
+
+const char *const kAttributeWords[] = {"__acquires", "__releases", "__must_hold", "__attribute__",
+                                       "const"};
+
+template <size_t N>
+bool in_list(std::string_view text, const char *const (&list)[N]) {
+    for (const char *word : list) {
+        if (text == word)
+            return true;
+    }
+    return false;
+}
+
+class Lexer {
+public:
+    explicit Lexer(std::string_view code) : code_(code) {}
+
+    // Returns false at end of input. Whitespace and newlines are skipped.
+    bool next(Token &tok, bool &unterminated) {
+        unterminated = false;
+        const size_t n = code_.size();
+        while (pos_ < n) {
+            const size_t start = pos_;
+            const unsigned char c = code_[pos_];
+
+            if (c == '/' && pos_ + 1 < n && code_[pos_ + 1] == '*') {
+                size_t end = code_.find("*/", pos_ + 2);
+                if (end == std::string_view::npos) {
+                    pos_ = n;
+                    unterminated = true;
+                } else {
+                    pos_ = end + 2;
+                }
+                return emit(tok, Kind::Comment, start);
+            }
+            if (c == '/' && pos_ + 1 < n && code_[pos_ + 1] == '/') {
+                while (pos_ < n && code_[pos_] != '\n')
+                    pos_++;
+                return emit(tok, Kind::Comment, start);
+            }
+            if (start == 0 || code_[start - 1] == '\n') {
+                size_t p = start;
+                while (p < n && (code_[p] == ' ' || code_[p] == '\t'))
+                    p++;
+                if (p < n && code_[p] == '#') {
+                    pos_ = p + 1;
+                    scan_directive();
+                    return emit(tok, Kind::Directive, start);
+                }
+            }
+            if (c == '\n') {
+                line_++;
+                pos_++;
+                continue;
+            }
+            if (is_space(c)) {
+                while (pos_ < n && is_space(code_[pos_]))
+                    pos_++;
+                continue;
+            }
+            if (c == '\\' && pos_ + 1 < n && code_[pos_ + 1] == '\n') {
+                line_++;
+                pos_ += 2;
+                continue;
+            }
+            if (c == '"' || c == '\'') {
+                pos_++;
+                bool closed = scan_literal(c);
+                unterminated = !closed;
+                return emit(tok, c == '"' ? Kind::String : Kind::Char, start);
+            }
+            if (is_ident_start(c)) {
+                while (pos_ < n && is_word(code_[pos_]))
+                    pos_++;
+                return emit(tok, Kind::Ident, start);
+            }
+            if (is_digit(c) || (c == '.' && pos_ + 1 < n && is_digit(code_[pos_ + 1]))) {
+                pos_ += c == '.' ? 2 : 1;
+                while (pos_ < n) {
+                    const unsigned char d = code_[pos_];
+                    if ((d == 'e' || d == 'E' || d == 'p' || d == 'P') && pos_ + 1 < n &&
+                        (code_[pos_ + 1] == '+' || code_[pos_ + 1] == '-')) {
+                        pos_ += 2;
+                    } else if (is_word(d) || d == '.') {
+                        pos_++;
+                    } else {
+                        break;
+                    }
+                }
+                return emit(tok, Kind::Number, start);
+            }
+            pos_ += punct_length();
+            return emit(tok, Kind::Punct, start);
+        }
+        return false;
+    }
+
+private:
+    bool emit(Token &tok, Kind kind, size_t start) {
+        tok.kind = kind;
+        tok.text = code_.substr(start, pos_ - start);
+        tok.line = line_;
+        for (char ch : tok.text) {
+            if (ch == '\n')
+                line_++;
+        }
+        return true;
+    }
+
+    void scan_directive() {
+        const size_t n = code_.size();
+        while (pos_ < n) {
+            if (code_[pos_] == '\\' && pos_ + 1 < n && code_[pos_ + 1] == '\n') {
+                pos_ += 2;
+            } else if (code_[pos_] == '/' && pos_ + 1 < n && code_[pos_ + 1] == '*' &&
+                       code_.find("*/", pos_ + 2) != std::string_view::npos) {
+                pos_ = code_.find("*/", pos_ + 2) + 2;
+            } else if (code_[pos_] == '\n') {
+                return;
+            } else {
+                pos_++;
+            }
+        }
+    }
+
+    bool scan_literal(unsigned char quote) {
+        const size_t n = code_.size();
+        while (pos_ < n) {
+            const unsigned char c = code_[pos_];
+            if (c == '\\' && pos_ + 1 < n) {
+                pos_ += 2;
+            } else if (c == quote) {
+                pos_++;
+                return true;
+            } else if (c == '\n' || c == '\\') {
+                return false;
+            } else {
+                pos_++;
+            }
+        }
+        return false;
+    }
+
+    size_t punct_length() const {
+        std::string_view rest = code_.substr(pos_);
+        for (const char *op : kPunct3) {
+            if (rest.substr(0, 3) == op)
+                return 3;
+        }
+        for (const char *op : kPunct2) {
+            if (rest.substr(0, 2) == op)
+                return 2;
+        }
+        // One code point, so multi-byte UTF-8 stays a single token
+        size_t len = 1;
+        while (len < rest.size() && (static_cast<unsigned char>(rest[len]) & 0xC0) == 0x80)
+            len++;
+        return (static_cast<unsigned char>(rest[0]) & 0x80) ? len : 1;
+    }
+
+    std::string_view code_;
+    size_t pos_ = 0;
+    int line_ = 1;
+};
+
+void append_json_string(std::string &out, std::string_view text) {
+    out += '"';
+    for (unsigned char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof buf, "\\u%04x", c);
+                out += buf;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+    out += '"';
+}
+
+struct Function {
+    std::string_view name;
+    int start_line = 0;
+    int body_line = 0;
+    int end_line = 0;
+    int max_nesting = 0;
+    bool doc_comment = false;
+    std::vector<std::string_view> calls;
+};
+
+struct Member {
+    std::string_view name;
+    std::string value;
+};
+
+struct Fops {
+    std::string_view name;
+    std::vector<Member> members;
+};
+
+std::string_view function_name(const std::vector<Token> &statement) {
+    if (statement.empty() || statement.back().text != ")")
+        return {};
+    for (const Token &tok : statement) {
+        if (tok.text == "=")
+            return {};
+    }
+    for (size_t i = 0; i < statement.size(); i++) {
+        if (statement[i].text == "(") {
+            if (i > 0 && statement[i - 1].kind == Kind::Ident &&
+                !in_list(statement[i - 1].text, kAttributeWords))
+                return statement[i - 1].text;
+            return {};
+        }
+    }
+    return {};
+}
+
+std::string_view fops_initializer(const std::vector<Token> &statement) {
+    if (statement.empty() || statement.back().text != "=")
+        return {};
+    size_t index = statement.size();
+    for (size_t i = 0; i < statement.size(); i++) {
+        if (statement[i].text == "file_operations") {
+            index = i;
+            break;
+        }
+    }
+    if (index == statement.size() || index == 0 || statement[index - 1].text != "struct")
+        return {};
+    std::string_view name;
+    for (size_t i = index + 1; i + 1 < statement.size(); i++) {
+        if (statement[i].kind == Kind::Ident)
+            name = statement[i].text;
+    }
+    return name;
+}
+
+size_t count_braces(const std::vector<char> &stack) {
+    size_t n = 0;
+    for (char c : stack) {
+        if (c == '{')
+            n++;
+    }
+    return n;
+}
+
+char closer(char open) {
+    return open == '{' ? '}' : open == '(' ? ')' : ']';
+}
+
+const char *kind_name(Kind kind) {
+    switch (kind) {
+    case Kind::Comment: return "comment";
+    case Kind::Directive: return "directive";
+    case Kind::String: return "string";
+    case Kind::Char: return "char";
+    case Kind::Ident: return "ident";
+    case Kind::Number: return "number";
+    case Kind::Punct: return "punct";
+    }
+    return "";
+}
+
+std::string analyze(std::string_view code, bool with_tokens) {
+    int lines = 0;
+    int long_lines = 0;
+    {
+        size_t width = 0;
+        for (unsigned char c : code) {
+            if (c == '\n') {
+                lines++;
+                if (width > kLongLine)
+                    long_lines++;
+                width = 0;
+            } else if ((c & 0xC0) != 0x80) {
+                width++;
+            }
+        }
+        if (width > kLongLine)
+            long_lines++;
+        if (!code.empty() && code.back() != '\n')
+            lines++;
+    }
+
+    std::vector<Function> functions;
+    std::deque<Fops> fops;  // stable addresses for fops_cur
+    std::string_view module_init, module_exit;
+    int comment_count = 0;
+    bool have_comment = false;
+    int last_comment_line = 0;
+    int last_token_line = 0;
+    std::vector<Token> statement;
+    bool statement_doc = false;
+    std::vector<char> stack;
+    bool in_function = false;
+    Function current;
+    Fops *fops_cur = nullptr;
+    bool member_open = false;     // saw "." and waiting for the member name
+    std::string_view member;      // member name once known
+    std::vector<std::string_view> value;
+    bool balanced = true;
+    bool have_prev = false;
+    Token prev{};
+    std::vector<Token> tokens;
+
+    auto record_registration = [&]() {
+        if (statement.size() >= 4 &&
+            (statement[0].text == "module_init" || statement[0].text == "module_exit") &&
+            statement[1].text == "(" && statement[2].kind == Kind::Ident) {
+            (statement[0].text == "module_init" ? module_init : module_exit) = statement[2].text;
+        }
+    };
+
+    Lexer lexer(code);
+    Token tok;
+    bool unterminated;
+    while (lexer.next(tok, unterminated)) {
+        const std::string_view text = tok.text;
+        int newlines = 0;
+        for (char ch : text) {
+            if (ch == '\n')
+                newlines++;
+        }
+        if (tok.kind == Kind::Comment) {
+            comment_count++;
+            if (unterminated)
+                balanced = false;
+            have_comment = true;
+            last_comment_line = tok.line + newlines;
+            continue;
+        }
+        if (tok.kind == Kind::Directive) {
+            last_token_line = tok.line + newlines;
+            continue;
+        }
+        if (with_tokens)
+            tokens.push_back(tok);
+        if (unterminated)
+            balanced = false;
+
+        const size_t depth = stack.size();
+        if (depth == 0 && statement.empty()) {
+            statement_doc = have_comment && last_comment_line >= tok.line - 1 &&
+                            last_comment_line > last_token_line;
+        }
+        last_token_line = tok.line;
+
+        if (in_function && text == "(" && have_prev && prev.kind == Kind::Ident &&
+            !in_list(prev.text, kKeywords))
+            current.calls.push_back(prev.text);
+
+        if (fops_cur != nullptr && depth == 1) {
+            if (text == "." && !member_open && member.empty() && have_prev &&
+                (prev.text == "{" || prev.text == ",")) {
+                member_open = true;
+            } else if (member_open && tok.kind == Kind::Ident) {
+                member_open = false;
+                member = text;
+            } else if (!member.empty() && text == "=" && value.empty()) {
+                // the "=" of ".member = value"
+            } else if (text == "," || text == "}") {
+                if (!member.empty()) {
+                    std::string joined;
+                    for (size_t i = 0; i < value.size(); i++) {
+                        if (i)
+                            joined += ' ';
+                        joined += value[i];
+                    }
+                    fops_cur->members.push_back({member, joined});
+                }
+                member_open = false;
+                member = {};
+                value.clear();
+            } else if (!member.empty()) {
+                value.push_back(text);
+            }
+        } else if (fops_cur != nullptr && !member.empty() && depth > 1) {
+            value.push_back(text);
+        }
+
+        const bool at_file_scope = count_braces(stack) == 0;
+        const bool is_open = text == "{" || text == "(" || text == "[";
+        const bool is_close = text == "}" || text == ")" || text == "]";
+        if (is_open) {
+            if (text == "{" && depth == 0) {
+                std::string_view name = function_name(statement);
+                if (!name.empty()) {
+                    in_function = true;
+                    current = Function();
+                    current.name = name;
+                    current.start_line = statement[0].line;
+                    current.body_line = tok.line;
+                    current.doc_comment = statement_doc;
+                } else {
+                    std::string_view fname = fops_initializer(statement);
+                    fops_cur = nullptr;
+                    if (!fname.empty()) {
+                        fops.push_back({fname, {}});
+                        fops_cur = &fops.back();
+                    }
+                }
+            }
+            stack.push_back(text[0]);
+            if (in_function && text == "{") {
+                int nesting = static_cast<int>(count_braces(stack));
+                if (nesting > current.max_nesting)
+                    current.max_nesting = nesting;
+            }
+        } else if (is_close) {
+            if (stack.empty() || closer(stack.back()) != text[0]) {
+                balanced = false;
+                stack.clear();
+            } else {
+                stack.pop_back();
+            }
+            if (text == "}" && stack.empty()) {
+                if (in_function) {
+                    current.end_line = tok.line;
+                    functions.push_back(current);
+                    in_function = false;
+                }
+                fops_cur = nullptr;
+                member_open = false;
+                member = {};
+                statement.clear();
+                prev = tok;
+                have_prev = true;
+                continue;
+            }
+        }
+        if (at_file_scope && text != "{") {
+            if (text == ";" && depth == 0) {
+                record_registration();
+                statement.clear();
+            } else {
+                statement.push_back(tok);
+            }
+        }
+        prev = tok;
+        have_prev = true;
+    }
+    if (!stack.empty())
+        balanced = false;
+
+    std::string out;
+    out.reserve(1024);
+    out += "{\"lines\":" + std::to_string(lines);
+    out += ",\"long_lines\":" + std::to_string(long_lines);
+    out += std::string(",\"has_comments\":") + (comment_count > 0 ? "true" : "false");
+    out += ",\"comment_count\":" + std::to_string(comment_count);
+    out += ",\"functions\":[";
+    for (size_t i = 0; i < functions.size(); i++) {
+        const Function &fn = functions[i];
+        if (i)
+            out += ',';
+        out += "{\"name\":";
+        append_json_string(out, fn.name);
+        out += ",\"start_line\":" + std::to_string(fn.start_line);
+        out += ",\"max_nesting\":" + std::to_string(fn.max_nesting);
+        out += std::string(",\"doc_comment\":") + (fn.doc_comment ? "true" : "false");
+        out += ",\"calls\":[";
+        for (size_t j = 0; j < fn.calls.size(); j++) {
+            if (j)
+                out += ',';
+            append_json_string(out, fn.calls[j]);
+        }
+        out += "],\"end_line\":" + std::to_string(fn.end_line);
+        out += ",\"length\":" + std::to_string(fn.end_line - fn.body_line + 1);
+        out += '}';
+    }
+    out += "],\"file_operations\":{";
+    for (size_t i = 0; i < fops.size(); i++) {
+        if (i)
+            out += ',';
+        append_json_string(out, fops[i].name);
+        out += ":{";
+        for (size_t j = 0; j < fops[i].members.size(); j++) {
+            if (j)
+                out += ',';
+            append_json_string(out, fops[i].members[j].name);
+            out += ':';
+            append_json_string(out, fops[i].members[j].value);
+        }
+        out += '}';
+    }
+    out += "},\"module_init\":";
+    if (module_init.empty())
+        out += "null";
+    else
+        append_json_string(out, module_init);
+    out += ",\"module_exit\":";
+    if (module_exit.empty())
+        out += "null";
+    else
+        append_json_string(out, module_exit);
+    out += std::string(",\"balanced\":") + (balanced ? "true" : "false");
+    if (with_tokens) {
+        out += ",\"tokens\":[";
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (i)
+                out += ',';
+            out += "[\"";
+            out += kind_name(tokens[i].kind);
+            out += "\",";
+            append_json_string(out, tokens[i].text);
+            out += ',' + std::to_string(tokens[i].line) + ']';
+        }
+        out += ']';
+    }
+    out += '}';
+    return out;
+}
+
+}  // namespace
+
+extern "C" {
+
+// Analyzes code[0..len) and writes the JSON result into out, with the
+// token stream (less comments and directives) when tokens is nonzero.
+// Returns the full result length; when it exceeds cap nothing is written
+// and the caller retries with a larger buffer.
+size_t source_analyzer_run(const char *code, size_t len, int tokens, char *out, size_t cap) {
+    std::string result = analyze(std::string_view(code, len), tokens != 0);
+    if (result.size() <= cap)
+        std::memcpy(out, result.data(), result.size());
+    return result.size();
+}
+
+}
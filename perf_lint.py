@@ -0,0 +1,281 @@
+from scoring import STAGE_POINTS
+from source_analyzer import analyze_file
+
+# fops members called once per open; everything else a driver registers
+# (read, write, ioctl, poll, mmap, ...) is on the data path
+OPEN_PATH = {"open", "release", "flush"}
+
+# rule: (weight per finding, most the rule can cost, explanation)
+RULES = {
+    "printk": (3, 6, "logs on every call; printk takes the console lock and floods the ring buffer under load"),
+    "printk_open": (1, 2, "logs on every open/close; costly for clients that open per request"),
+    "alloc": (3, 6, "allocates on every call; keep buffers per device or per open"),
+    "per_byte_copy": (4, 4, "copies to or from userspace a byte at a time; one copy_*_user per buffer"),
+    "global_lock_copy": (3, 6, "holds a file-scope lock across a user copy, which can fault and sleep, "
+                               "serialising every client on one lock"),
+    "delay": (3, 3, "sleeps or busy-waits on every call"),
+    "no_nonblock": (3, 3, "blocks without honouring O_NONBLOCK, so event-driven clients stall"),
+    "size_truncation": (1, 2, "casts a size_t count to a narrower type; large requests wrap"),
+}
+
+# Most points the lint can take away
+MAX_PENALTY = STAGE_POINTS["hot_path"]
+
+_PRINTK = {"printk", "pr_info", "pr_notice", "pr_warn", "pr_warning", "pr_err", "pr_crit", "pr_alert",
+           "pr_emerg", "pr_cont", "dev_info", "dev_notice", "dev_warn", "dev_err", "dev_crit", "dev_alert",
+           "dev_emerg"}
+# Levels that usually report a failure rather than trace normal operation
+_ERROR_LEVELS = {"KERN_EMERG", "KERN_ALERT", "KERN_CRIT", "KERN_ERR", "KERN_WARNING"}
+_ERROR_PRINTK = {"pr_warn", "pr_warning", "pr_err", "pr_crit", "pr_alert", "pr_emerg", "dev_warn", "dev_err",
+                 "dev_crit", "dev_alert", "dev_emerg"}
+_RATELIMIT = {"printk_ratelimit", "__ratelimit", "net_ratelimit"}
+
+_ALLOC = {"kmalloc", "kzalloc", "kcalloc", "kmalloc_array", "krealloc", "vmalloc", "vzalloc", "kvmalloc",
+          "kvzalloc", "kvcalloc", "kvmalloc_array", "kstrdup", "kmemdup", "memdup_user", "vmemdup_user",
+          "alloc_pages", "alloc_page", "__get_free_pages", "__get_free_page", "get_zeroed_page"}
+_USER_COPY = {"copy_to_user", "copy_from_user", "__copy_to_user", "__copy_from_user", "get_user", "put_user",
+              "__get_user", "__put_user", "copy_to_iter", "copy_from_iter", "simple_read_from_buffer",
+              "simple_write_to_buffer"}
+_BYTE_COPY = {"get_user", "put_user", "__get_user", "__put_user"}
+_DELAY = {"msleep", "msleep_interruptible", "ssleep", "mdelay", "udelay", "ndelay", "usleep_range",
+          "schedule_timeout", "schedule_timeout_interruptible", "schedule_timeout_uninterruptible"}
+_BLOCKING = {"wait_event", "wait_event_interruptible", "wait_event_killable", "wait_event_timeout",
+             "wait_event_interruptible_timeout", "wait_for_completion", "wait_for_completion_interruptible",
+             "wait_for_completion_killable", "wait_for_completion_timeout", "schedule", "down",
+             "down_interruptible", "down_killable"}
+_NONBLOCK = {"O_NONBLOCK", "IOCB_NOWAIT"}
+
+_LOCK = {"mutex_lock", "mutex_lock_interruptible", "mutex_lock_killable", "spin_lock", "spin_lock_irq",
+         "spin_lock_irqsave", "spin_lock_bh", "raw_spin_lock", "raw_spin_lock_irqsave", "read_lock",
+         "write_lock", "down", "down_interruptible", "down_killable", "down_read", "down_write"}
+_UNLOCK = {"mutex_unlock", "spin_unlock", "spin_unlock_irq", "spin_unlock_irqrestore", "spin_unlock_bh",
+           "raw_spin_unlock", "raw_spin_unlock_irqrestore", "read_unlock", "write_unlock", "up", "up_read",
+           "up_write"}
+# File-scope lock definitions: DEFINE_MUTEX(name) and friends, or a
+# declaration of one of the lock types
+_LOCK_DEFINES = {"DEFINE_MUTEX", "DEFINE_SPINLOCK", "DEFINE_RAW_SPINLOCK", "DEFINE_RWLOCK",
+                 "DEFINE_SEMAPHORE", "DECLARE_RWSEM"}
+_LOCK_TYPES = {"mutex", "spinlock_t", "raw_spinlock_t", "rwlock_t", "rw_semaphore", "semaphore"}
+
+_NARROW_TYPES = {"int", "unsigned", "short", "char", "u32", "s32", "u16", "s16", "u8", "s8", "__u32", "__s32"}
+
+
+def _hot_functions(analysis: dict) -> dict:
+    # {function: fops member it is reached from}, following calls between
+    # functions defined in the file; data-path members win over open ones
+    defined = {fn["name"]: fn for fn in analysis["functions"]}
+    roots = []
+    for members in analysis["file_operations"].values():
+        for member, value in members.items():
+            name = value.split()[-1] if value else ""
+            if name in defined:
+                roots.append((member not in OPEN_PATH, member, name))
+    hot = {}
+    for _, member, root in sorted(roots, reverse=True):
+        queue = [root]
+        while queue:
+            name = queue.pop()
+            if name in hot:
+                continue
+            hot[name] = member
+            queue.extend(call for call in defined[name]["calls"] if call in defined)
+    return hot
+
+
+def _global_locks(tokens: list) -> set:
+    # Names of lock variables defined at file scope
+    locks = set()
+    depth = 0
+    for i, (kind, text, _) in enumerate(tokens):
+        if text in ("{", "("):
+            depth += 1
+        elif text in ("}", ")"):
+            depth -= 1
+        elif depth == 0 and kind == "ident" and i + 2 < len(tokens):
+            if text in _LOCK_DEFINES and tokens[i + 1][1] == "(" and tokens[i + 2][0] == "ident":
+                locks.add(tokens[i + 2][1])
+            elif text in _LOCK_TYPES and tokens[i + 1][0] == "ident":
+                locks.add(tokens[i + 1][1])
+    return locks
+
+
+def _split_function(tokens: list, fn: dict) -> tuple:
+    # (parameter tokens, body tokens from "{" to "}") of a definition
+    span = [tok for tok in tokens if fn["start_line"] <= tok[2] <= fn["end_line"]]
+    for i in range(len(span) - 1):
+        if span[i][1] == fn["name"] and span[i + 1][1] == "(":
+            break
+    else:
+        return [], []
+    depth, j = 0, i + 1
+    while j < len(span):
+        depth += {"(": 1, ")": -1}.get(span[j][1], 0)
+        if depth == 0:
+            break
+        j += 1
+    params = span[i + 2:j]
+    while j < len(span) and span[j][1] != "{":
+        j += 1
+    return params, span[j:]
+
+
+def _merge(blocks: list, braceless: list) -> dict:
+    active = blocks + [attrs for attrs, _ in braceless]
+    return {key: any(attrs.get(key) for attrs in active) for key in ("cond", "loop", "ratelimited")}
+
+
+def _contexts(body: list) -> list:
+    # Per body token, whether it sits under a condition, inside a loop, and
+    # under a printk_ratelimit()-style guard. Tracks braced blocks and
+    # single-statement bodies of if/else/for/while/do/switch.
+    contexts = []
+    blocks = []         # attrs of each open "{"
+    braceless = []      # (attrs, block depth) of bodies ending at ";"
+    pending = None      # attrs for the next statement or block
+    header = None       # control statement whose "(...)" is being read
+    paren = 0
+    for kind, text, _ in body:
+        if header is not None:
+            if text == "(":
+                paren += 1
+            elif text == ")":
+                paren -= 1
+                if paren == header["paren"]:
+                    loop = header["kind"] in ("for", "while")
+                    pending = {"cond": not loop, "loop": loop,
+                               "ratelimited": bool(_RATELIMIT & set(header["tokens"]))}
+                    header = None
+            else:
+                header["tokens"].append(text)
+            contexts.append(_merge(blocks, braceless))
+            continue
+        if pending is not None and text != "{":
+            # The body of the control statement is a single statement
+            braceless.append((pending, len(blocks)))
+            pending = None
+        if kind == "ident" and text in ("if", "for", "while", "switch"):
+            header = {"kind": text, "paren": paren, "tokens": []}
+        elif kind == "ident" and text in ("else", "do"):
+            pending = {"cond": text == "else", "loop": text == "do", "ratelimited": False}
+        elif text == "{":
+            blocks.append(pending or {})
+            pending = None
+        elif text == "}":
+            if blocks:
+                blocks.pop()
+            braceless = [entry for entry in braceless if entry[1] < len(blocks)]
+        elif text == "(":
+            paren += 1
+        elif text == ")":
+            paren -= 1
+
+        contexts.append(_merge(blocks, braceless))
+        if text == ";":
+            braceless = [entry for entry in braceless if entry[1] < len(blocks)]
+    return contexts
+
+
+def _call_args(body: list, i: int) -> list:
+    # Tokens of the argument list of the call whose name is body[i]
+    depth, args = 0, []
+    for _, text, _ in body[i + 1:]:
+        if text == "(":
+            depth += 1
+            if depth == 1:
+                continue
+        elif text == ")":
+            depth -= 1
+            if depth == 0:
+                break
+        args.append(text)
+    return args
+
+
+def _lint_function(name: str, op: str, params: list, body: list, global_locks: set) -> list:
+    findings = []
+    data_path = op not in OPEN_PATH
+    sizes = {params[i + 1][1] for i in range(len(params) - 1)
+             if params[i][1] == "size_t" and params[i + 1][0] == "ident"}
+    contexts = _contexts(body)
+    held = []           # global locks taken so far, in source order
+
+    def add(rule, line, detail):
+        findings.append({"rule": rule, "function": name, "op": op, "line": line, "weight": RULES[rule][0],
+                         "message": f"{name}() ({op}): {detail} {RULES[rule][2]}"})
+
+    for i, (kind, text, line) in enumerate(body):
+        ctx = contexts[i]
+        if kind == "ident" and i + 1 < len(body) and body[i + 1][1] == "(":
+            args = _call_args(body, i)
+            if text in _PRINTK and not ctx["ratelimited"]:
+                error = text in _ERROR_PRINTK or (args and args[0] in _ERROR_LEVELS)
+                # Error reports inside a branch are fine; tracing is not
+                if not error or not ctx["cond"]:
+                    add("printk" if data_path else "printk_open", line, f"{text}()")
+            elif text in _ALLOC and data_path:
+                add("alloc", line, f"{text}()")
+            elif text in _DELAY and data_path:
+                add("delay", line, f"{text}()")
+            elif text == "min_t" and data_path and args and args[0] in _NARROW_TYPES and sizes & set(args):
+                add("size_truncation", line, f"min_t({args[0]}, ...)")
+            if text in _USER_COPY and ctx["loop"] and (text in _BYTE_COPY or (args and args[-1] == "1")):
+                add("per_byte_copy", line, f"{text}() in a loop")
+            if text in _LOCK and len(args) >= 2 and args[0] == "&" and args[1] in global_locks:
+                held.append(args[1])
+            elif text in _UNLOCK and len(args) >= 2 and args[0] == "&" and args[1] in held:
+                held.remove(args[1])
+            elif text in _USER_COPY and held and data_path:
+                add("global_lock_copy", line, f"{text}() under {held[-1]}")
+                held = []   # once per critical section
+        elif text == "(" and i + 3 < len(body) and data_path:
+            # (int)count, (unsigned int)len, min_t(int, count, ...)
+            j = i + 1
+            while j < len(body) and body[j][1] in _NARROW_TYPES:
+                j += 1
+            if j > i + 1 and j + 1 < len(body) and body[j][1] == ")" and body[j + 1][1] in sizes:
+                add("size_truncation", line, f"({' '.join(t for _, t, _ in body[i + 1:j])}){body[j + 1][1]}")
+    return findings
+
+
+def lint_hot_paths(source_path: str, analysis: dict = None) -> dict:
+    # Performance anti-patterns in the functions a file_operations table
+    # registers and everything they call in the same file. Each finding
+    # carries its rule's weight; penalty is the weighted total, capped per
+    # rule and overall.
+    # analysis must carry the token stream (analyze_file(..., with_tokens=True))
+    if analysis is None or "tokens" not in analysis:
+        analysis = analyze_file(source_path, with_tokens=True)
+    tokens = analysis["tokens"]
+    hot = _hot_functions(analysis)
+    global_locks = _global_locks(tokens)
+
+    findings = []
+    blocking = None     # first blocking call on the data path
+    for fn in analysis["functions"]:
+        op = hot.get(fn["name"])
+        if op is None:
+            continue
+        params, body = _split_function(tokens, fn)
+        findings += _lint_function(fn["name"], op, params, body, global_locks)
+        if blocking is None and op not in OPEN_PATH:
+            blocking = next(((text, line) for i, (kind, text, line) in enumerate(body)
+                             if text in _BLOCKING and i + 1 < len(body) and body[i + 1][1] == "("), None)
+            if blocking:
+                blocking = (fn["name"], op) + blocking
+    if blocking and not any(text in _NONBLOCK for _, text, _ in tokens):
+        name, op, call, line = blocking
+        findings.append({"rule": "no_nonblock", "function": name, "op": op, "line": line,
+                         "weight": RULES["no_nonblock"][0],
+                         "message": f"{name}() ({op}): {call}() {RULES['no_nonblock'][2]}"})
+
+    penalties = {}
+    for finding in findings:
+        rule = finding["rule"]
+        penalties[rule] = min(RULES[rule][1], penalties.get(rule, 0) + finding["weight"])
+    findings.sort(key=lambda finding: finding["line"])
+    return {
+        "hot_functions": hot,
+        "findings": findings,
+        "penalties": penalties,
+        "penalty": min(MAX_PENALTY, sum(penalties.values())),
+    }
@@ -0,0 +1,144 @@
+import os
+
+from compile_check import ARCHITECTURES, compile_driver
+from static_analysis import static_check, run_checkpatch, run_sparse
+from style_checker import check_style
+from perf_lint import lint_hot_paths
+from source_analyzer import analyze_file
+from runtime_check import runtime_functionality_test
+from runtime_harness import reference_mbps, run_harness, run_stress
+from scoring import score_evaluation, sustained_mbps
+from tiering import TIERS
+from executor import DagExecutor, Task
+
+CHECKPATCH_PATH = "checkpatch.pl"
+
+# Per-invocation tool timeouts in seconds
+TOOL_TIMEOUTS = {
+    "compile": 60,
+    "kbuild": 600,
+    "static": 120,
+    "checkpatch": 60,
+    "sparse": 60,
+    "harness": 60,
+    "stress": 180,
+    "qemu": 300,
+}
+
+def _tool_error(exc: Exception) -> dict:
+    if isinstance(exc, FileNotFoundError):
+        return {"success": False, "error": f"Tool {exc.filename} not found."}
+    return {"success": False, "error": f"{type(exc).__name__}: {exc}"}
+
+def _static_error(exc: Exception) -> str:
+    # static_check yields raw cppcheck stderr, so keep the failure a string
+    return f"error: {_tool_error(exc)['error']}"
+
+def compile_stage(arch: str) -> str:
+    return f"compile_{arch}"
+
+def _harness(source_path: str, ctx) -> dict:
+    # Throughput is judged against the reference driver on the same
+    # machine, measured up front by runtime_harness.measure_reference()
+    result = run_harness(source_path, timeout=ctx.timeout, cancel=ctx.cancel)
+    if result.get("loaded"):
+        baseline = reference_mbps()
+        if baseline:
+            result["baseline_mbps"] = baseline
+            result["relative_to_reference"] = round(sustained_mbps(result) / baseline, 3)
+    return result
+
+def _stress(source_path: str, ctx) -> dict:
+    # Only a driver that loads single-threaded is worth stressing
+    harness = ctx.results["harness"]
+    if not harness.get("loaded"):
+        return {"skipped": True, "reason": "driver did not load in the harness"}
+    return run_stress(source_path, timeout=ctx.timeout, cancel=ctx.cancel)
+
+def _qemu(qemu, ctx) -> dict:
+    # Needs the .ko that a kbuild compile with keep_modules leaves behind
+    module = ctx.results[compile_stage("x86_64")].get("module")
+    if not module or not os.path.isfile(module):
+        return {"skipped": True, "reason": "no x86_64 module was built"}
+    return qemu.test_module(module, timeout=ctx.timeout, cancel=ctx.cancel)
+
+def _score(ctx, policy) -> dict:
+    r = ctx.results
+    skipped = policy.skipped(r) if policy is not None else None
+    score = score_evaluation(r[compile_stage("x86_64")], r["style"], r["static"], r["checkpatch"],
+                             r["sparse"], r["runtime"], r["harness"], r["stress"], r["perf_lint"],
+                             skipped=skipped)
+    if policy is not None:
+        score["estimated_seconds_saved"] = policy.saved_seconds(skipped)
+        policy.record(score)
+    return score
+
+def build_stages(source_path: str, checkpatch_path: str = CHECKPATCH_PATH, timeouts: dict = None,
+                 cache=None, kbuild=None, policy=None, qemu=None, tools=None) -> list:
+    # kbuild: optional KbuildCompiler replacing the plain gcc -c compiles;
+    # policy: optional tiering.TierPolicy gating the expensive stages;
+    # qemu: optional qemu_loader.QemuLoader loading the kbuild module for real;
+    # tools: optional tool_pool.StaticToolPool running checkpatch on warm
+    # workers and cppcheck in batches
+    timeouts = {**TOOL_TIMEOUTS, **(timeouts or {})}
+    tasks = []
+    for arch, compiler in ARCHITECTURES.items():
+        if kbuild is not None:
+            fn = lambda ctx, arch=arch: kbuild.compile(
+                source_path, arch, timeout=ctx.timeout, cancel=ctx.cancel)
+        else:
+            fn = lambda ctx, compiler=compiler: compile_driver(
+                source_path, compiler, timeout=ctx.timeout, cancel=ctx.cancel, cache=cache)
+        tasks.append(Task(compile_stage(arch), fn, timeout=timeouts["compile" if kbuild is None else "kbuild"],
+                          fallback=_tool_error))
+    tasks += [
+        Task("static", lambda ctx: static_check(
+                 source_path, timeout=ctx.timeout, cancel=ctx.cancel, cache=cache, pool=tools),
+             timeout=timeouts["static"], fallback=_static_error),
+        # One tokenizer pass feeds the style metrics, the hot-path lint and the runtime check
+        Task("analyze", lambda ctx: analyze_file(source_path, with_tokens=True)),
+        Task("style", lambda ctx: check_style(source_path, ctx.results["analyze"]), deps=["analyze"]),
+        Task("perf_lint", lambda ctx: lint_hot_paths(source_path, ctx.results["analyze"]), deps=["analyze"]),
+        Task("checkpatch", lambda ctx: run_checkpatch(
+                 source_path, checkpatch_path, timeout=ctx.timeout, cancel=ctx.cancel, cache=cache, pool=tools),
+             timeout=timeouts["checkpatch"], fallback=_tool_error),
+        Task("sparse", lambda ctx: run_sparse(
+                 source_path, timeout=ctx.timeout, cancel=ctx.cancel, cache=cache),
+             timeout=timeouts["sparse"], fallback=_tool_error),
+        # Load the driver against the kernel shims and drive its fops
+        Task("harness", lambda ctx: _harness(source_path, ctx),
+             timeout=timeouts["harness"], fallback=_tool_error),
+        Task("stress", lambda ctx: _stress(source_path, ctx), deps=["harness"],
+             timeout=timeouts["stress"], fallback=_tool_error),
+    ]
+    runtime_deps = [compile_stage("x86_64"), "analyze", "harness"]
+    if qemu is not None:
+        tasks.append(Task("qemu", lambda ctx: _qemu(qemu, ctx), deps=[compile_stage("x86_64")],
+                          timeout=timeouts["qemu"], fallback=_tool_error))
+        runtime_deps.append("qemu")
+    # Use x86_64 result for further analysis (as an example)
+    tasks.append(Task("runtime", lambda ctx: runtime_functionality_test(
+                          source_path, ctx.results[compile_stage("x86_64")], ctx.results["analyze"],
+                          ctx.results["harness"], ctx.results.get("qemu")),
+                      deps=runtime_deps))
+    score_deps = [compile_stage("x86_64"), "style", "static", "checkpatch", "sparse", "runtime", "harness",
+                  "stress", "perf_lint"]
+    if policy is not None:
+        tasks = policy.apply(tasks)
+        # Wait for every tiered stage so the skip report is complete
+        names = {task.name for task in tasks}
+        score_deps = [name for name in TIERS if name != "analyze" and name in names]
+    tasks.append(Task("score", lambda ctx: _score(ctx, policy), deps=score_deps))
+    return tasks
+
+def evaluate_driver(source_path: str, checkpatch_path: str = CHECKPATCH_PATH,
+                    executor: DagExecutor = None, timeouts: dict = None, cache=None,
+                    kbuild=None, policy=None, qemu=None, tools=None) -> dict:
+    tasks = build_stages(source_path, checkpatch_path, timeouts, cache, kbuild, policy, qemu, tools)
+    if executor is not None:
+        return executor.run(tasks)
+    executor = DagExecutor()
+    try:
+        return executor.run(tasks)
+    finally:
+        executor.shutdown()
@@ -0,0 +1,578 @@
+import base64
+import gzip
+import hashlib
+import os
+import queue
+import re
+import shlex
+import shutil
+import signal
+import socket
+import subprocess
+import tempfile
+import threading
+import time
+
+from metrics import METRICS
+from tool_runner import run_tool, ToolCancelled
+
+QEMU = os.environ.get("QEMU", "qemu-system-x86_64")
+GUEST_DIR = "qemu_guest"
+MEMORY = "256M"
+# quiet/loglevel keep printk off the serial line the agent talks over;
+# panic=-1 plus -no-reboot turns a guest panic into a QEMU exit
+KERNEL_CMDLINE = "console=ttyS0 quiet loglevel=1 panic=-1 rdinit=/init"
+
+BOOT_TIMEOUT = 300
+RESTORE_TIMEOUT = 60
+TEST_TIMEOUT = 120
+
+# dd smoke workload run against the device node; its MB/s under TCG is
+# reported but not scored (the harness measures performance)
+DD_BLOCK_SIZE = 4096
+DD_COUNT = 256
+# Guest-side limit on each workload step (the roundtrip write and read, each
+# dd). busybox's write loop retries forever on a 0-byte write, and a blocking
+# driver can wait forever for data, so a stuck step is killed and reported
+# as hung instead of using up the whole test timeout.
+STEP_TIMEOUT = 15
+
+# Guest agent, started as /init. Commands arrive one per line on the serial
+# console; every reply line starts with "@@" so console noise can be skipped.
+#   PING                 -> @@READY <kernel release>
+#   LOAD <id>            base64 module lines follow, terminated by END
+#   TEST <id> <bs> <n> <limit>
+#                        insmod, workload (each step killed after limit
+#                        seconds), rmmod, dmesg -> @@BEGIN ... @@END
+AGENT = r'''#!/bin/busybox sh
+/bin/busybox --install -s
+mount -t proc proc /proc
+mount -t sysfs sysfs /sys
+mount -t devtmpfs devtmpfs /dev 2>/dev/null
+dmesg -n 1
+stty -echo 2>/dev/null
+
+ms() { awk '{ printf "%d", $1 * 1000 }' /proc/uptime; }
+
+new_lines() { grep -vxFf "$1" "$2" 2>/dev/null | head -n 1; }
+
+# limited <step> <command...>: run a workload step under the step limit
+limited() {
+    step=$1; shift
+    timeout -s KILL "$limit" "$@"; rc=$?
+    # 137: killed by SIGKILL
+    [ $rc -eq 137 ] && echo "@@HUNG $step"
+    return $rc
+}
+
+load() {
+    while read -r line; do
+        [ "$line" = END ] && break
+        echo "$line"
+    done | base64 -d > "/tmp/$1.ko"
+    echo "@@LOADED $1 $(wc -c < "/tmp/$1.ko")"
+}
+
+test_module() {
+    id=$1 bs=$2 count=$3 limit=$4
+    echo "@@BEGIN $id"
+    dmesg -c > /dev/null
+    cat /proc/devices > /tmp/devices
+    cat /proc/misc > /tmp/misc 2>/dev/null
+    cut -d' ' -f1 /proc/modules > /tmp/modules
+    ls /dev > /tmp/nodes
+    t0=$(ms); insmod "/tmp/$id.ko"; rc=$?; t1=$(ms)
+    echo "@@STEP insmod $rc $((t1 - t0))"
+    if [ $rc -eq 0 ]; then
+        name=$(cut -d' ' -f1 /proc/modules | grep -vxFf /tmp/modules | head -n 1)
+        node=$(ls /dev | grep -vxFf /tmp/nodes | head -n 1)
+        dev=
+        if [ -n "$node" ]; then
+            dev=/dev/$node
+        else
+            # Character devices are listed before block devices
+            major=$(new_lines /tmp/devices /proc/devices | awk '{ print $1 }')
+            minor=$(new_lines /tmp/misc /proc/misc | awk '{ print $1 }')
+            if [ -n "$major" ]; then
+                dev=/dev/under-test; mknod $dev c "$major" 0
+            elif [ -n "$minor" ]; then
+                dev=/dev/under-test; mknod $dev c 10 "$minor"
+            fi
+        fi
+        echo "@@DEV $dev"
+        if [ -n "$dev" ]; then
+            limited write sh -c 'echo kshim-roundtrip > "$1"' sh "$dev"; rc=$?
+            echo "@@STEP write $rc 0"
+            limited roundtrip dd if="$dev" of=/tmp/roundtrip bs=64 count=1 2>/dev/null
+            grep -q kshim-roundtrip /tmp/roundtrip 2>/dev/null
+            echo "@@STEP roundtrip $? 0"
+            t0=$(ms); limited dd-write dd if=/dev/zero of="$dev" bs="$bs" count="$count" 2>/tmp/dd; rc=$?; t1=$(ms)
+            echo "@@DD write $rc $((t1 - t0)) $(tail -n 1 /tmp/dd)"
+            t0=$(ms); limited dd-read dd if="$dev" of=/dev/null bs="$bs" count="$count" 2>/tmp/dd; rc=$?; t1=$(ms)
+            echo "@@DD read $rc $((t1 - t0)) $(tail -n 1 /tmp/dd)"
+            rm -f /tmp/roundtrip
+            [ "$dev" = /dev/under-test ] && rm -f "$dev"
+        fi
+        t0=$(ms); rmmod "${name:-$id}"; rc=$?; t1=$(ms)
+        echo "@@STEP rmmod $rc $((t1 - t0))"
+    fi
+    rm -f "/tmp/$id.ko"
+    echo "@@TAINT $(cat /proc/sys/kernel/tainted)"
+    echo "@@DMESG"
+    dmesg
+    echo "@@END $id"
+}
+
+while read -r cmd id arg1 arg2 arg3; do
+    case "$cmd" in
+        PING) echo "@@READY $(uname -r)" ;;
+        LOAD) load "$id" ;;
+        TEST) test_module "$id" "$arg1" "$arg2" "$arg3" ;;
+    esac
+done
+'''
+
+_OOPS_RE = re.compile(r"Oops|BUG:|kernel BUG at|general protection fault|Call Trace:|WARNING:|"
+                      r"Unable to handle|KASAN|UBSAN")
+# busybox: "1048576 bytes (1.0MB) copied, 0.01 seconds, 100MB/s"
+# coreutils: "1048576 bytes (1.0 MB, 1.0 MiB) copied, 0.01 s, 100 MB/s"
+_DD_RE = re.compile(r"(\d+) bytes .*copied, ([\d.]+) s")
+
+
+def _cpio_entry(name: str, mode: int, data: bytes = b"", rdev: tuple = (0, 0)) -> bytes:
+    # newc header: magic plus 13 8-digit hex fields, NUL-terminated name,
+    # name and data each padded to 4 bytes
+    name_bytes = name.encode() + b"\0"
+    fields = [0, mode, 0, 0, 1, 0, len(data), 0, 0, *rdev, len(name_bytes), 0]
+    header = b"070701" + b"".join(b"%08X" % field for field in fields)
+    entry = header + name_bytes
+    entry += b"\0" * (-len(entry) % 4)
+    entry += data + b"\0" * (-len(data) % 4)
+    return entry
+
+
+def kernel_release(kdir: str) -> str:
+    # The release modules built against kdir are stamped with (vermagic)
+    path = os.path.join(kdir, "include", "config", "kernel.release")
+    if os.path.isfile(path):
+        with open(path) as f:
+            return f.read().strip()
+    result = run_tool(["make", "-s", "-C", kdir, "kernelrelease"], timeout=60, label="make")
+    return result.stdout.strip() if result.returncode == 0 else None
+
+
+def image_release(kernel: str) -> str:
+    # An x86 bzImage's setup header ("HdrS" at 0x202) points at its version
+    # string ("6.8.0-31-generic (buildd@...) #31 ...") through the word at
+    # 0x20e, relative to 0x200. None for other images.
+    with open(kernel, "rb") as f:
+        header = f.read(0x210)
+        if len(header) < 0x210 or header[0x202:0x206] != b"HdrS":
+            return None
+        offset = int.from_bytes(header[0x20e:0x210], "little")
+        if not offset:
+            return None
+        f.seek(offset + 0x200)
+        version = f.read(256).split(b"\0", 1)[0].decode(errors="replace").split()
+    return version[0] if version else None
+
+
+def _remaining(deadline: float, tool: str = "qemu") -> float:
+    remaining = deadline - time.monotonic()
+    if remaining <= 0:
+        raise subprocess.TimeoutExpired(tool, 0)
+    return remaining
+
+
+def build_initramfs(path: str, busybox: str):
+    # Written directly so the host needs neither cpio nor root for mknod
+    with open(busybox, "rb") as f:
+        busybox_data = f.read()
+    archive = b"".join([
+        *(_cpio_entry(d, 0o040755) for d in ("bin", "sbin", "dev", "proc", "sys", "tmp", "usr",
+                                             "usr/bin", "usr/sbin")),
+        # The kernel opens /dev/console for init before devtmpfs is mounted
+        _cpio_entry("dev/console", 0o020600, rdev=(5, 1)),
+        _cpio_entry("bin/busybox", 0o100755, busybox_data),
+        _cpio_entry("init", 0o100755, AGENT.encode()),
+        _cpio_entry("TRAILER!!!", 0),
+    ])
+    fd, tmp = tempfile.mkstemp(dir=os.path.dirname(path) or ".", suffix=".tmp")
+    with os.fdopen(fd, "wb") as f:
+        f.write(gzip.compress(archive))
+    os.replace(tmp, path)
+
+
+def parse_report(lines: list) -> dict:
+    # Turn the agent's @@ lines for one TEST into a result
+    result = {
+        "success": True,
+        "loaded": False,
+        "load_ms": None,
+        "device": None,
+        "roundtrip": None,
+        "throughput": {},
+        # Workload steps killed by the guest-side step limit
+        "hung_steps": [],
+        "unloaded": False,
+        "unload_ms": None,
+        "tainted": 0,
+    }
+    dmesg = []
+    in_dmesg = False
+    for line in lines:
+        if line.startswith("@@END"):
+            break
+        if in_dmesg:
+            dmesg.append(line)
+            continue
+        parts = line.split(" ", 4)
+        if parts[0] == "@@STEP" and len(parts) >= 4:
+            step, rc, ms = parts[1], int(parts[2]), int(parts[3])
+            if step == "insmod":
+                result["loaded"], result["load_ms"] = rc == 0, ms
+            elif step == "rmmod":
+                result["unloaded"], result["unload_ms"] = rc == 0, ms
+            elif step == "roundtrip":
+                result["roundtrip"] = rc == 0
+        elif parts[0] == "@@HUNG" and len(parts) > 1:
+            result["hung_steps"].append(parts[1])
+        elif parts[0] == "@@DEV":
+            result["device"] = parts[1] if len(parts) > 1 and parts[1] else None
+        elif parts[0] == "@@DD" and len(parts) >= 4:
+            match = _DD_RE.search(parts[4] if len(parts) > 4 else "")
+            nbytes = int(match.group(1)) if match else 0
+            seconds = float(match.group(2)) if match else int(parts[3]) / 1000
+            result["throughput"][parts[1]] = {
+                "status": int(parts[2]),
+                "bytes": nbytes,
+                "seconds": seconds,
+                "mb_per_sec": round(nbytes / seconds / 1e6, 3) if seconds > 0 else 0.0,
+            }
+        elif parts[0] == "@@TAINT" and len(parts) > 1 and parts[1].isdigit():
+            result["tainted"] = int(parts[1])
+        elif parts[0] == "@@DMESG":
+            in_dmesg = True
+    oops = [line for line in dmesg if _OOPS_RE.search(line)]
+    result["oops"] = bool(oops)
+    result["oops_lines"] = oops[:20]
+    result["dmesg"] = "\n".join(dmesg[-200:])
+    return result
+
+
+class GuestSession:
+    # One QEMU process restored from the pre-booted state, talking to the
+    # agent over its serial console. Tests run one at a time.
+
+    def __init__(self, argv: list, state_path: str):
+        self.proc = subprocess.Popen(
+            argv + ["-incoming", f"exec:cat {shlex.quote(state_path)}"],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+            start_new_session=True
+        )
+        self.lines = queue.Queue()
+        self.console = []       # recent non-agent output, for crash reports
+        self.tests = 0
+        threading.Thread(target=self._read, daemon=True, name="qemu-serial").start()
+
+    def _read(self):
+        for raw in self.proc.stdout:
+            self.lines.put(raw.decode(errors="replace").rstrip("\r\n"))
+        self.lines.put(None)
+
+    def send(self, text: str):
+        self.proc.stdin.write(text.encode())
+        self.proc.stdin.flush()
+
+    def expect(self, prefix: str, timeout: float, cancel=None) -> list:
+        # Agent lines up to and including the first starting with prefix
+        deadline = time.monotonic() + timeout
+        collected = []
+        while True:
+            if cancel is not None and cancel.is_set():
+                raise ToolCancelled("qemu")
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                # The lines so far tell the caller how far the guest got
+                raise subprocess.TimeoutExpired("qemu", timeout, output=collected)
+            try:
+                line = self.lines.get(timeout=min(remaining, 0.1))
+            except queue.Empty:
+                continue
+            if line is None:
+                raise EOFError("guest exited")
+            collected.append(line)
+            if not line.startswith("@@"):
+                self.console = (self.console + [line])[-50:]
+            if line.startswith(prefix):
+                return collected
+
+    def alive(self) -> bool:
+        return self.proc.poll() is None
+
+    def close(self):
+        if self.proc.poll() is None:
+            try:
+                os.killpg(self.proc.pid, signal.SIGKILL)
+            except ProcessLookupError:
+                pass
+        self.proc.wait()
+
+
+class QemuLoader:
+    # Loads built .ko modules into TCG guests with insmod and runs a dd
+    # smoke workload against the device they register. The guest is booted
+    # once and its state saved; every session then restores that state
+    # instead of cold-booting, and tests several drivers before being
+    # recycled. A session that oopsed or kept a module loaded is discarded.
+    #
+    # kdir is the tree the modules are built against. insmod rejects a
+    # module whose vermagic names another kernel, so prepare() refuses a
+    # guest kernel whose release differs from kdir's.
+
+    def __init__(self, kernel: str = None, busybox: str = None, sessions: int = 1,
+                 memory: str = MEMORY, work_dir: str = GUEST_DIR, block_size: int = DD_BLOCK_SIZE,
+                 count: int = DD_COUNT, max_tests: int = 32, kdir: str = None,
+                 step_timeout: int = STEP_TIMEOUT):
+        self.kernel = kernel or os.environ.get("GUEST_KERNEL")
+        self.kdir = kdir
+        self.busybox = busybox or os.environ.get("BUSYBOX") or shutil.which("busybox")
+        self.sessions = sessions
+        self.memory = memory
+        self.work_dir = os.path.abspath(work_dir)
+        self.block_size = block_size
+        self.count = count
+        self.step_timeout = step_timeout
+        self.max_tests = max_tests
+        self._state = None
+        self._mismatch = None
+        self._guest_argv = None
+        self._prepare_lock = threading.Lock()
+        self._idle = queue.Queue()
+        self._slots = threading.Semaphore(sessions)
+        self._ids = 0
+        self._ids_lock = threading.Lock()
+
+    def unavailable(self):
+        # Why tests cannot run here, or None
+        if shutil.which(QEMU) is None:
+            return f"{QEMU} not found"
+        if not self.kernel or not os.path.isfile(self.kernel):
+            return "no guest kernel (set GUEST_KERNEL)"
+        if not self.busybox or not os.path.isfile(self.busybox):
+            return "no static busybox for the initramfs (set BUSYBOX)"
+        return None
+
+    def _argv(self, initramfs: str, monitor: str = "none") -> list:
+        # The restoring command line must match the saving one apart from
+        # the monitor, which is not part of the guest state
+        return [QEMU, "-accel", "tcg", "-m", self.memory, "-smp", "1", "-no-reboot",
+                "-kernel", self.kernel, "-initrd", initramfs, "-append", KERNEL_CMDLINE,
+                "-display", "none", "-serial", "stdio", "-monitor", monitor, "-nodefaults"]
+
+    def prepare(self, deadline: float = None):
+        # Build the initramfs and the booted snapshot once per kernel,
+        # busybox and agent revision, and check the guest runs the kernel
+        # the modules are built for
+        if deadline is None:
+            deadline = time.monotonic() + BOOT_TIMEOUT
+        if not self._prepare_lock.acquire(timeout=_remaining(deadline)):
+            raise subprocess.TimeoutExpired("qemu", 0)
+        try:
+            self._prepare(deadline)
+        finally:
+            self._prepare_lock.release()
+
+    def _prepare(self, deadline: float):
+        if self._mismatch:
+            raise RuntimeError(self._mismatch)
+        if self._state is not None:
+            return
+        reason = self.unavailable()
+        if reason:
+            raise RuntimeError(reason)
+        built_for = kernel_release(self.kdir) if self.kdir else None
+        if self.kdir:
+            # Checked before booting when the image says what it is
+            self._check_release(image_release(self.kernel), built_for)
+        digest = hashlib.sha256()
+        for path in (self.kernel, self.busybox):
+            with open(path, "rb") as f:
+                digest.update(f.read())
+        digest.update(f"{AGENT}{self.memory}{KERNEL_CMDLINE}".encode())
+        guest_dir = os.path.join(self.work_dir, digest.hexdigest()[:16])
+        os.makedirs(guest_dir, exist_ok=True)
+        initramfs = os.path.join(guest_dir, "initramfs.cpio.gz")
+        state = os.path.join(guest_dir, "booted.state")
+        release_path = os.path.join(guest_dir, "release")
+        if not os.path.exists(initramfs):
+            build_initramfs(initramfs, self.busybox)
+        if not os.path.exists(state) or not os.path.exists(release_path):
+            release = self._boot_and_save(initramfs, state, deadline)
+            with open(release_path, "w") as f:
+                f.write(release + "\n")
+        with open(release_path) as f:
+            guest_release = f.read().strip()
+        if self.kdir:
+            self._check_release(guest_release, built_for)
+        self._guest_argv = self._argv(initramfs)
+        self._state = state
+
+    def _check_release(self, guest_release: str, built_for: str):
+        # Every insmod would fail on vermagic, so no driver is at fault; the
+        # qemu stage reports an error instead of a failed load
+        if guest_release is None or guest_release == built_for:
+            return
+        self._mismatch = (f"guest kernel {guest_release} does not match the module tree {self.kdir} "
+                          f"({built_for or 'release unknown'}); GUEST_KERNEL must be built from that tree")
+        raise RuntimeError(self._mismatch)
+
+    def _boot_and_save(self, initramfs: str, state: str, deadline: float) -> str:
+        # Cold-boot once, wait for the agent, then migrate the paused guest
+        # to a file that every session restores from. Returns the guest's
+        # kernel release.
+        started = time.monotonic()
+        monitor = os.path.join(os.path.dirname(state), "monitor.sock")
+        if os.path.exists(monitor):
+            os.unlink(monitor)
+        argv = self._argv(initramfs, f"unix:{monitor},server=on,wait=off")
+        proc = subprocess.Popen(argv, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                stderr=subprocess.DEVNULL, start_new_session=True)
+        tmp = state + ".tmp"
+        outcome = "failed"
+        release = []
+        try:
+            deadline = min(deadline, time.monotonic() + BOOT_TIMEOUT)
+            ready = threading.Event()
+
+            def watch():
+                for raw in proc.stdout:
+                    if raw.startswith(b"@@READY"):
+                        release.append(raw.decode(errors="replace")[len("@@READY"):].strip())
+                        ready.set()
+                        return
+            threading.Thread(target=watch, daemon=True).start()
+            while not ready.is_set():
+                if proc.poll() is not None or time.monotonic() > deadline:
+                    raise RuntimeError("guest did not boot to the agent")
+                proc.stdin.write(b"PING\n")
+                proc.stdin.flush()
+                ready.wait(1.0)
+            with socket.socket(socket.AF_UNIX) as mon:
+                mon.connect(monitor)
+                mon.settimeout(_remaining(deadline))
+                for command in ("stop", f"migrate \"exec:cat > {tmp}\""):
+                    mon.sendall(command.encode() + b"\n")
+                while time.monotonic() < deadline:
+                    mon.sendall(b"info migrate\n")
+                    time.sleep(0.5)
+                    status = mon.recv(65536).decode(errors="replace")
+                    if "completed" in status:
+                        break
+                    if "failed" in status:
+                        raise RuntimeError("saving the booted guest failed")
+                else:
+                    raise RuntimeError("saving the booted guest timed out")
+            os.replace(tmp, state)
+            outcome = "ok"
+            return release[0]
+        finally:
+            try:
+                os.killpg(proc.pid, signal.SIGKILL)
+            except ProcessLookupError:
+                pass
+            proc.wait()
+            if os.path.exists(tmp):
+                os.unlink(tmp)
+            METRICS.record_tool("qemu-boot", time.monotonic() - started, None, outcome)
+
+    def _acquire(self, deadline: float, cancel=None) -> GuestSession:
+        while not self._slots.acquire(timeout=min(0.1, _remaining(deadline))):
+            if cancel is not None and cancel.is_set():
+                raise ToolCancelled("qemu")
+        try:
+            session = self._idle.get_nowait()
+            if session.alive():
+                return session
+            session.close()
+        except queue.Empty:
+            pass
+        started = time.monotonic()
+        session = GuestSession(self._guest_argv, self._state)
+        try:
+            session.send("PING\n")
+            session.expect("@@READY", min(RESTORE_TIMEOUT, _remaining(deadline)), cancel)
+        except BaseException:
+            session.close()
+            self._slots.release()
+            METRICS.record_tool("qemu-restore", time.monotonic() - started, None, "failed")
+            raise
+        METRICS.record_tool("qemu-restore", time.monotonic() - started)
+        return session
+
+    def _release(self, session: GuestSession, reuse: bool):
+        if reuse and session.alive() and session.tests < self.max_tests:
+            self._idle.put(session)
+        else:
+            session.close()
+        self._slots.release()
+
+    def _strip(self, module: str, out: str, timeout=None, cancel=None) -> str:
+        # Debug info would dominate the serial transfer
+        result = run_tool(["strip", "--strip-debug", "-o", out, module], timeout=timeout, cancel=cancel,
+                          label="strip")
+        return out if result.returncode == 0 else module
+
+    def test_module(self, module: str, timeout: float = TEST_TIMEOUT, cancel=None) -> dict:
+        # timeout covers the whole test: preparing the guest, stripping,
+        # waiting for a session and every exchange with the agent
+        started = time.monotonic()
+        deadline = started + timeout
+        self.prepare(deadline)
+        with tempfile.TemporaryDirectory(prefix="qemu-") as work:
+            with open(self._strip(module, os.path.join(work, "m.ko"), _remaining(deadline, "strip"), cancel),
+                      "rb") as f:
+                payload = base64.encodebytes(f.read()).decode()
+        with self._ids_lock:
+            self._ids += 1
+            test_id = f"m{self._ids}"
+
+        session = self._acquire(deadline, cancel)
+        reuse = False
+        outcome = "failed"
+        try:
+            session.tests += 1
+            session.send(f"LOAD {test_id}\n{payload}END\n")
+            session.expect(f"@@LOADED {test_id}", _remaining(deadline), cancel)
+            session.send(f"TEST {test_id} {self.block_size} {self.count} {self.step_timeout}\n")
+            session.expect(f"@@BEGIN {test_id}", _remaining(deadline), cancel)
+            lines = session.expect(f"@@END {test_id}", _remaining(deadline), cancel)
+            result = parse_report(lines)
+            # A tainted or still-populated guest would skew the next driver
+            reuse = not result["oops"] and (result["unloaded"] or not result["loaded"])
+            outcome = "ok"
+        except subprocess.TimeoutExpired as exc:
+            outcome = "timeout"
+            # Keep what the agent reported before it stopped answering, so a
+            # driver whose insmod succeeded still counts as loaded
+            result = parse_report(exc.output or [])
+            result.update({"success": False, "crashed": False, "hung": True,
+                           "error": f"guest did not answer within {timeout}s", "console": session.console})
+        except EOFError:
+            result = {"success": False, "crashed": True, "hung": False,
+                      "error": "guest died (panic)", "console": session.console}
+        except ToolCancelled:
+            outcome = "cancelled"
+            raise
+        finally:
+            self._release(session, reuse)
+            METRICS.record_tool("qemu-test", time.monotonic() - started, None, outcome)
+        result["wall_seconds"] = round(time.monotonic() - started, 3)
+        return result
+
+    def close(self):
+        while True:
+            try:
+                self._idle.get_nowait().close()
+            except queue.Empty:
+                return
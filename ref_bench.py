@@ -0,0 +1,106 @@
+import argparse
+import json
+import os
+import shutil
+import sys
+import tempfile
+
+from runtime_harness import CC, CFLAGS, DRIVER_FLAGS, KSHIM_DIR, KSHIM_INCLUDE, REFERENCE_DRIVER, WARNINGS
+from tool_runner import run_tool
+
+BENCH_SOURCE = os.path.join(os.path.dirname(REFERENCE_DRIVER), "refbench.c")
+DEFAULT_SIZES = (64, 512, 4096, 16384)
+# read/write, readv/writev, splice into a pipe, and the mmap()ed ring
+MODES = ("rw", "vec", "splice", "mmap")
+DEFAULT_BYTES = 64 << 20
+DEFAULT_RING = 1 << 20
+
+
+def run_ref_bench(sizes: tuple = DEFAULT_SIZES, total_bytes: int = DEFAULT_BYTES, ring: int = DEFAULT_RING,
+                  modes: tuple = MODES, timeout=None) -> dict:
+    # Stream total_bytes through the reference driver per message size and
+    # transfer mode; speedups are against the scalar read()/write() path
+    work = tempfile.mkdtemp(prefix="refbench-")
+    try:
+        binary = os.path.join(work, "refbench")
+        driver = os.path.join(work, "driver.o")
+        define = f'-DKSHIM_DRIVER="{REFERENCE_DRIVER}"'
+        # The driver is built like a generated one; the shim and the
+        # benchmark itself get the full warning set
+        build = run_tool([CC, *CFLAGS, *DRIVER_FLAGS, "-I", KSHIM_INCLUDE, define, "-c",
+                          os.path.join(KSHIM_DIR, "driver_wrapper.c"), "-o", driver],
+                         timeout=timeout, label="refbench-build")
+        if build.returncode == 0:
+            build = run_tool([CC, *CFLAGS, *WARNINGS, "-I", KSHIM_DIR, "-I", KSHIM_INCLUDE, driver,
+                              os.path.join(KSHIM_DIR, "kshim.c"), BENCH_SOURCE, "-o", binary],
+                             timeout=timeout, label="refbench-build")
+        if build.returncode != 0:
+            return {"built": False, "stderr": build.stderr[-2000:]}
+        run = run_tool([binary, "--sizes", ",".join(str(size) for size in sizes), "--bytes", str(total_bytes),
+                        "--ring", str(ring), "--modes", ",".join(modes)], timeout=timeout, label="refbench-run")
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+    by_size = {}
+    for line in run.stdout.splitlines():
+        try:
+            entry = json.loads(line)
+        except ValueError:
+            continue
+        by_size.setdefault(str(entry.pop("size")), {})[entry.pop("mode")] = entry
+    for entry in by_size.values():
+        scalar = entry.get("rw", {}).get("mb_per_sec", 0)
+        for mode in entry.values():
+            if scalar > 0:
+                mode["speedup"] = round(mode["mb_per_sec"] / scalar, 2)
+    return {
+        "built": True,
+        "exit_status": run.returncode,
+        "error": run.stderr.strip()[-2000:] if run.returncode else None,
+        "ring": ring,
+        "bytes": total_bytes,
+        "cpus": os.cpu_count(),
+        "sizes": by_size,
+    }
+
+
+def print_report(result: dict):
+    if not result["built"]:
+        print(f"refbench failed to build:\n{result['stderr']}")
+        return
+    print(f"Reference driver, {result['bytes'] >> 20} MiB per run, {result['ring']} byte ring, "
+          f"{result['cpus']} CPUs")
+    modes = [mode for mode in MODES if any(mode in entry for entry in result["sizes"].values())]
+    print("  " + f"{'size':>7}" + "".join(f"  {mode + ' MB/s':>12} {'calls/msg':>9} {'x':>5}" for mode in modes))
+    for size, entry in sorted(result["sizes"].items(), key=lambda item: int(item[0])):
+        row = f"  {size:>7}"
+        for mode in modes:
+            stats = entry.get(mode, {})
+            row += (f"  {stats.get('mb_per_sec', 0):12.1f} {stats.get('calls_per_msg', 0):9.3f} "
+                    f"{stats.get('speedup', 0):5.2f}")
+        print(row)
+    if result["error"]:
+        print(f"refbench exited with {result['exit_status']}: {result['error']}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reference driver throughput per transfer mode")
+    parser.add_argument("--sizes", default=",".join(str(size) for size in DEFAULT_SIZES),
+                        help="Comma-separated message sizes in bytes")
+    parser.add_argument("--bytes", type=int, default=DEFAULT_BYTES, help="Bytes streamed per size and mode")
+    parser.add_argument("--ring", type=int, default=DEFAULT_RING, help="Ring size (buffer_size parameter)")
+    parser.add_argument("--modes", default=",".join(MODES), help=f"Comma-separated subset of {', '.join(MODES)}")
+    parser.add_argument("--json", help="Also write the result as JSON")
+    args = parser.parse_args()
+
+    result = run_ref_bench(tuple(int(size) for size in args.sizes.split(",")), args.bytes, args.ring,
+                           tuple(args.modes.split(",")))
+    print_report(result)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    return 0 if result["built"] and not result["error"] else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,383 @@
+/*
+ * Compares the ways of moving data through refchardev:
+ *
+ *   rw      read()/write(), one call per message
+ *   vec     readv()/writev(), BATCH messages per call
+ *   splice  write() in, splice into a pipe out: no copy to a user buffer
+ *   mmap    the shared ring from mmap(); userspace moves the indices itself
+ *           and enters the driver only to sleep or wake the peer
+ *
+ *   refbench [--sizes 64,4096] [--bytes N] [--ring BYTES] [--modes rw,vec,splice,mmap]
+ *
+ * Built like the harness: the driver through driver_wrapper.c, linked
+ * against kshim.c. One producer and one consumer thread stream --bytes
+ * bytes per message size and mode; each run prints one JSON line.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <time.h>
+
+#include "kshim.h"
+#include "refchardev.h"
+
+extern int kshim_module_init(void) __attribute__((weak));
+extern void kshim_module_exit(void) __attribute__((weak));
+
+#define MAX_SIZES 16
+/* Messages per readv/writev call */
+#define BATCH 16
+
+enum mode { MODE_RW, MODE_VEC, MODE_SPLICE, MODE_MMAP, MODES };
+static const char *const mode_names[MODES] = { "rw", "vec", "splice", "mmap" };
+
+static struct inode inode;
+static long long target_bytes;
+
+struct side {
+    pthread_t thread;
+    enum mode mode;
+    size_t size;
+    long long bytes;
+    long calls;         /* entries into the driver */
+    long messages;
+    long bad;           /* messages that arrived out of order */
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_file(struct file *file)
+{
+    memset(file, 0, sizeof(*file));
+    file->f_inode = &inode;
+    file->f_op = kshim.fops;
+    file->f_flags = O_RDWR;
+    file->f_mode = FMODE_READ | FMODE_WRITE;
+    return kshim.fops->open(&inode, file);
+}
+
+static long ioctl_call(struct file *file, unsigned int cmd, unsigned long arg, struct side *side)
+{
+    side->calls++;
+    return kshim.fops->unlocked_ioctl(file, cmd, arg);
+}
+
+/* Each message starts with its sequence number; the rest is filler */
+static void make_message(char *msg, size_t size, long seq)
+{
+    memcpy(msg, &seq, size < sizeof(seq) ? size : sizeof(seq));
+}
+
+static bool check_message(const char *msg, size_t size, long seq)
+{
+    return memcmp(msg, &seq, size < sizeof(seq) ? size : sizeof(seq)) == 0;
+}
+
+/*
+ * One read_iter/write_iter call over batch[done, total), split into
+ * segments at message boundaries, at most max_segs of them: with 1 this
+ * is a plain read()/write() of the rest of the current message.
+ */
+static ssize_t transfer(struct file *file, char *batch, size_t done, size_t total, size_t size, int max_segs,
+                        bool writing, struct side *side)
+{
+    struct iovec iov[BATCH];
+    struct iov_iter iter;
+    struct kiocb kiocb;
+    size_t off = done;
+    int nr = 0;
+    ssize_t ret;
+
+    while (off < total && nr < max_segs) {
+        size_t end = (off / size + 1) * size;
+
+        if (end > total)
+            end = total;
+        iov[nr++] = (struct iovec){ batch + off, end - off };
+        off = end;
+    }
+    iov_iter_init(&iter, writing ? ITER_SOURCE : ITER_DEST, iov, nr, off - done);
+    init_sync_kiocb(&kiocb, file);
+    kshim_set_user_range(batch, total);
+    ret = writing ? kshim.fops->write_iter(&kiocb, &iter) : kshim.fops->read_iter(&kiocb, &iter);
+    kshim_set_user_range(NULL, 0);
+    side->calls++;
+    return ret;
+}
+
+static struct ref_ring *map_ring(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned int size = 0;
+
+    kshim_set_user_range(&size, sizeof(size));
+    kshim.fops->unlocked_ioctl(file, REF_IOC_GET_SIZE, (unsigned long)&size);
+    kshim_set_user_range(NULL, 0);
+    memset(vma, 0, sizeof(*vma));
+    vma->vm_start = 0x40000000UL;
+    vma->vm_end = vma->vm_start + PAGE_SIZE + size;
+    vma->vm_flags = VM_READ | VM_WRITE | VM_SHARED | VM_MAYWRITE;
+    vma->vm_file = file;
+    if (kshim.fops->mmap(file, vma))
+        return NULL;
+    return vma->kshim_addr;
+}
+
+static void unmap_ring(struct vm_area_struct *vma)
+{
+    if (vma->vm_ops && vma->vm_ops->close)
+        vma->vm_ops->close(vma);
+}
+
+/* Copy between a linear buffer and a power-of-two ring at byte position pos */
+static void ring_copy(char *data, size_t ring_size, size_t pos, char *buf, size_t len, bool in)
+{
+    size_t off = pos & (ring_size - 1);
+    size_t first = len < ring_size - off ? len : ring_size - off;
+
+    if (in) {
+        memcpy(data + off, buf, first);
+        memcpy(data, buf + first, len - first);
+    } else {
+        memcpy(buf, data + off, first);
+        memcpy(buf + first, data, len - first);
+    }
+}
+
+/* Check the message at ring position pos in place, copying only if it wraps */
+static void consume(struct side *c, char *data, size_t ring_size, size_t pos, char *scratch)
+{
+    size_t off = pos & (ring_size - 1);
+    const char *msg = data + off;
+
+    if (off + c->size > ring_size) {
+        ring_copy(data, ring_size, pos, scratch, c->size, false);
+        msg = scratch;
+    }
+    if (!check_message(msg, c->size, c->messages))
+        c->bad++;
+    c->bytes += c->size;
+    c->messages++;
+}
+
+static void produce_mapped(struct side *p, struct file *file, struct ref_ring *ring, char *msg)
+{
+    char *data = (char *)ring + ring->data_offset;
+
+    while (p->bytes < target_bytes) {
+        unsigned int head = ring->head;
+
+        make_message(msg, p->size, p->messages);
+        while (ring->size - (head - smp_load_acquire(&ring->tail)) < p->size)
+            ioctl_call(file, REF_IOC_WAIT, EPOLLOUT, p);
+        ring_copy(data, ring->size, head, msg, p->size, true);
+        smp_store_release(&ring->head, head + p->size);
+        /* Pairs with the barrier in the driver's ref_wait() */
+        smp_mb();
+        if (READ_ONCE(ring->reader_waiting))
+            ioctl_call(file, REF_IOC_NOTIFY, 0, p);
+        p->bytes += p->size;
+        p->messages++;
+    }
+}
+
+static void *producer(void *arg)
+{
+    struct side *p = arg;
+    long total_messages = target_bytes / p->size;
+    char *batch = calloc(BATCH, p->size);
+    struct vm_area_struct vma;
+    struct ref_ring *ring;
+    struct file file;
+
+    if (open_file(&file))
+        goto out;
+    if (p->mode == MODE_MMAP) {
+        if ((ring = map_ring(&file, &vma))) {
+            produce_mapped(p, &file, ring, batch);
+            unmap_ring(&vma);
+        }
+        goto close;
+    }
+    while (p->messages < total_messages) {
+        long count = total_messages - p->messages < BATCH ? total_messages - p->messages : BATCH;
+        size_t total = count * p->size, done = 0;
+
+        for (long i = 0; i < count; i++)
+            make_message(batch + i * p->size, p->size, p->messages + i);
+        while (done < total) {
+            ssize_t ret = transfer(&file, batch, done, total, p->size, p->mode == MODE_VEC ? BATCH : 1, true, p);
+
+            if (ret <= 0)
+                goto close;
+            done += ret;
+        }
+        p->bytes += total;
+        p->messages += count;
+    }
+close:
+    kshim.fops->release(&inode, &file);
+out:
+    free(batch);
+    return NULL;
+}
+
+static void consume_mapped(struct side *c, struct file *file, struct ref_ring *ring, char *scratch)
+{
+    char *data = (char *)ring + ring->data_offset;
+
+    while (c->bytes < target_bytes) {
+        unsigned int tail = ring->tail;
+
+        while (smp_load_acquire(&ring->head) - tail < c->size)
+            ioctl_call(file, REF_IOC_WAIT, EPOLLIN, c);
+        consume(c, data, ring->size, tail, scratch);
+        smp_store_release(&ring->tail, tail + c->size);
+        smp_mb();
+        if (READ_ONCE(ring->writer_waiting))
+            ioctl_call(file, REF_IOC_NOTIFY, 0, c);
+    }
+}
+
+static void consume_spliced(struct side *c, struct file *file, char *scratch)
+{
+    struct pipe_inode_info pipe = { .size = PIPE_DEF_BUFFERS * PAGE_SIZE };
+
+    pipe.data = malloc(pipe.size);
+    while (c->bytes < target_bytes) {
+        ssize_t ret = kshim.fops->splice_read(file, NULL, &pipe, pipe.size - (pipe.head - pipe.tail), 0);
+
+        c->calls++;
+        if (ret <= 0)
+            break;
+        /* Messages are checked where they sit in the pipe's pages */
+        while (pipe.head - pipe.tail >= c->size && c->bytes < target_bytes) {
+            consume(c, pipe.data, pipe.size, pipe.tail, scratch);
+            pipe.tail += c->size;
+        }
+    }
+    free(pipe.data);
+}
+
+static void *consumer(void *arg)
+{
+    struct side *c = arg;
+    long total_messages = target_bytes / c->size;
+    char *batch = malloc(BATCH * c->size);
+    struct vm_area_struct vma;
+    struct ref_ring *ring;
+    struct file file;
+
+    if (open_file(&file))
+        goto out;
+    if (c->mode == MODE_MMAP) {
+        if ((ring = map_ring(&file, &vma))) {
+            consume_mapped(c, &file, ring, batch);
+            unmap_ring(&vma);
+        }
+        goto close;
+    }
+    if (c->mode == MODE_SPLICE) {
+        consume_spliced(c, &file, batch);
+        goto close;
+    }
+    while (c->messages < total_messages) {
+        long count = total_messages - c->messages < BATCH ? total_messages - c->messages : BATCH;
+        size_t total = count * c->size, done = 0;
+
+        while (done < total) {
+            ssize_t ret = transfer(&file, batch, done, total, c->size, c->mode == MODE_VEC ? BATCH : 1, false, c);
+
+            if (ret <= 0)
+                goto close;
+            done += ret;
+        }
+        for (long i = 0; i < count; i++)
+            if (!check_message(batch + i * c->size, c->size, c->messages + i))
+                c->bad++;
+        c->bytes += total;
+        c->messages += count;
+    }
+close:
+    kshim.fops->release(&inode, &file);
+out:
+    free(batch);
+    return NULL;
+}
+
+static void run(enum mode mode, size_t size)
+{
+    struct side p = { .mode = mode, .size = size }, c = { .mode = mode, .size = size };
+    double start, elapsed;
+
+    start = now();
+    pthread_create(&c.thread, NULL, consumer, &c);
+    pthread_create(&p.thread, NULL, producer, &p);
+    pthread_join(p.thread, NULL);
+    pthread_join(c.thread, NULL);
+    elapsed = now() - start;
+    printf("{\"mode\": \"%s\", \"size\": %zu, \"bytes\": %lld, \"seconds\": %.6f, \"mb_per_sec\": %.3f, "
+           "\"msgs_per_sec\": %.1f, \"calls\": %ld, \"calls_per_msg\": %.4f, \"bad\": %ld}\n",
+           mode_names[mode], size, c.bytes, elapsed, elapsed > 0 ? c.bytes / elapsed / 1e6 : 0.0,
+           elapsed > 0 ? c.messages / elapsed : 0.0, p.calls + c.calls,
+           c.messages ? (double)(p.calls + c.calls) / c.messages : 0.0, c.bad);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    long sizes[MAX_SIZES] = { 64, 4096 };
+    bool modes[MODES] = { true, true, true, true };
+    int nsizes = 2;
+    const char *ring = NULL;
+    long ring_size;
+
+    target_bytes = 256LL << 20;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sizes") == 0) {
+            char *p = argv[i + 1];
+            for (nsizes = 0; *p && nsizes < MAX_SIZES; p += *p == ',') {
+                sizes[nsizes++] = strtol(p, &p, 10);
+                if (*p && *p != ',')
+                    break;
+            }
+        } else if (strcmp(argv[i], "--bytes") == 0) {
+            target_bytes = strtoll(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "--ring") == 0) {
+            ring = argv[i + 1];
+        } else if (strcmp(argv[i], "--modes") == 0) {
+            for (int m = 0; m < MODES; m++)
+                modes[m] = strstr(argv[i + 1], mode_names[m]) != NULL;
+        }
+    }
+
+    if (ring && kshim_set_param("buffer_size", ring)) {
+        fprintf(stderr, "refbench: bad ring size %s\n", ring);
+        return 1;
+    }
+    if (!kshim_module_init || kshim_module_init() || !kshim.fops) {
+        fprintf(stderr, "refbench: driver did not load\n");
+        return 1;
+    }
+    /* A message that cannot fit in the ring would wait for space forever */
+    ring_size = kshim_param_value("buffer_size");
+    for (int i = 0; i < nsizes; i++) {
+        if (sizes[i] <= 0 || sizes[i] > ring_size) {
+            fprintf(stderr, "refbench: message size %ld outside 1..%ld (ring size)\n", sizes[i], ring_size);
+            kshim_module_exit();
+            return 1;
+        }
+    }
+    inode.i_rdev = kshim.dev;
+    inode.i_cdev = kshim.cdev;
+    for (int i = 0; i < nsizes; i++)
+        for (int m = 0; m < MODES; m++)
+            if (modes[m])
+                run(m, sizes[i]);
+    kshim_module_exit();
+    return 0;
+}
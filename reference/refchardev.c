@@ -0,0 +1,523 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * refchardev - reference FIFO character device used as the performance
+ * baseline when scoring generated drivers.
+ *
+ * Data lives in a power-of-two ring indexed by free-running head and tail
+ * counters, so wrap-around is a mask and full/empty never need a spare
+ * slot. Readers are serialized by read_lock and writers by write_lock,
+ * which makes the ring single-producer/single-consumer: the only state
+ * shared between the two sides is head (published by the writer) and tail
+ * (published by the reader), exchanged with acquire/release ordering.
+ *
+ * Reads block while the ring is empty and writes block while it is full,
+ * unless the file was opened O_NONBLOCK, in which case they return
+ * -EAGAIN. poll() reports readability and writability. The ring size is
+ * set at load time with buffer_size= and can be changed while the ring is
+ * empty with REF_IOC_RESIZE. Everything that touches the ring without
+ * read_lock or write_lock (poll, sleepers, the wait/notify ioctls) holds
+ * ring_sem for reading, and a resize only goes ahead if it can take
+ * ring_sem for writing without waiting.
+ *
+ * I/O goes through read_iter/write_iter only: plain read()/write() reach
+ * them through the VFS, readv()/writev() and io_uring move a whole batch
+ * of segments per call, and splice to or from a pipe uses the generic
+ * iterator-based helpers instead of a userspace bounce buffer.
+ *
+ * The indices live in a page that mmap() exposes together with the data
+ * (see refchardev.h), so userspace can produce and consume without copies
+ * or per-message syscalls. Because userspace can write the indices, every
+ * length derived from them is clamped to the ring size before use.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/splice.h>
+#include <linux/log2.h>
+#include <linux/version.h>
+
+#include "refchardev.h"
+
+#define DEVICE_NAME "refchardev"
+#define BUFFER_SIZE 65536
+#define REF_MIN_SIZE 4096
+#define REF_MAX_SIZE (16 << 20)
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+static inline void vm_flags_set(struct vm_area_struct *vma, vm_flags_t flags)
+{
+	vma->vm_flags |= flags;
+}
+#endif
+
+static unsigned int buffer_size = BUFFER_SIZE;
+module_param(buffer_size, uint, 0444);
+MODULE_PARM_DESC(buffer_size, "Ring size in bytes, rounded up to a power of two");
+
+struct ref_dev {
+	void *area;			/* index page followed by the data */
+	struct ref_ring *ring;
+	char *data;
+	unsigned int size;		/* power of two; ring->size is a copy */
+	struct mutex read_lock;
+	struct mutex write_lock;
+	struct rw_semaphore ring_sem;	/* keeps the ring from being swapped */
+	wait_queue_head_t readq;
+	wait_queue_head_t writeq;
+	atomic_t opens;
+	atomic_t mappings;
+	struct cdev cdev;
+	dev_t devt;
+	struct class *class;
+};
+
+/* Per-open state */
+struct ref_file {
+	struct ref_dev *dev;
+	u64 bytes_read;
+	u64 bytes_written;
+};
+
+static struct ref_dev ref;
+
+static unsigned int ref_used(struct ref_dev *dev)
+{
+	unsigned int used = smp_load_acquire(&dev->ring->head) - smp_load_acquire(&dev->ring->tail);
+
+	return min(used, READ_ONCE(dev->size));
+}
+
+static bool ref_readable(struct ref_dev *dev)
+{
+	return ref_used(dev) != 0;
+}
+
+static bool ref_writable(struct ref_dev *dev)
+{
+	return ref_used(dev) < READ_ONCE(dev->size);
+}
+
+static bool ref_ready(struct ref_dev *dev, __poll_t events)
+{
+	return events & EPOLLIN ? ref_readable(dev) : ref_writable(dev);
+}
+
+/*
+ * Sleep until the ring is readable (EPOLLIN) or writable (EPOLLOUT).
+ * The ring's *_waiting flag tells mmap users that a NOTIFY is needed. It
+ * is raised before the condition is rechecked, pairing with the barrier
+ * the other side issues between publishing an index and testing the flag.
+ * NOTIFY clears it, so a burst of messages costs one wakeup and a sleeper
+ * that finds the ring still unready raises it again. Called with ring_sem
+ * held for reading.
+ */
+static int __ref_wait(struct ref_dev *dev, __poll_t events)
+{
+	bool reader = events & EPOLLIN;
+	__u32 *flag = reader ? &dev->ring->reader_waiting : &dev->ring->writer_waiting;
+	wait_queue_head_t *q = reader ? &dev->readq : &dev->writeq;
+
+	for (;;) {
+		WRITE_ONCE(*flag, 1);
+		smp_mb();
+		if (ref_ready(dev, events))
+			return 0;
+		if (wait_event_interruptible(*q, ref_ready(dev, events) || !READ_ONCE(*flag)))
+			return -ERESTARTSYS;
+	}
+}
+
+static int ref_wait(struct ref_dev *dev, __poll_t events)
+{
+	int ret;
+
+	down_read(&dev->ring_sem);
+	ret = __ref_wait(dev, events);
+	up_read(&dev->ring_sem);
+	return ret;
+}
+
+static void ref_notify(struct ref_dev *dev)
+{
+	down_read(&dev->ring_sem);
+	WRITE_ONCE(dev->ring->reader_waiting, 0);
+	WRITE_ONCE(dev->ring->writer_waiting, 0);
+	up_read(&dev->ring_sem);
+	wake_up_interruptible(&dev->readq);
+	wake_up_interruptible(&dev->writeq);
+}
+
+static int ref_open(struct inode *inode, struct file *filp)
+{
+	struct ref_file *rf;
+
+	rf = kzalloc(sizeof(*rf), GFP_KERNEL);
+	if (!rf)
+		return -ENOMEM;
+	rf->dev = container_of(inode->i_cdev, struct ref_dev, cdev);
+	filp->private_data = rf;
+	/* A resize checks opens under read_lock */
+	mutex_lock(&rf->dev->read_lock);
+	atomic_inc(&rf->dev->opens);
+	mutex_unlock(&rf->dev->read_lock);
+	return stream_open(inode, filp);
+}
+
+static int ref_release(struct inode *inode, struct file *filp)
+{
+	struct ref_file *rf = filp->private_data;
+
+	atomic_dec(&rf->dev->opens);
+	kfree(rf);
+	return 0;
+}
+
+static bool ref_nowait(struct kiocb *iocb)
+{
+	return (iocb->ki_flags & IOCB_NOWAIT) || (iocb->ki_filp->f_flags & O_NONBLOCK);
+}
+
+/*
+ * read(), readv() and splice reads all land here. Every segment of the
+ * iterator is filled in one pass under read_lock, so a vectored read of a
+ * batch of messages costs one lock round trip and one wakeup.
+ */
+static ssize_t ref_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct ref_file *rf = iocb->ki_filp->private_data;
+	struct ref_dev *dev = rf->dev;
+	unsigned int head, tail, off, len, first;
+	size_t copied;
+
+	if (!iov_iter_count(to))
+		return 0;
+	if (mutex_lock_interruptible(&dev->read_lock))
+		return -ERESTARTSYS;
+	while (!ref_readable(dev)) {
+		mutex_unlock(&dev->read_lock);
+		if (ref_nowait(iocb))
+			return -EAGAIN;
+		if (ref_wait(dev, EPOLLIN))
+			return -ERESTARTSYS;
+		if (mutex_lock_interruptible(&dev->read_lock))
+			return -ERESTARTSYS;
+	}
+
+	/* Pairs with the writer's release of head: the data is visible */
+	head = smp_load_acquire(&dev->ring->head);
+	tail = READ_ONCE(dev->ring->tail);
+	len = min_t(size_t, iov_iter_count(to), min(head - tail, dev->size));
+	off = tail & (dev->size - 1);
+	first = min(len, dev->size - off);
+	copied = copy_to_iter(dev->data + off, first, to);
+	if (copied == first)
+		copied += copy_to_iter(dev->data, len - first, to);
+	if (!copied) {
+		mutex_unlock(&dev->read_lock);
+		return -EFAULT;
+	}
+	/* The copy must finish before the writer may reuse the space */
+	smp_store_release(&dev->ring->tail, tail + copied);
+	mutex_unlock(&dev->read_lock);
+
+	rf->bytes_read += copied;
+	wake_up_interruptible(&dev->writeq);
+	return copied;
+}
+
+static ssize_t ref_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct ref_file *rf = iocb->ki_filp->private_data;
+	struct ref_dev *dev = rf->dev;
+	unsigned int head, tail, off, len, first;
+	size_t copied;
+
+	if (!iov_iter_count(from))
+		return 0;
+	if (mutex_lock_interruptible(&dev->write_lock))
+		return -ERESTARTSYS;
+	while (!ref_writable(dev)) {
+		mutex_unlock(&dev->write_lock);
+		if (ref_nowait(iocb))
+			return -EAGAIN;
+		if (ref_wait(dev, EPOLLOUT))
+			return -ERESTARTSYS;
+		if (mutex_lock_interruptible(&dev->write_lock))
+			return -ERESTARTSYS;
+	}
+
+	/* Pairs with the reader's release of tail: the space is free */
+	tail = smp_load_acquire(&dev->ring->tail);
+	head = READ_ONCE(dev->ring->head);
+	len = min_t(size_t, iov_iter_count(from), dev->size - min(head - tail, dev->size));
+	off = head & (dev->size - 1);
+	first = min(len, dev->size - off);
+	copied = copy_from_iter(dev->data + off, first, from);
+	if (copied == first)
+		copied += copy_from_iter(dev->data, len - first, from);
+	if (!copied) {
+		mutex_unlock(&dev->write_lock);
+		return -EFAULT;
+	}
+	smp_store_release(&dev->ring->head, head + copied);
+	mutex_unlock(&dev->write_lock);
+
+	rf->bytes_written += copied;
+	wake_up_interruptible(&dev->readq);
+	return copied;
+}
+
+static __poll_t ref_poll(struct file *filp, poll_table *wait)
+{
+	struct ref_file *rf = filp->private_data;
+	struct ref_dev *dev = rf->dev;
+	__poll_t mask = 0;
+
+	poll_wait(filp, &dev->readq, wait);
+	poll_wait(filp, &dev->writeq, wait);
+	down_read(&dev->ring_sem);
+	if (ref_readable(dev))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (ref_writable(dev))
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	up_read(&dev->ring_sem);
+	return mask;
+}
+
+static void *ref_alloc(unsigned int size)
+{
+	struct ref_ring *ring = vmalloc_user(PAGE_SIZE + size);
+
+	if (ring) {
+		ring->size = size;
+		ring->data_offset = PAGE_SIZE;
+	}
+	return ring;
+}
+
+static void ref_install(struct ref_dev *dev, void *area, unsigned int size)
+{
+	dev->area = area;
+	dev->ring = area;
+	dev->data = (char *)area + PAGE_SIZE;
+	WRITE_ONCE(dev->size, size);
+}
+
+/*
+ * Swap in a ring of a new size. Only the caller may have the device open,
+ * nothing may be mapped and nobody may hold ring_sem, so no reader, writer,
+ * poller or sleeper (including other threads sharing the caller's file)
+ * can still be looking at the old ring.
+ */
+static int ref_resize(struct ref_dev *dev, unsigned int size)
+{
+	void *area;
+	int ret = 0;
+
+	if (size < REF_MIN_SIZE || size > REF_MAX_SIZE)
+		return -EINVAL;
+	size = roundup_pow_of_two(size);
+	area = ref_alloc(size);
+	if (!area)
+		return -ENOMEM;
+
+	if (!down_write_trylock(&dev->ring_sem)) {
+		vfree(area);
+		return -EBUSY;
+	}
+	mutex_lock(&dev->read_lock);
+	mutex_lock(&dev->write_lock);
+	if (ref_used(dev) || atomic_read(&dev->opens) > 1 || atomic_read(&dev->mappings)) {
+		ret = -EBUSY;
+	} else {
+		swap(dev->area, area);
+		ref_install(dev, dev->area, size);
+	}
+	mutex_unlock(&dev->write_lock);
+	mutex_unlock(&dev->read_lock);
+	up_write(&dev->ring_sem);
+
+	vfree(area);
+	return ret;
+}
+
+static void ref_vma_open(struct vm_area_struct *vma)
+{
+	struct ref_dev *dev = vma->vm_private_data;
+
+	atomic_inc(&dev->mappings);
+}
+
+static void ref_vma_close(struct vm_area_struct *vma)
+{
+	struct ref_dev *dev = vma->vm_private_data;
+
+	atomic_dec(&dev->mappings);
+}
+
+static const struct vm_operations_struct ref_vm_ops = {
+	.open = ref_vma_open,
+	.close = ref_vma_close,
+};
+
+static int ref_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ref_file *rf = filp->private_data;
+	struct ref_dev *dev = rf->dev;
+	unsigned long len = vma->vm_end - vma->vm_start;
+	int ret;
+
+	if (vma->vm_pgoff || !(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+	/* Both locks keep a resize from swapping the area under us */
+	mutex_lock(&dev->read_lock);
+	mutex_lock(&dev->write_lock);
+	if (len > PAGE_SIZE + dev->size) {
+		ret = -EINVAL;
+	} else {
+		ret = remap_vmalloc_range(vma, dev->area, 0);
+		if (!ret) {
+			vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+			vma->vm_private_data = dev;
+			vma->vm_ops = &ref_vm_ops;
+			ref_vma_open(vma);
+		}
+	}
+	mutex_unlock(&dev->write_lock);
+	mutex_unlock(&dev->read_lock);
+	return ret;
+}
+
+static long ref_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct ref_file *rf = filp->private_data;
+	unsigned int size;
+	long ret;
+
+	switch (cmd) {
+	case REF_IOC_GET_SIZE:
+		size = READ_ONCE(rf->dev->size);
+		return put_user(size, (unsigned int __user *)arg);
+	case REF_IOC_RESIZE:
+		return ref_resize(rf->dev, (unsigned int)arg);
+	case REF_IOC_WAIT:
+		if (arg != EPOLLIN && arg != EPOLLOUT)
+			return -EINVAL;
+		down_read(&rf->dev->ring_sem);
+		if (ref_ready(rf->dev, arg))
+			ret = 0;
+		else if (filp->f_flags & O_NONBLOCK)
+			ret = -EAGAIN;
+		else
+			ret = __ref_wait(rf->dev, arg) ? -ERESTARTSYS : 0;
+		up_read(&rf->dev->ring_sem);
+		return ret;
+	case REF_IOC_NOTIFY:
+		ref_notify(rf->dev);
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations ref_fops = {
+	.owner = THIS_MODULE,
+	.open = ref_open,
+	.release = ref_release,
+	.read_iter = ref_read_iter,
+	.write_iter = ref_write_iter,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+	.splice_read = copy_splice_read,
+#else
+	.splice_read = generic_file_splice_read,
+#endif
+	.splice_write = iter_file_splice_write,
+	.poll = ref_poll,
+	.unlocked_ioctl = ref_ioctl,
+	.mmap = ref_mmap,
+};
+
+static int __init ref_init(void)
+{
+	struct device *device;
+	void *area;
+	int ret;
+
+	if (buffer_size < REF_MIN_SIZE || buffer_size > REF_MAX_SIZE)
+		return -EINVAL;
+	buffer_size = roundup_pow_of_two(buffer_size);
+	area = ref_alloc(buffer_size);
+	if (!area)
+		return -ENOMEM;
+	ref_install(&ref, area, buffer_size);
+	mutex_init(&ref.read_lock);
+	mutex_init(&ref.write_lock);
+	init_rwsem(&ref.ring_sem);
+	init_waitqueue_head(&ref.readq);
+	init_waitqueue_head(&ref.writeq);
+	atomic_set(&ref.opens, 0);
+	atomic_set(&ref.mappings, 0);
+
+	ret = alloc_chrdev_region(&ref.devt, 0, 1, DEVICE_NAME);
+	if (ret)
+		goto free_data;
+	cdev_init(&ref.cdev, &ref_fops);
+	ref.cdev.owner = THIS_MODULE;
+	ret = cdev_add(&ref.cdev, ref.devt, 1);
+	if (ret)
+		goto unregister;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+	ref.class = class_create(DEVICE_NAME);
+#else
+	ref.class = class_create(THIS_MODULE, DEVICE_NAME);
+#endif
+	if (IS_ERR(ref.class)) {
+		ret = PTR_ERR(ref.class);
+		goto del_cdev;
+	}
+	device = device_create(ref.class, NULL, ref.devt, NULL, DEVICE_NAME);
+	if (IS_ERR(device)) {
+		ret = PTR_ERR(device);
+		goto destroy_class;
+	}
+
+	pr_info("%s: %u byte ring, major %d\n", DEVICE_NAME, ref.size, MAJOR(ref.devt));
+	return 0;
+
+destroy_class:
+	class_destroy(ref.class);
+del_cdev:
+	cdev_del(&ref.cdev);
+unregister:
+	unregister_chrdev_region(ref.devt, 1);
+free_data:
+	vfree(ref.area);
+	return ret;
+}
+
+static void __exit ref_exit(void)
+{
+	device_destroy(ref.class, ref.devt);
+	class_destroy(ref.class);
+	cdev_del(&ref.cdev);
+	unregister_chrdev_region(ref.devt, 1);
+	vfree(ref.area);
+}
+
+module_init(ref_init);
+module_exit(ref_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Reference ring-buffer character device");
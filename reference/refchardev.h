@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * Userspace interface of refchardev.
+ *
+ * mmap() at offset 0 maps the ring: one page holding struct ref_ring,
+ * followed by ring.size bytes of data. Byte i of the stream lives at
+ * data[i & (size - 1)]. A producer fills data[head...] and then
+ * publishes head with a release store; a consumer reads head with an
+ * acquire load, copies out data[tail...head) and publishes tail.
+ *
+ * Nothing else needs a syscall. A side that finds the ring empty or full
+ * sleeps with REF_IOC_WAIT, and after publishing, a side calls
+ * REF_IOC_NOTIFY only when the other side's *_waiting flag is set (issue a
+ * full barrier between the publish and the flag test). read() and write()
+ * stay usable alongside the mapping and follow the same protocol.
+ */
+#ifndef _UAPI_REFCHARDEV_H
+#define _UAPI_REFCHARDEV_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+struct ref_ring {
+	/* Bytes ever written; advanced by the producer */
+	__u32 head __attribute__((aligned(64)));
+	/* Bytes ever read; advanced by the consumer */
+	__u32 tail __attribute__((aligned(64)));
+	/* Ring size in bytes (a power of two) and data offset in the mapping */
+	__u32 size __attribute__((aligned(64)));
+	__u32 data_offset;
+	/* Raised by a reader or writer going to sleep; NOTIFY clears them */
+	__u32 reader_waiting;
+	__u32 writer_waiting;
+};
+
+#define REF_IOC_MAGIC 'r'
+#define REF_IOC_GET_SIZE _IOR(REF_IOC_MAGIC, 1, unsigned int)
+/* Only while the ring is empty, unmapped and open by the caller alone */
+#define REF_IOC_RESIZE _IOW(REF_IOC_MAGIC, 2, unsigned int)
+/* Sleep until POLLIN (readable) or POLLOUT (writable) per the argument;
+ * raises the matching *_waiting flag while asleep */
+#define REF_IOC_WAIT _IOW(REF_IOC_MAGIC, 3, unsigned int)
+/* Wake sleepers after publishing head or tail through the mapping; clears
+ * both *_waiting flags */
+#define REF_IOC_NOTIFY _IO(REF_IOC_MAGIC, 4)
+
+#endif /* _UAPI_REFCHARDEV_H */
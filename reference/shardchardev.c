@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * shardchardev - the sample driver (test_samples/generated_driver.c)
+ * sharded for concurrent clients, as a reference for the multi-minor and
+ * per-CPU support in the harness.
+ *
+ * nr_minors minors each own a cache-line-aligned buffer and lock. With
+ * per_cpu_shards=1 every minor gets one buffer per CPU, picked at open
+ * time. Read/write statistics are per-CPU counters, summed only when a
+ * minor's sysfs stats attribute is read, and the fops hot paths do not
+ * printk.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>  // For copy_to_user and copy_from_user
+
+#define DEVICE_NAME "mychardev"
+#define CLASS_NAME "mychardev"
+#define BUFFER_SIZE 1024
+#define MAX_MINORS 64
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Your Name");
+MODULE_DESCRIPTION("Simple character device driver");
+
+static unsigned int nr_minors = 4;
+module_param(nr_minors, uint, 0444);
+MODULE_PARM_DESC(nr_minors, "Number of device minors, each with its own buffer (1-64)");
+
+static bool per_cpu_shards;
+module_param(per_cpu_shards, bool, 0444);
+MODULE_PARM_DESC(per_cpu_shards, "Give every minor one buffer per CPU, picked at open time");
+
+// Statistics, kept per CPU so the hot path never writes a shared counter
+struct my_stats {
+    u64 reads;
+    u64 writes;
+    u64 bytes_read;
+    u64 bytes_written;
+};
+
+// One buffer; instances never share a cache line
+struct my_dev {
+    struct mutex lock;
+    char kbuffer[BUFFER_SIZE];  // Kernel buffer
+    int buffer_ptr;             // Tracks the amount of data written
+} ____cacheline_aligned;
+
+// Per-minor state: its buffers (one, or one per CPU when sharded) and stats
+struct my_minor {
+    struct my_dev *shards;
+    unsigned int nr_shards;
+    struct my_stats __percpu *stats;
+    struct device *device;
+};
+
+static int major_number;
+static struct cdev my_cdev;
+static struct class *my_class;
+static struct my_minor *minors;
+
+// Function prototypes
+static int my_open(struct inode *inode, struct file *file);
+static int my_release(struct inode *inode, struct file *file);
+static ssize_t my_read(struct file *file, char __user *buf, size_t count, loff_t *ppos);
+static ssize_t my_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos);
+
+// File operations structure
+static struct file_operations fops = {
+    .owner   = THIS_MODULE,
+    .open    = my_open,
+    .release = my_release,
+    .read    = my_read,
+    .write   = my_write,
+};
+
+// sysfs: /sys/class/mychardev/mychardevN/stats sums the per-CPU counters
+static ssize_t stats_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    struct my_minor *m = dev_get_drvdata(dev);
+    struct my_stats total = { 0 };
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        struct my_stats *s = per_cpu_ptr(m->stats, cpu);
+
+        total.reads += READ_ONCE(s->reads);
+        total.writes += READ_ONCE(s->writes);
+        total.bytes_read += READ_ONCE(s->bytes_read);
+        total.bytes_written += READ_ONCE(s->bytes_written);
+    }
+    return sysfs_emit(buf, "reads %llu\nwrites %llu\nbytes_read %llu\nbytes_written %llu\n",
+                      (unsigned long long)total.reads, (unsigned long long)total.writes,
+                      (unsigned long long)total.bytes_read, (unsigned long long)total.bytes_written);
+}
+static DEVICE_ATTR_RO(stats);
+
+// Open function: pick the instance by minor, and by CPU when sharded
+static int my_open(struct inode *inode, struct file *file) {
+    unsigned int minor = iminor(inode);
+    struct my_minor *m;
+
+    if (minor >= nr_minors) {
+        return -ENODEV;
+    }
+    m = &minors[minor];
+    file->private_data = &m->shards[raw_smp_processor_id() % m->nr_shards];
+    return 0;
+}
+
+// Release function
+static int my_release(struct inode *inode, struct file *file) {
+    return 0;
+}
+
+// Read function
+static ssize_t my_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+    struct my_dev *dev = file->private_data;
+    struct my_minor *m = &minors[iminor(file_inode(file))];
+    int bytes_to_read;
+
+    mutex_lock(&dev->lock);
+
+    if (*ppos >= dev->buffer_ptr) {
+        mutex_unlock(&dev->lock);
+        return 0; // End of file
+    }
+
+    bytes_to_read = min((int)count, dev->buffer_ptr - (int)*ppos); // How many bytes to actually read
+
+    if (copy_to_user(buf, dev->kbuffer + *ppos, bytes_to_read)) {
+        mutex_unlock(&dev->lock);
+        return -EFAULT; // Failed to copy to user space
+    }
+
+    mutex_unlock(&dev->lock);
+
+    *ppos += bytes_to_read;
+    this_cpu_inc(m->stats->reads);
+    this_cpu_add(m->stats->bytes_read, bytes_to_read);
+
+    return bytes_to_read;
+}
+
+// Write function
+static ssize_t my_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+    struct my_dev *dev = file->private_data;
+    struct my_minor *m = &minors[iminor(file_inode(file))];
+    int bytes_to_write;
+
+    mutex_lock(&dev->lock);
+
+    bytes_to_write = min((int)count, BUFFER_SIZE - dev->buffer_ptr);  //How many bytes to write
+
+    if (copy_from_user(dev->kbuffer + dev->buffer_ptr, buf, bytes_to_write)) {
+        mutex_unlock(&dev->lock);
+        return -EFAULT; // Failed to copy from user space
+    }
+
+    dev->buffer_ptr += bytes_to_write;
+
+    mutex_unlock(&dev->lock);
+
+    this_cpu_inc(m->stats->writes);
+    this_cpu_add(m->stats->bytes_written, bytes_to_write);
+
+    return bytes_to_write;
+}
+
+// Free the per-minor state of minors [0, count)
+static void my_free_minors(unsigned int count) {
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        free_percpu(minors[i].stats);
+        kfree(minors[i].shards);
+    }
+    kfree(minors);
+}
+
+// Remove the devices of minors [0, count)
+static void my_destroy_devices(unsigned int count) {
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        device_remove_file(minors[i].device, &dev_attr_stats);
+        device_destroy(my_class, MKDEV(major_number, i));
+    }
+}
+
+// Module initialization function
+static int __init my_init(void) {
+    int ret;
+    unsigned int i, j;
+    dev_t dev_num;
+
+    if (nr_minors < 1 || nr_minors > MAX_MINORS) {
+        printk(KERN_ALERT "%s: nr_minors must be between 1 and %d\n", DEVICE_NAME, MAX_MINORS);
+        return -EINVAL;
+    }
+
+    // Per-minor state, one buffer per CPU in sharded mode
+    minors = kcalloc(nr_minors, sizeof(*minors), GFP_KERNEL);
+    if (!minors) {
+        return -ENOMEM;
+    }
+    for (i = 0; i < nr_minors; i++) {
+        struct my_minor *m = &minors[i];
+
+        m->nr_shards = per_cpu_shards ? nr_cpu_ids : 1;
+        m->shards = kcalloc(m->nr_shards, sizeof(*m->shards), GFP_KERNEL);
+        m->stats = alloc_percpu(struct my_stats);
+        if (!m->shards || !m->stats) {
+            my_free_minors(i + 1);
+            return -ENOMEM;
+        }
+        for (j = 0; j < m->nr_shards; j++) {
+            mutex_init(&m->shards[j].lock);
+        }
+    }
+
+    // Allocate a major number dynamically
+    ret = alloc_chrdev_region(&dev_num, 0, nr_minors, DEVICE_NAME);
+    if (ret < 0) {
+        printk(KERN_ALERT "%s: Failed to allocate major number\n", DEVICE_NAME);
+        my_free_minors(nr_minors);
+        return ret;
+    }
+    major_number = MAJOR(dev_num);
+    printk(KERN_INFO "%s: Registered with major number %d\n", DEVICE_NAME, major_number);
+
+    // Initialize the cdev structure
+    cdev_init(&my_cdev, &fops);
+    my_cdev.owner = THIS_MODULE;
+    my_cdev.ops = &fops;
+
+    // Add the character device to the system, one cdev for every minor
+    ret = cdev_add(&my_cdev, dev_num, nr_minors);
+    if (ret < 0) {
+        printk(KERN_ALERT "%s: Failed to add cdev\n", DEVICE_NAME);
+        goto err_region;
+    }
+
+    my_class = class_create(CLASS_NAME);
+    if (IS_ERR(my_class)) {
+        printk(KERN_ALERT "%s: Failed to create class\n", DEVICE_NAME);
+        ret = PTR_ERR(my_class);
+        goto err_cdev;
+    }
+
+    // One device node and stats attribute per minor
+    for (i = 0; i < nr_minors; i++) {
+        minors[i].device = device_create(my_class, NULL, MKDEV(major_number, i), &minors[i],
+                                         DEVICE_NAME "%u", i);
+        if (IS_ERR(minors[i].device)) {
+            ret = PTR_ERR(minors[i].device);
+            goto err_devices;
+        }
+        ret = device_create_file(minors[i].device, &dev_attr_stats);
+        if (ret < 0) {
+            device_destroy(my_class, MKDEV(major_number, i));
+            goto err_devices;
+        }
+    }
+
+    printk(KERN_INFO "%s: Device driver loaded with %u minors%s\n", DEVICE_NAME, nr_minors,
+           per_cpu_shards ? ", sharded per CPU" : "");
+    return 0;
+
+err_devices:
+    printk(KERN_ALERT "%s: Failed to create device %u\n", DEVICE_NAME, i);
+    my_destroy_devices(i);
+    class_destroy(my_class);
+err_cdev:
+    cdev_del(&my_cdev);
+err_region:
+    unregister_chrdev_region(dev_num, nr_minors);
+    my_free_minors(nr_minors);
+    return ret;
+}
+
+// Module exit function
+static void __exit my_exit(void) {
+    dev_t dev_num = MKDEV(major_number, 0);
+
+    my_destroy_devices(nr_minors);
+    class_destroy(my_class);
+
+    // Remove the character device from the system
+    cdev_del(&my_cdev);
+
+    // Free the major number
+    unregister_chrdev_region(dev_num, nr_minors);
+
+    my_free_minors(nr_minors);
+
+    printk(KERN_INFO "%s: Device driver unloaded\n", DEVICE_NAME);
+}
+
+module_init(my_init);
+module_exit(my_exit);
@@ -0,0 +1,133 @@
+import hashlib
+import json
+import os
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+
+from metrics import METRICS
+
+CACHE_DIR = ".eval_cache"
+
+# Stands in for the source path inside cached results, so a hit for the
+# same bytes at a different path reports the caller's path
+SOURCE_PLACEHOLDER = "@@SOURCE@@"
+
+
+def _file_digest(path: str) -> str:
+    h = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            h.update(chunk)
+    return h.hexdigest()
+
+
+def _substitute(value, old: str, new: str):
+    if isinstance(value, str):
+        return value.replace(old, new)
+    if isinstance(value, dict):
+        return {k: _substitute(v, old, new) for k, v in value.items()}
+    if isinstance(value, list):
+        return [_substitute(v, old, new) for v in value]
+    return value
+
+
+class ResultCache:
+    # On-disk cache of parsed tool results keyed by
+    # sha256(source bytes, tool identity, normalized argv).
+
+    def __init__(self, root: str = CACHE_DIR):
+        self.root = root
+        self.hits = 0
+        self.misses = 0
+        self._lock = threading.Lock()
+        self._identities = {}
+        os.makedirs(root, exist_ok=True)
+
+    def tool_identity(self, tool: str):
+        path = shutil.which(tool)
+        if path is None:
+            return None
+        path = os.path.realpath(path)
+        st = os.stat(path)
+        memo_key = (path, st.st_size, st.st_mtime_ns)
+        with self._lock:
+            if memo_key in self._identities:
+                return self._identities[memo_key]
+        try:
+            result = subprocess.run([path, "--version"], capture_output=True, text=True, timeout=10)
+            version = (result.stdout or result.stderr).strip().splitlines()[:1]
+        except (OSError, subprocess.SubprocessError):
+            version = []
+        identity = f"{path}:{st.st_size}:{st.st_mtime_ns}:{''.join(version)}"
+        with self._lock:
+            self._identities[memo_key] = identity
+        return identity
+
+    def key(self, source_path: str, argv: list):
+        identity = self.tool_identity(argv[0])
+        if identity is None:
+            # Nothing worth caching; let the spawn report the missing tool
+            return None
+        h = hashlib.sha256()
+        h.update(_file_digest(source_path).encode())
+        h.update(b"\0" + identity.encode())
+        for arg in argv[1:]:
+            if arg == source_path:
+                arg = SOURCE_PLACEHOLDER
+            elif os.path.isfile(arg):
+                # Scripts and configs passed on the command line (checkpatch.pl)
+                arg = f"file:{_file_digest(arg)}"
+            h.update(b"\0" + arg.encode())
+        return h.hexdigest()
+
+    def _path(self, key: str) -> str:
+        return os.path.join(self.root, key[:2], key + ".json")
+
+    def get(self, key: str, source_path: str):
+        try:
+            with open(self._path(key)) as f:
+                value = json.load(f)
+        except (OSError, ValueError):
+            with self._lock:
+                self.misses += 1
+            return None
+        with self._lock:
+            self.hits += 1
+        return _substitute(value, SOURCE_PLACEHOLDER, source_path)
+
+    def put(self, key: str, source_path: str, value):
+        path = self._path(key)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        # Write to a private temp file and rename: concurrent writers of the
+        # same key each publish a complete file and the last rename wins
+        fd, tmp = tempfile.mkstemp(dir=os.path.dirname(path), suffix=".tmp")
+        try:
+            with os.fdopen(fd, "w") as f:
+                json.dump(_substitute(value, source_path, SOURCE_PLACEHOLDER), f)
+            os.replace(tmp, path)
+        except BaseException:
+            os.unlink(tmp)
+            raise
+
+    def stats(self) -> dict:
+        with self._lock:
+            return {"hits": self.hits, "misses": self.misses}
+
+
+def cached_tool(cache, source_path: str, argv: list, run):
+    # run() spawns the tool and returns its parsed result
+    if cache is None:
+        return run()
+    started = time.monotonic()
+    key = cache.key(source_path, argv)
+    if key is None:
+        return run()
+    value = cache.get(key, source_path)
+    METRICS.record_cache(value is not None, time.monotonic() - started)
+    if value is None:
+        value = run()
+        cache.put(key, source_path, value)
+    return value
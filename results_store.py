@@ -0,0 +1,499 @@
+import argparse
+import hashlib
+import json
+import os
+import re
+import sqlite3
+import sys
+import threading
+import time
+import zlib
+
+from compile_check import ARCHITECTURES
+from result_cache import SOURCE_PLACEHOLDER, _file_digest
+from scoring import STAGE_POINTS, is_skipped, stage_points
+
+STORE_PATH = "results.db"
+SCHEMA_VERSION = 1
+
+# Stored raw output is referenced as "sha256:<hex>" in compacted records
+BLOB_PREFIX = "sha256:"
+# Keys whose string values are raw tool output
+RAW_KEYS = ("raw_output", "stdout", "stderr")
+# Category whose data is itself the raw cppcheck output
+RAW_CATEGORIES = ("static_analysis",)
+
+SCHEMA = """
+CREATE TABLE IF NOT EXISTS runs (
+    id INTEGER PRIMARY KEY,
+    started REAL NOT NULL,
+    label TEXT
+);
+CREATE TABLE IF NOT EXISTS evaluations (
+    id INTEGER PRIMARY KEY,
+    run_id INTEGER NOT NULL REFERENCES runs(id),
+    job_id TEXT NOT NULL,
+    model TEXT NOT NULL,
+    source TEXT,
+    source_digest TEXT,
+    created REAL NOT NULL,
+    wall_seconds REAL,
+    seconds_saved REAL,
+    overall_score INTEGER,
+    error TEXT
+);
+CREATE INDEX IF NOT EXISTS evaluations_score ON evaluations(overall_score DESC);
+CREATE INDEX IF NOT EXISTS evaluations_model_score ON evaluations(model, overall_score DESC);
+CREATE INDEX IF NOT EXISTS evaluations_job ON evaluations(job_id, created);
+CREATE INDEX IF NOT EXISTS evaluations_digest ON evaluations(source_digest);
+CREATE TABLE IF NOT EXISTS category_points (
+    evaluation_id INTEGER NOT NULL,
+    category TEXT NOT NULL,
+    points INTEGER NOT NULL,
+    PRIMARY KEY (evaluation_id, category)
+) WITHOUT ROWID;
+-- One row per stage: compile_<arch>, static, checkpatch, sparse
+CREATE TABLE IF NOT EXISTS tool_results (
+    evaluation_id INTEGER NOT NULL,
+    tool TEXT NOT NULL,
+    status TEXT NOT NULL,
+    warnings INTEGER,
+    errors INTEGER,
+    output TEXT REFERENCES blobs(digest),
+    detail TEXT,
+    PRIMARY KEY (evaluation_id, tool)
+) WITHOUT ROWID;
+-- zlib-compressed raw output, the driver's path replaced by a placeholder
+-- so identical output from different scratch dirs is stored once
+CREATE TABLE IF NOT EXISTS blobs (
+    digest TEXT PRIMARY KEY,
+    size INTEGER NOT NULL,
+    data BLOB NOT NULL
+) WITHOUT ROWID;
+CREATE TABLE IF NOT EXISTS diagnostics (
+    id INTEGER PRIMARY KEY,
+    tool TEXT NOT NULL,
+    severity TEXT NOT NULL,
+    message TEXT NOT NULL,
+    UNIQUE (tool, severity, message)
+);
+CREATE TABLE IF NOT EXISTS evaluation_diagnostics (
+    evaluation_id INTEGER NOT NULL,
+    diagnostic_id INTEGER NOT NULL,
+    count INTEGER NOT NULL,
+    PRIMARY KEY (evaluation_id, diagnostic_id)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS evaluation_diagnostics_diagnostic ON evaluation_diagnostics(diagnostic_id);
+
+-- Aggregates, updated in the same transaction as each evaluation
+CREATE TABLE IF NOT EXISTS model_stats (
+    model TEXT PRIMARY KEY,
+    evaluations INTEGER NOT NULL,
+    errors INTEGER NOT NULL,
+    scored INTEGER NOT NULL,
+    score_sum INTEGER NOT NULL,
+    score_sq_sum INTEGER NOT NULL,
+    best INTEGER,
+    last_seen REAL NOT NULL
+);
+CREATE TABLE IF NOT EXISTS score_histogram (
+    model TEXT NOT NULL,
+    score INTEGER NOT NULL,
+    count INTEGER NOT NULL,
+    PRIMARY KEY (model, score)
+) WITHOUT ROWID;
+CREATE TABLE IF NOT EXISTS run_stats (
+    run_id INTEGER NOT NULL,
+    model TEXT NOT NULL,
+    scored INTEGER NOT NULL,
+    score_sum INTEGER NOT NULL,
+    PRIMARY KEY (run_id, model)
+) WITHOUT ROWID;
+CREATE TABLE IF NOT EXISTS diagnostic_stats (
+    diagnostic_id INTEGER PRIMARY KEY,
+    occurrences INTEGER NOT NULL,
+    evaluations INTEGER NOT NULL
+);
+CREATE TABLE IF NOT EXISTS compile_stats (
+    model TEXT NOT NULL,
+    arch TEXT NOT NULL,
+    attempts INTEGER NOT NULL,
+    passes INTEGER NOT NULL,
+    PRIMARY KEY (model, arch)
+) WITHOUT ROWID;
+"""
+
+# gcc, sparse and newer cppcheck: "path:line[:col]: severity: message"
+LOCATED_LINE = re.compile(
+    r":\d+(?::\d+)?:\s*(?:fatal )?(error|warning|style|performance|portability|information):\s*(.*)")
+# Older cppcheck: "[path:line]: (severity) message"
+CPPCHECK_LINE = re.compile(r"^\[[^\]]*\]:\s*\((\w+)\)\s*(.*)")
+CHECKPATCH_LINE = re.compile(r"^(ERROR|WARNING|CHECK):\s*(.*)")
+# Identifiers and numbers vary between drivers; the diagnostic does not
+QUOTED = re.compile(r"'[^']*'|‘[^’]*’|\"[^\"]*\"")
+NUMBER = re.compile(r"\b\d+\b")
+MAX_MESSAGE = 200
+
+
+def normalize_message(message: str) -> str:
+    message = NUMBER.sub("N", QUOTED.sub("'*'", message.strip()))
+    return message[:MAX_MESSAGE]
+
+
+def parse_diagnostics(tool: str, output: str) -> dict:
+    # {(severity, normalized message): count}
+    counts = {}
+    for line in output.splitlines():
+        if tool == "checkpatch":
+            match = CHECKPATCH_LINE.match(line)
+        else:
+            match = LOCATED_LINE.search(line) or CPPCHECK_LINE.match(line)
+        if match is None:
+            continue
+        key = (match.group(1).lower(), normalize_message(match.group(2)))
+        counts[key] = counts.get(key, 0) + 1
+    return counts
+
+
+def _portable(text: str, source_path: str) -> str:
+    return text.replace(source_path, SOURCE_PLACEHOLDER) if source_path else text
+
+
+def blob_ref(text: str, source_path: str = None) -> str:
+    data = _portable(text, source_path).encode()
+    return BLOB_PREFIX + hashlib.sha256(data).hexdigest()
+
+
+def _is_raw(value, key: str) -> bool:
+    return isinstance(value, str) and bool(value) and (key in RAW_KEYS or key in RAW_CATEGORIES)
+
+
+def raw_outputs(value, key: str = None):
+    # Every string compact() replaces; the store keeps a blob for each
+    if isinstance(value, dict):
+        for k, v in value.items():
+            yield from raw_outputs(v, k)
+    elif isinstance(value, list):
+        for v in value:
+            yield from raw_outputs(v)
+    elif _is_raw(value, key):
+        yield value
+
+
+def compact(value, source_path: str = None, key: str = None):
+    # A copy of a result with every raw output replaced by its blob reference
+    if isinstance(value, dict):
+        return {k: compact(v, source_path, k) for k, v in value.items()}
+    if isinstance(value, list):
+        return [compact(v, source_path) for v in value]
+    if _is_raw(value, key):
+        return blob_ref(value, source_path)
+    return value
+
+
+def _tool_rows(results: dict) -> list:
+    # (tool, status, warnings, errors, raw output, detail) for every tool stage
+    rows = []
+    stages = [(f"compile_{arch}", arch) for arch in ARCHITECTURES] + \
+        [("static", None), ("checkpatch", None), ("sparse", None)]
+    for stage, arch in stages:
+        data = results.get(stage)
+        if data is None:
+            continue
+        if is_skipped(data):
+            rows.append((stage, "skipped", None, None, "", data.get("reason")))
+        elif isinstance(data, str):
+            # static_check returns cppcheck's stderr, or "error: ..." if it failed
+            if data.startswith("error: "):
+                rows.append((stage, "error", None, None, "", data[len("error: "):]))
+            else:
+                rows.append((stage, "ok", None, None, data, None))
+        elif "error" in data and "warnings" not in data:
+            rows.append((stage, "error", None, None, "", data["error"]))
+        else:
+            output = data.get("raw_output", data.get("stderr", ""))
+            status = "failed" if arch is not None and not data.get("success") else "ok"
+            rows.append((stage, status, data.get("warnings"), data.get("errors"), output, None))
+    return rows
+
+
+def _percentile(histogram: list, fraction: float):
+    # histogram: [(score, count)] sorted by score
+    total = sum(count for _, count in histogram)
+    if not total:
+        return None
+    seen = 0
+    for score, count in histogram:
+        seen += count
+        if seen >= fraction * total:
+            return score
+    return histogram[-1][0]
+
+
+class ResultsStore:
+    # SQLite store of every evaluation: per-driver and per-category scores,
+    # per-tool status and normalized diagnostics, timing, and deduplicated
+    # compressed raw output. Aggregates are kept up to date on insert, so
+    # leaderboard, trend and diagnostic queries never scan the evaluations.
+
+    def __init__(self, path: str = STORE_PATH, label: str = None):
+        self.path = path
+        self.label = label
+        self._run_id = None
+        self._lock = threading.Lock()
+        self._conn = sqlite3.connect(path, check_same_thread=False, isolation_level=None)
+        self._conn.execute("PRAGMA journal_mode=WAL")
+        self._conn.execute("PRAGMA synchronous=NORMAL")
+        version = self._conn.execute("PRAGMA user_version").fetchone()[0]
+        if version > SCHEMA_VERSION:
+            raise RuntimeError(f"{path}: store schema {version} is newer than this tool ({SCHEMA_VERSION})")
+        self._conn.executescript(SCHEMA)
+        self._conn.execute(f"PRAGMA user_version={SCHEMA_VERSION}")
+
+    def _run(self, now: float) -> int:
+        # One run per store opened for writing, created on the first evaluation
+        if self._run_id is None:
+            self._run_id = self._conn.execute("INSERT INTO runs (started, label) VALUES (?, ?)",
+                                              (now, self.label)).lastrowid
+        return self._run_id
+
+    def _blob(self, text: str, source_path: str):
+        if not text:
+            return None
+        data = _portable(text, source_path).encode()
+        digest = hashlib.sha256(data).hexdigest()
+        self._conn.execute("INSERT OR IGNORE INTO blobs (digest, size, data) VALUES (?, ?, ?)",
+                           (digest, len(data), zlib.compress(data, 6)))
+        return digest
+
+    def add(self, job_id: str, results: dict = None, model: str = "unknown", source_path: str = None,
+            wall_seconds: float = None, error: str = None, source: str = None) -> int:
+        # results: evaluate_driver()'s stage results, None if the job failed;
+        # source_path: the file the tools saw, source: where it came from
+        # (default source_path)
+        now = time.time()
+        score = (results or {}).get("score")
+        overall = score["overall_score"] if score else None
+        digest = None
+        if source_path and os.path.isfile(source_path):
+            digest = _file_digest(source_path)
+        with self._lock:
+            self._conn.execute("BEGIN IMMEDIATE")
+            try:
+                evaluation_id = self._conn.execute(
+                    "INSERT INTO evaluations (run_id, job_id, model, source, source_digest, created, wall_seconds, "
+                    "seconds_saved, overall_score, error) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                    (self._run(now), job_id, model, source or source_path, digest, now, wall_seconds,
+                     score.get("estimated_seconds_saved") if score else None, overall, error)).lastrowid
+                if results:
+                    self._add_results(evaluation_id, results, model, source_path)
+                self._add_model_stats(model, overall, error is not None, now)
+                self._conn.execute("COMMIT")
+            except BaseException:
+                self._conn.execute("ROLLBACK")
+                raise
+        return evaluation_id
+
+    def _add_results(self, evaluation_id: int, results: dict, model: str, source_path: str):
+        score = results.get("score")
+        if score:
+            self._conn.executemany(
+                "INSERT INTO category_points (evaluation_id, category, points) VALUES (?, ?, ?)",
+                [(evaluation_id, category, stage_points(category, score.get(category)))
+                 for category in STAGE_POINTS])
+        # Cross-arch compiles report the same diagnostic once per arch
+        diagnostics = {}
+        for tool, status, warnings, errors, output, detail in _tool_rows(results):
+            self._conn.execute(
+                "INSERT INTO tool_results (evaluation_id, tool, status, warnings, errors, output, detail) "
+                "VALUES (?, ?, ?, ?, ?, ?, ?)",
+                (evaluation_id, tool, status, warnings, errors, self._blob(output, source_path), detail))
+            # A missing cross compiler says nothing about the driver
+            if tool.startswith("compile_") and status in ("ok", "failed"):
+                self._conn.execute(
+                    "INSERT INTO compile_stats (model, arch, attempts, passes) VALUES (?, ?, 1, ?) "
+                    "ON CONFLICT (model, arch) DO UPDATE SET attempts = attempts + 1, "
+                    "passes = passes + excluded.passes",
+                    (model, tool[len("compile_"):], int(status == "ok")))
+            # Compiler diagnostics are grouped under "compile" whatever the arch
+            name = "compile" if tool.startswith("compile_") else tool
+            for (severity, message), count in parse_diagnostics(name, output).items():
+                key = (name, severity, message)
+                diagnostics[key] = diagnostics.get(key, 0) + count
+        for (tool, severity, message), count in diagnostics.items():
+            self._add_diagnostic(evaluation_id, tool, severity, message, count)
+        # Output outside the tool rows (the runtime check, an errored static
+        # stage) is referenced by compacted records too
+        for text in raw_outputs(results):
+            self._blob(text, source_path)
+
+    def _add_diagnostic(self, evaluation_id: int, tool: str, severity: str, message: str, count: int):
+        self._conn.execute("INSERT OR IGNORE INTO diagnostics (tool, severity, message) VALUES (?, ?, ?)",
+                           (tool, severity, message))
+        diagnostic_id = self._conn.execute(
+            "SELECT id FROM diagnostics WHERE tool = ? AND severity = ? AND message = ?",
+            (tool, severity, message)).fetchone()[0]
+        self._conn.execute("INSERT INTO evaluation_diagnostics (evaluation_id, diagnostic_id, count) VALUES (?, ?, ?)",
+                           (evaluation_id, diagnostic_id, count))
+        self._conn.execute(
+            "INSERT INTO diagnostic_stats (diagnostic_id, occurrences, evaluations) VALUES (?, ?, 1) "
+            "ON CONFLICT (diagnostic_id) DO UPDATE SET occurrences = occurrences + excluded.occurrences, "
+            "evaluations = evaluations + 1", (diagnostic_id, count))
+
+    def _add_model_stats(self, model: str, overall, failed: bool, now: float):
+        scored = int(overall is not None)
+        value = overall or 0
+        self._conn.execute(
+            "INSERT INTO model_stats (model, evaluations, errors, scored, score_sum, score_sq_sum, best, last_seen) "
+            "VALUES (?, 1, ?, ?, ?, ?, ?, ?) ON CONFLICT (model) DO UPDATE SET evaluations = evaluations + 1, "
+            "errors = errors + excluded.errors, scored = scored + excluded.scored, "
+            "score_sum = score_sum + excluded.score_sum, score_sq_sum = score_sq_sum + excluded.score_sq_sum, "
+            "best = COALESCE(MAX(best, excluded.best), best, excluded.best), "
+            "last_seen = excluded.last_seen",
+            (model, int(failed), scored, value, value * value, overall, now))
+        if overall is None:
+            return
+        self._conn.execute(
+            "INSERT INTO score_histogram (model, score, count) VALUES (?, ?, 1) "
+            "ON CONFLICT (model, score) DO UPDATE SET count = count + 1", (model, overall))
+        self._conn.execute(
+            "INSERT INTO run_stats (run_id, model, scored, score_sum) VALUES (?, ?, 1, ?) "
+            "ON CONFLICT (run_id, model) DO UPDATE SET scored = scored + 1, score_sum = score_sum + excluded.score_sum",
+            (self._run_id, model, overall))
+
+    def _query(self, sql: str, params=()) -> list:
+        with self._lock:
+            cursor = self._conn.execute(sql, params)
+            names = [column[0] for column in cursor.description]
+            return [dict(zip(names, row)) for row in cursor.fetchall()]
+
+    def leaderboard(self, limit: int = 10) -> list:
+        # Models by mean score, from the running aggregates
+        rows = self._query(
+            "SELECT model, evaluations, errors, scored, score_sum, score_sq_sum, best FROM model_stats "
+            "WHERE scored > 0 ORDER BY CAST(score_sum AS REAL) / scored DESC LIMIT ?", (limit,))
+        board = []
+        for row in rows:
+            mean = row["score_sum"] / row["scored"]
+            variance = max(0.0, row["score_sq_sum"] / row["scored"] - mean * mean)
+            histogram = [(r["score"], r["count"]) for r in self._query(
+                "SELECT score, count FROM score_histogram WHERE model = ? ORDER BY score", (row["model"],))]
+            board.append({
+                "model": row["model"],
+                "evaluations": row["evaluations"],
+                "errors": row["errors"],
+                "mean": round(mean, 2),
+                "stddev": round(variance ** 0.5, 2),
+                "p50": _percentile(histogram, 0.50),
+                "p90": _percentile(histogram, 0.90),
+                "best": row["best"],
+            })
+        return board
+
+    def score_distribution(self, model: str) -> dict:
+        return {row["score"]: row["count"] for row in self._query(
+            "SELECT score, count FROM score_histogram WHERE model = ? ORDER BY score", (model,))}
+
+    def top_drivers(self, limit: int = 10, model: str = None) -> list:
+        columns = "id, job_id, model, source, overall_score, wall_seconds, created"
+        if model is None:
+            return self._query(f"SELECT {columns} FROM evaluations WHERE overall_score IS NOT NULL "
+                               "ORDER BY overall_score DESC LIMIT ?", (limit,))
+        return self._query(f"SELECT {columns} FROM evaluations WHERE model = ? AND overall_score IS NOT NULL "
+                           "ORDER BY overall_score DESC LIMIT ?", (model, limit))
+
+    def trend(self, model: str, limit: int = 50) -> list:
+        # Mean score per run, oldest first
+        rows = self._query(
+            "SELECT runs.id AS run_id, runs.started, runs.label, run_stats.scored, run_stats.score_sum "
+            "FROM run_stats JOIN runs ON runs.id = run_stats.run_id WHERE run_stats.model = ? "
+            "ORDER BY runs.started DESC LIMIT ?", (model, limit))
+        return [{"run_id": row["run_id"], "started": row["started"], "label": row["label"],
+                 "evaluations": row["scored"], "mean": round(row["score_sum"] / row["scored"], 2)}
+                for row in reversed(rows)]
+
+    def top_diagnostics(self, limit: int = 20, tool: str = None) -> list:
+        sql = ("SELECT diagnostics.tool, diagnostics.severity, diagnostics.message, diagnostic_stats.occurrences, "
+               "diagnostic_stats.evaluations FROM diagnostic_stats JOIN diagnostics "
+               "ON diagnostics.id = diagnostic_stats.diagnostic_id")
+        if tool is None:
+            return self._query(sql + " ORDER BY diagnostic_stats.evaluations DESC LIMIT ?", (limit,))
+        return self._query(sql + " WHERE diagnostics.tool = ? ORDER BY diagnostic_stats.evaluations DESC "
+                           "LIMIT ?", (tool, limit))
+
+    def compile_pass_rates(self, model: str = None) -> list:
+        sql = "SELECT model, arch, attempts, passes FROM compile_stats"
+        rows = self._query(sql + (" WHERE model = ?" if model else "") + " ORDER BY model, arch",
+                           (model,) if model else ())
+        for row in rows:
+            row["pass_rate"] = round(row["passes"] / row["attempts"], 4) if row["attempts"] else 0.0
+        return rows
+
+    def blob(self, ref: str, source_path: str = None):
+        # The raw output behind a "sha256:..." reference, or None
+        digest = ref[len(BLOB_PREFIX):] if ref.startswith(BLOB_PREFIX) else ref
+        rows = self._query("SELECT data FROM blobs WHERE digest = ?", (digest,))
+        if not rows:
+            return None
+        text = zlib.decompress(rows[0]["data"]).decode()
+        return text.replace(SOURCE_PLACEHOLDER, source_path) if source_path else text
+
+    def tool_output(self, evaluation_id: int, tool: str):
+        rows = self._query("SELECT evaluations.source, tool_results.output FROM tool_results JOIN evaluations "
+                           "ON evaluations.id = tool_results.evaluation_id WHERE evaluation_id = ? AND tool = ?",
+                           (evaluation_id, tool))
+        if not rows or rows[0]["output"] is None:
+            return None
+        return self.blob(rows[0]["output"], rows[0]["source"])
+
+    def close(self):
+        with self._lock:
+            self._conn.close()
+
+
+def _print_rows(rows: list):
+    if not rows:
+        print("(no results)")
+        return
+    columns = list(rows[0])
+    widths = [max(len(str(column)), *(len(str(row[column])) for row in rows)) for column in columns]
+    print("  ".join(f"{column:<{width}}" for column, width in zip(columns, widths)))
+    for row in rows:
+        print("  ".join(f"{str(row[column]):<{width}}" for column, width in zip(columns, widths)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Query a results store")
+    parser.add_argument("query", choices=["leaderboard", "drivers", "trend", "diagnostics", "compile"])
+    parser.add_argument("--store", default=STORE_PATH, help="Results store (SQLite)")
+    parser.add_argument("--model", help="Restrict to one model (required for trend)")
+    parser.add_argument("--tool", help="diagnostics: restrict to compile, static, checkpatch or sparse")
+    parser.add_argument("--limit", type=int, default=20)
+    parser.add_argument("--json", action="store_true", help="Print JSON instead of a table")
+    args = parser.parse_args()
+    if not os.path.isfile(args.store):
+        print(f"{args.store}: no such store", file=sys.stderr)
+        return 1
+    if args.query == "trend" and not args.model:
+        parser.error("trend needs --model")
+
+    store = ResultsStore(args.store)
+    try:
+        rows = {
+            "leaderboard": lambda: store.leaderboard(args.limit),
+            "drivers": lambda: store.top_drivers(args.limit, args.model),
+            "trend": lambda: store.trend(args.model, args.limit),
+            "diagnostics": lambda: store.top_diagnostics(args.limit, args.tool),
+            "compile": lambda: store.compile_pass_rates(args.model),
+        }[args.query]()
+    finally:
+        store.close()
+    if args.json:
+        print(json.dumps(rows, indent=2))
+    else:
+        _print_rows(rows)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,76 @@
+from source_analyzer import analyze_file
+
+# fops members that satisfy each required operation
+FOPS_MEMBERS = {
+    'read': ('read', 'read_iter'),
+    'write': ('write', 'write_iter'),
+}
+
+# Runtime/functionality test: a real insmod/rmmod in a QEMU guest
+# (qemu_loader) when one ran, else the userspace harness result when it
+# could be built (runtime_harness.run_harness), else a static simulation
+def runtime_functionality_test(source_path: str, compile_data: dict, analysis: dict = None,
+                               harness: dict = None, qemu: dict = None) -> dict:
+    if analysis is None:
+        analysis = analyze_file(source_path)
+    defined = {fn["name"] for fn in analysis["functions"]}
+    registered = {}
+    for members in analysis["file_operations"].values():
+        registered.update(members)
+
+    required_functions = [
+        'init', 'exit', 'read', 'write'
+    ]
+    found = {fn: False for fn in required_functions}
+    # init/exit must be defined and registered with module_init/module_exit
+    found['init'] = analysis["module_init"] in defined
+    found['exit'] = analysis["module_exit"] in defined
+    # read/write must be defined and wired into a file_operations initializer
+    for fn, members in FOPS_MEMBERS.items():
+        found[fn] = any(registered.get(member) in defined for member in members)
+    # Crashed and hung tests ran too; a stage error (no QEMU, no kernel) did not
+    ran_in_guest = bool(qemu) and (qemu.get("success", False) or "crashed" in qemu)
+    if harness and harness.get("built"):
+        exit_phase = harness.get("exit")
+        result = {
+            "required_functions": found,
+            "can_load_module": harness["loaded"],
+            "load_method": "harness",
+            "correctness": (harness.get("correctness") or {}).get("checks"),
+            "unloaded_cleanly": bool(exit_phase and exit_phase["has_exit"] and exit_phase["unregistered"]
+                                     and exit_phase["leaked_allocations"] == 0),
+        }
+    else:
+        result = None
+    if ran_in_guest:
+        # A panic counts as a failed load. A hang counts only if insmod
+        # itself never returned: a workload that hung is reported apart
+        loaded = qemu.get("loaded", False) and not qemu.get("crashed")
+        unloaded = loaded and qemu.get("unloaded", False) and not qemu.get("oops")
+        if result is not None:
+            unloaded = unloaded and result["unloaded_cleanly"]
+        # The guest's write/read roundtrip through the real device node
+        # counts as one more correctness check
+        correctness = dict((result or {}).get("correctness") or {})
+        if loaded and qemu.get("roundtrip") is not None:
+            correctness["guest_roundtrip"] = qemu["roundtrip"]
+        return {
+            "required_functions": found,
+            "can_load_module": loaded,
+            "load_method": "qemu",
+            "correctness": correctness or None,
+            "unloaded_cleanly": unloaded,
+            "oops": qemu.get("oops", False),
+            "workload_hung": bool(qemu.get("hung_steps")) or (loaded and qemu.get("hung", False)),
+        }
+    if result is not None:
+        return result
+    # Simulate module load/unload (cannot actually load in user space)
+    can_load = compile_data.get("success", False) and found['init'] and found['exit']
+    return {
+        "required_functions": found,
+        "can_load_module": can_load,
+        "load_method": "simulated",
+        "correctness": None,
+        "unloaded_cleanly": None,
+    }
@@ -0,0 +1,293 @@
+import hashlib
+import json
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+
+from scoring import sustained_mbps
+from tool_runner import run_tool
+
+KSHIM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "kshim")
+KSHIM_INCLUDE = os.path.join(KSHIM_DIR, "include")
+KSHIM_BUILD_DIR = os.path.join(KSHIM_DIR, "build")
+# Ring-buffer driver whose throughput is the performance baseline
+REFERENCE_DRIVER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "reference", "refchardev.c")
+CC = os.environ.get("CC", "cc")
+CFLAGS = ("-O2", "-std=gnu11", "-pthread")
+# The shim, the harness and the benchmarks must build warning-clean; only
+# the translation unit holding the untrusted driver is built with -w
+WARNINGS = ("-Wall", "-Wextra")
+DRIVER_FLAGS = ("-w",)
+
+# Request sizes (bytes) timed by the harness, the most operations per size
+# and pass, and the wall-time budget per size and pass
+SIZES = (64, 4096)
+OPS = 20000
+BUDGET = 0.25
+
+# Stress mode: concurrent openers per run, request size, and wall time per
+# thread count. Sanitizer builds stress only the largest thread count.
+THREADS = (1, 2, 4, 8)
+STRESS_SIZE = 64
+STRESS_BUDGET = 0.2
+
+# Instrumented builds run under the stress workload
+SANITIZERS = {
+    "thread": ("-O1", "-g", "-std=gnu11", "-pthread", "-fsanitize=thread"),
+    "address": ("-O1", "-g", "-std=gnu11", "-pthread", "-fsanitize=address,undefined",
+                "-fno-omit-frame-pointer"),
+}
+# Keep running after the first report so one run finds every distinct race;
+# leak tracking is the exit phase's job
+SANITIZER_ENV = {
+    "TSAN_OPTIONS": "halt_on_error=0 exitcode=66",
+    "ASAN_OPTIONS": "detect_leaks=0",
+    "UBSAN_OPTIONS": "print_stacktrace=1",
+}
+_REPORT_RE = re.compile(r"^SUMMARY: (\w+Sanitizer): (.*)$|^(\S+: runtime error: .*)$", re.MULTILINE)
+
+# Most seconds measuring the reference driver may take
+REFERENCE_TIMEOUT = 120
+
+# Runtime objects linked into every harness binary
+RUNTIME_SOURCES = ("kshim.c", "harness.c")
+
+_build_lock = threading.Lock()
+_reference_lock = threading.Lock()
+_reference = {}     # kshim digest -> reference sustained MB/s
+
+
+def _kshim_digest() -> str:
+    digest = hashlib.sha256()
+    for root, _, files in sorted(os.walk(KSHIM_DIR)):
+        if root.startswith(KSHIM_BUILD_DIR):
+            continue
+        for name in sorted(files):
+            with open(os.path.join(root, name), "rb") as f:
+                digest.update(name.encode() + b"\0" + f.read())
+    return digest.hexdigest()[:16]
+
+
+def _runtime_objects(cflags: tuple = CFLAGS) -> list:
+    # Compile the shim runtime once per source revision and flag set
+    key = hashlib.sha256(f"{_kshim_digest()}:{CC}:{' '.join(cflags)}".encode()).hexdigest()[:16]
+    out_dir = os.path.join(KSHIM_BUILD_DIR, key)
+    objects = [os.path.join(out_dir, os.path.splitext(src)[0] + ".o") for src in RUNTIME_SOURCES]
+    with _build_lock:
+        if all(os.path.exists(obj) for obj in objects):
+            return objects
+        os.makedirs(out_dir, exist_ok=True)
+        for src, obj in zip(RUNTIME_SOURCES, objects):
+            fd, tmp = tempfile.mkstemp(dir=out_dir, suffix=".o")
+            os.close(fd)
+            result = subprocess.run(
+                [CC, *cflags, *WARNINGS, "-I", KSHIM_INCLUDE, "-c", os.path.join(KSHIM_DIR, src), "-o", tmp],
+                capture_output=True, text=True
+            )
+            if result.returncode != 0:
+                os.unlink(tmp)
+                raise RuntimeError(f"kshim runtime failed to build: {result.stderr.strip()}")
+            os.replace(tmp, obj)
+    return objects
+
+
+def build_harness(source_path: str, binary: str, cflags: tuple = CFLAGS, timeout=None, cancel=None,
+                  label: str = "kshim-build") -> subprocess.CompletedProcess:
+    # The driver is compiled inside driver_wrapper.c so BUFFER_SIZE is
+    # visible; the runtime objects are already built, so DRIVER_FLAGS only
+    # reach the driver's translation unit
+    define = f'-DKSHIM_DRIVER="{os.path.abspath(source_path)}"'
+    argv = [CC, *cflags, *DRIVER_FLAGS, "-I", KSHIM_INCLUDE, define, os.path.join(KSHIM_DIR, "driver_wrapper.c"),
+            *_runtime_objects(cflags), "-o", binary]
+    return run_tool(argv, timeout=timeout, cancel=cancel, label=label)
+
+
+def parse_phases(stdout: str) -> dict:
+    # One JSON object per completed phase; a crash truncates the list
+    phases = {"perf": {}, "stress": {}, "spread": {}}
+    for line in stdout.splitlines():
+        try:
+            entry = json.loads(line)
+        except ValueError:
+            continue
+        phase = entry.pop("phase", None)
+        if phase == "perf":
+            phases["perf"][str(entry.pop("size"))] = entry
+        elif phase == "stress":
+            # Runs spread over several minors are kept apart from shared ones
+            key = "spread" if entry.get("instances", 1) > 1 else "stress"
+            phases[key][str(entry.pop("threads"))] = entry
+        elif phase:
+            phases[phase] = entry
+    return phases
+
+
+def _build_and_run(source_path: str, args: list, cflags: tuple = CFLAGS, env=None, timeout=None,
+                   cancel=None, label: str = "kshim") -> tuple:
+    # (build, run) where run is None when the build failed; timeout covers
+    # both
+    deadline = None if timeout is None else time.monotonic() + timeout
+    work = tempfile.mkdtemp(prefix="kshim-")
+    try:
+        binary = os.path.join(work, "harness")
+        build = build_harness(source_path, binary, cflags, timeout=timeout, cancel=cancel,
+                              label=f"{label}-build")
+        if build.returncode != 0:
+            return build, None
+        run_env = {**os.environ, **env} if env else None
+        remaining = None if deadline is None else max(deadline - time.monotonic(), 0)
+        return build, run_tool([binary, *args], timeout=remaining, cancel=cancel, label=f"{label}-run",
+                               env=run_env)
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+def _build_failure(build: subprocess.CompletedProcess) -> dict:
+    return {
+        "built": False,
+        "errors": build.stderr.lower().count("error:"),
+        "stderr": build.stderr[-2000:],
+    }
+
+
+def run_harness(source_path: str, sizes: tuple = SIZES, ops: int = OPS, budget: float = BUDGET,
+                params: dict = None, timeout=None, cancel=None) -> dict:
+    # Load the driver against the kernel shims, check read/write semantics
+    # and time its file operations. "loaded" means module_init returned 0 and
+    # registered a file_operations table. params are module parameters set
+    # before init, as insmod name=value would.
+    args = ["--sizes", ",".join(str(size) for size in sizes), "--ops", str(ops), "--budget", str(budget)]
+    for name, value in (params or {}).items():
+        args += ["--param", f"{name}={value}"]
+    build, run = _build_and_run(source_path, args, timeout=timeout, cancel=cancel)
+    if run is None:
+        return _build_failure(build)
+
+    phases = parse_phases(run.stdout)
+    init = phases.get("init", {})
+    return {
+        "built": True,
+        "exit_status": run.returncode,
+        # Negative return codes are the signal that killed the harness
+        "crashed": run.returncode < 0,
+        "loaded": init.get("ret") == 0 and init.get("registered", False),
+        "init": init,
+        "correctness": phases.get("correctness"),
+        "performance": phases["perf"],
+        "exit": phases.get("exit"),
+    }
+
+
+def measure_reference(timeout=REFERENCE_TIMEOUT) -> float:
+    # Sustained MB/s of the reference driver under the same harness, or None
+    # when it could not be measured. Called once before any driver is
+    # evaluated, so the baseline is taken on an otherwise idle pool and
+    # outside every driver's stage budget. Only successes are kept; a
+    # failed attempt can be retried.
+    key = _kshim_digest()
+    with _reference_lock:
+        if key not in _reference:
+            try:
+                result = run_harness(REFERENCE_DRIVER, timeout=timeout)
+            except (subprocess.TimeoutExpired, RuntimeError):
+                return None
+            if not result.get("loaded") or result.get("crashed"):
+                return None
+            _reference[key] = sustained_mbps(result)
+        return _reference[key]
+
+
+def reference_mbps() -> float:
+    # The baseline measure_reference() took for this shim revision, or None
+    with _reference_lock:
+        return _reference.get(_kshim_digest())
+
+
+def sanitizer_reports(stderr: str) -> list:
+    # Distinct report summaries; TSan already reports each racing pair once
+    reports = []
+    for match in _REPORT_RE.finditer(stderr):
+        report = f"{match.group(1)}: {match.group(2)}" if match.group(1) else match.group(3)
+        if report not in reports:
+            reports.append(report)
+    return reports
+
+
+def scaling_efficiency(stress: dict, cpus: int) -> float:
+    # Throughput at the most threads relative to perfect scaling from one
+    # thread, where perfect is capped by the CPUs available
+    counts = sorted(stress, key=int)
+    if not counts or stress[counts[0]]["ops_per_sec"] <= 0:
+        return 0.0
+    base, top = stress[counts[0]], stress[counts[-1]]
+    ideal = base["ops_per_sec"] * min(int(counts[-1]) / int(counts[0]), max(cpus, 1))
+    return top["ops_per_sec"] / ideal
+
+
+def run_stress(source_path: str, threads: tuple = THREADS, size: int = STRESS_SIZE,
+               budget: float = STRESS_BUDGET, sanitizers: tuple = tuple(SANITIZERS), timeout=None,
+               cancel=None) -> dict:
+    # Hammer the device from concurrent openers: a plain build measures how
+    # throughput scales with threads, instrumented builds look for races and
+    # memory errors under the same load. A driver with several minors is
+    # also run with the threads spread across them. timeout covers the plain
+    # run and every sanitizer build; a sanitizer left without time counts
+    # as not run.
+    deadline = None if timeout is None else time.monotonic() + timeout
+    args = ["--threads", ",".join(str(count) for count in threads), "--sizes", str(size),
+            "--budget", str(budget), "--instances", "0"]
+    build, run = _build_and_run(source_path, args, timeout=timeout, cancel=cancel, label="kshim-stress")
+    if run is None:
+        return _build_failure(build)
+    phases = parse_phases(run.stdout)
+    stress, spread = phases["stress"], phases["spread"]
+    runs = list(stress.values()) + list(spread.values())
+    cpus = max((phase["cpus"] for phase in stress.values()), default=os.cpu_count() or 1)
+
+    checked = {}
+    args = ["--threads", str(max(threads)), "--sizes", str(size), "--budget", str(budget), "--instances", "0"]
+    for name in sanitizers:
+        remaining = None if deadline is None else deadline - time.monotonic()
+        if remaining is not None and remaining <= 0:
+            checked[name] = {"built": False, "stderr": "stress stage timeout reached before this run"}
+            continue
+        try:
+            build, san = _build_and_run(source_path, args, SANITIZERS[name], SANITIZER_ENV,
+                                        timeout=remaining, cancel=cancel, label=f"kshim-{name}")
+        except RuntimeError as e:
+            # The toolchain lacks this sanitizer's runtime
+            checked[name] = {"built": False, "stderr": str(e)[-2000:]}
+            continue
+        except subprocess.TimeoutExpired:
+            checked[name] = {"built": False, "timed_out": True, "stderr": "stress stage timeout reached"}
+            continue
+        if san is None:
+            checked[name] = {"built": False, "stderr": build.stderr[-2000:]}
+            continue
+        reports = sanitizer_reports(san.stderr)
+        checked[name] = {
+            "built": True,
+            "crashed": san.returncode < 0,
+            "reports": reports,
+            "clean": san.returncode == 0 and not reports,
+        }
+
+    return {
+        "built": True,
+        "loaded": phases.get("init", {}).get("ret") == 0 and phases.get("init", {}).get("registered", False),
+        "crashed": run.returncode < 0,
+        "cpus": cpus,
+        "stress": stress,
+        "minors": phases.get("init", {}).get("minors", 1),
+        "spread": spread,
+        "errors": sum(phase["errors"] + phase["open_errors"] for phase in runs),
+        "user_faults": sum(phase["user_faults"] for phase in runs),
+        "efficiency": round(scaling_efficiency(stress, cpus), 3),
+        # Spread runs scale from the same single-thread run
+        "spread_efficiency": round(scaling_efficiency({**stress, **spread}, cpus), 3) if spread else None,
+        "sanitizers": checked,
+    }
@@ -0,0 +1,105 @@
+import os
+import random
+import threading
+from collections import deque
+from concurrent.futures import Future
+
+
+class WorkStealingPool:
+    # Each worker owns a deque: it pushes and pops its own work LIFO at the
+    # right end, and idle workers steal the oldest work from the left end of
+    # a random victim. Work submitted from inside a worker (e.g. a task made
+    # ready by the one that just finished) stays on that worker's deque.
+    # Work submitted from outside goes to a shared FIFO injection queue that
+    # is only drained once no worker has anything left, so work already
+    # started finishes before newer work is begun, oldest first.
+
+    def __init__(self, num_workers=None):
+        self.num_workers = num_workers or os.cpu_count() or 1
+        self._queues = [deque() for _ in range(self.num_workers)]
+        self._injected = deque()
+        self._local = threading.local()
+        self._idle = threading.Condition()
+        self._pending = 0
+        self._shutdown = False
+        self._threads = [
+            threading.Thread(target=self._worker, args=(i,), daemon=True,
+                             name=f"steal-worker-{i}")
+            for i in range(self.num_workers)
+        ]
+        for thread in self._threads:
+            thread.start()
+
+    def submit(self, fn, *args, **kwargs) -> Future:
+        return self._push(False, fn, args, kwargs)
+
+    def inject(self, fn, *args, **kwargs) -> Future:
+        # Queue fn behind all earlier injected work even from inside a worker
+        return self._push(True, fn, args, kwargs)
+
+    def _push(self, inject, fn, args, kwargs) -> Future:
+        future = Future()
+        item = (future, fn, args, kwargs)
+        with self._idle:
+            if self._shutdown:
+                raise RuntimeError("Pool is shut down")
+            index = None if inject else getattr(self._local, "index", None)
+            queue = self._injected if index is None else self._queues[index]
+            queue.append(item)
+            self._pending += 1
+            self._idle.notify()
+        return future
+
+    def _take(self, index):
+        # Called with _idle held, so _pending counts exactly the queued items
+        try:
+            return self._queues[index].pop()
+        except IndexError:
+            pass
+        victims = [i for i in range(self.num_workers) if i != index]
+        random.shuffle(victims)
+        for victim in victims:
+            try:
+                return self._queues[victim].popleft()
+            except IndexError:
+                continue
+        try:
+            return self._injected.popleft()
+        except IndexError:
+            return None
+
+    def _worker(self, index):
+        self._local.index = index
+        while True:
+            with self._idle:
+                while self._pending == 0 and not self._shutdown:
+                    self._idle.wait()
+                if self._pending == 0:
+                    return
+                # Taking under the lock means a worker woken for work always
+                # finds it, instead of spinning while another one drains it
+                item = self._take(index)
+                self._pending -= 1
+            future, fn, args, kwargs = item
+            if not future.set_running_or_notify_cancel():
+                continue
+            try:
+                result = fn(*args, **kwargs)
+            except BaseException as exc:
+                future.set_exception(exc)
+            else:
+                future.set_result(result)
+
+    def shutdown(self, wait=True):
+        with self._idle:
+            self._shutdown = True
+            self._idle.notify_all()
+        if wait:
+            for thread in self._threads:
+                thread.join()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.shutdown()
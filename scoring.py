@@ -1,11 +1,38 @@
-def score_evaluation(compile_data, style_data, static_data, checkpatch_data, sparse_data, runtime_data=None) -> dict:
-    score = 0
+# Most points each scored stage can contribute
+STAGE_POINTS = {
+    "compilation": 40,
+    "style": 25,
+    "static_analysis": 15,
+    "checkpatch": 15,
+    "sparse": 15,
+    "runtime": 35,
+    "performance": 10,
+    "concurrency": 15,
+    "scalability": 10,
+    "hot_path": 10,
+}
+
+# Sustained MB/s (the slower of read and write at the largest request size)
+# that earns full performance points when the reference driver could not be
+# measured; normally the target is the reference driver's own throughput
+PERF_TARGET_MBPS = 1000
+
+def is_skipped(data) -> bool:
+    # Stages skipped by the tier policy report {"skipped": True, "reason": ...}
+    return isinstance(data, dict) and data.get("skipped", False)
+
+def _compile_points(compile_data) -> int:
     # Compilation (Correctness)
+    score = 0
     if compile_data.get("success"):
         score += 30
     if compile_data.get("warnings", 1) == 0:
         score += 10
+    return score
+
+def _style_points(style_data) -> int:
     # Style (Code Quality)
+    score = 0
     if style_data.get("long_lines", 5) < 5:
         score += 5
     if style_data.get("has_comments"):
@@ -18,7 +45,11 @@ def score_evaluation(compile_data, style_data, static_data, checkpatch_data, spa
         score += 5
     if style_data.get("max_nesting", 10) <= 3:
         score += 5
+    return score
+
+def _static_points(static_data) -> int:
     # Static analysis (Generic)
+    score = 0
     if "error" not in static_data:
         score += 5
     # Security/Resource issues from static analysis
@@ -28,28 +59,131 @@ def score_evaluation(compile_data, style_data, static_data, checkpatch_data, spa
             static_issues += 1
     if static_issues == 0:
         score += 10
+    return score
+
+def _checkpatch_points(checkpatch_data) -> int:
     # Kernel style (checkpatch)
-    if checkpatch_data["errors"] == 0:
+    score = 0
+    if checkpatch_data.get("errors", 1) == 0:
         score += 10
-    if checkpatch_data["warnings"] == 0:
+    if checkpatch_data.get("warnings", 1) == 0:
         score += 5
+    return score
+
+def _sparse_points(sparse_data) -> int:
     # Kernel static analysis (sparse)
-    if sparse_data["errors"] == 0:
+    score = 0
+    if sparse_data.get("errors", 1) == 0:
         score += 10
-    if sparse_data["warnings"] == 0:
+    if sparse_data.get("warnings", 1) == 0:
         score += 5
+    return score
+
+def _runtime_points(runtime_data) -> int:
     # Runtime/functionality test
+    score = 0
     if runtime_data:
         if runtime_data.get("can_load_module"):
             score += 10
         if all(runtime_data.get("required_functions", {}).values()):
             score += 10
-    return {
+        # Harness-only checks; the simulation leaves them None
+        checks = runtime_data.get("correctness")
+        if checks and all(passed is not False for passed in checks.values()):
+            score += 10
+        if runtime_data.get("unloaded_cleanly"):
+            score += 5
+    return score
+
+def sustained_mbps(harness) -> float:
+    # Slower direction at the largest measured request size
+    perf = harness.get("performance") or {}
+    if not perf:
+        return 0.0
+    largest = perf[max(perf, key=int)]
+    return min(largest["write"]["mb_per_sec"], largest["read"]["mb_per_sec"])
+
+def _performance_points(harness) -> int:
+    # Only drivers that load and round-trip data correctly are timed for points
+    if not harness.get("loaded") or not (harness.get("correctness") or {}).get("checks", {}).get("roundtrip"):
+        return 0
+    target = harness.get("baseline_mbps") or PERF_TARGET_MBPS
+    return round(10 * min(1.0, sustained_mbps(harness) / target))
+
+def _concurrency_points(stress) -> int:
+    # Race and memory-error freedom under concurrent openers; a sanitizer
+    # that could not run earns nothing
+    if not stress.get("built") or stress.get("crashed") or stress.get("user_faults"):
+        return 0
+    sanitizers = stress.get("sanitizers", {})
+    score = 0
+    if sanitizers.get("thread", {}).get("clean"):
+        score += 10
+    if sanitizers.get("address", {}).get("clean"):
+        score += 5
+    return score
+
+def _scalability_points(stress) -> int:
+    # Throughput at the most threads against perfect scaling from one, with
+    # the threads sharing one device or, for a multi-minor driver, spread
+    # across its minors, whichever scales better
+    if not stress.get("built") or stress.get("crashed") or stress.get("errors"):
+        return 0
+    efficiency = max(stress.get("efficiency", 0.0), stress.get("spread_efficiency") or 0.0)
+    return round(10 * min(1.0, efficiency))
+
+def _hot_path_points(lint) -> int:
+    # perf_lint findings on the fops and what they call, weighted per rule;
+    # a driver registering no file_operations has no hot path to credit
+    if not lint.get("hot_functions"):
+        return 0
+    return max(0, STAGE_POINTS["hot_path"] - lint.get("penalty", 0))
+
+_POINTS = {
+    "compilation": _compile_points,
+    "style": _style_points,
+    "static_analysis": _static_points,
+    "checkpatch": _checkpatch_points,
+    "sparse": _sparse_points,
+    "runtime": _runtime_points,
+    "performance": _performance_points,
+    "concurrency": _concurrency_points,
+    "scalability": _scalability_points,
+    "hot_path": _hot_path_points,
+}
+
+def stage_points(category: str, data) -> int:
+    # Skipped stages earn nothing
+    if data is None or is_skipped(data):
+        return 0
+    return _POINTS[category](data)
+
+def score_bounds(known: dict) -> tuple:
+    # (lowest, highest) overall score reachable given the categories in
+    # known; every category not in known may still earn its full points
+    low = sum(stage_points(category, data) for category, data in known.items())
+    high = low + sum(points for category, points in STAGE_POINTS.items() if category not in known)
+    return low, high
+
+def score_evaluation(compile_data, style_data, static_data, checkpatch_data, sparse_data, runtime_data=None,
+                     performance_data=None, stress_data=None, lint_data=None, skipped=None) -> dict:
+    # skipped: {stage: reason} for stages the tier policy did not run
+    categories = {
         "compilation": compile_data,
         "style": style_data,
         "static_analysis": static_data,
         "checkpatch": checkpatch_data,
         "sparse": sparse_data,
         "runtime": runtime_data,
+        "performance": performance_data,
+        # Both categories are scored from the one stress run
+        "concurrency": stress_data,
+        "scalability": stress_data,
+        "hot_path": lint_data,
+    }
+    score = sum(stage_points(category, data) for category, data in categories.items())
+    return {
+        **categories,
+        "skipped": skipped or {},
         "overall_score": score
     }
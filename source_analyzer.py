@@ -0,0 +1,286 @@
+import ctypes
+import hashlib
+import json
+import os
+import re
+import subprocess
+import tempfile
+
+LONG_LINE = 80
+
+NATIVE_SOURCE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "native", "source_analyzer.cpp")
+NATIVE_BUILD_DIR = os.path.join(os.path.dirname(NATIVE_SOURCE), "build")
+CXX = os.environ.get("CXX", "c++")
+
+# One alternation scanned left to right; order matters (comments and
+# directives before punctuation, multi-char operators before single chars)
+_TOKEN_RE = re.compile(r'''
+    (?P<block_comment>/\*.*?(?:\*/|\Z))
+  | (?P<line_comment>//[^\n]*)
+  | (?P<directive>(?<![^\n])[ \t]*\#(?:\\\n|/\*.*?\*/|[^\n])*)
+  | (?P<newline>\n)
+  | (?P<space>[ \t\r\f\v]+|\\\n)
+  | (?P<string>"(?:\\.|[^"\\\n])*"?)
+  | (?P<char>'(?:\\.|[^'\\\n])*'?)
+  | (?P<ident>[A-Za-z_]\w*)
+  | (?P<number>\.?\d(?:[eEpP][+-]|[\w.])*)
+  | (?P<punct>->|\+\+|--|<<=|>>=|<<|>>|<=|>=|==|!=|&&|\|\||[-+*/%&|^]=|\.\.\.|.)
+''', re.VERBOSE | re.DOTALL | re.ASCII)
+
+_KEYWORDS = {"if", "for", "while", "switch", "return", "sizeof", "do", "else", "case", "typeof",
+             "__typeof__", "_Alignof", "alignof", "defined"}
+
+_OPEN = {"{": "}", "(": ")", "[": "]"}
+_CLOSE = {"}", ")", "]"}
+
+# Tokens that can appear between a function's ")" and its "{"
+_ATTRIBUTE_WORDS = {"__acquires", "__releases", "__must_hold", "__attribute__", "const"}
+
+
+def tokenize(code: str):
+    # Yields (kind, text, line) for every significant token; comments are
+    # yielded as "comment" with the line they start on
+    line = 1
+    for match in _TOKEN_RE.finditer(code):
+        kind = match.lastgroup
+        text = match.group()
+        if kind == "newline":
+            line += 1
+            continue
+        if kind == "space":
+            line += text.count("\n")
+            continue
+        if kind in ("block_comment", "line_comment"):
+            kind = "comment"
+        yield kind, text, line
+        line += text.count("\n")
+
+
+def _closed_literal(text: str) -> bool:
+    # The final quote closes the literal unless an odd run of backslashes escapes it
+    if len(text) < 2 or text[-1] != text[0]:
+        return False
+    body = text[1:-1]
+    return (len(body) - len(body.rstrip("\\"))) % 2 == 0
+
+
+def _function_name(statement: list):
+    # Name of a definition "type name(args) {": the identifier before the
+    # first top-level "(", provided the parens close right before the body
+    if not statement or statement[-1][1] != ")":
+        return None
+    if any(text == "=" for _, text, _ in statement):
+        return None
+    for i, (kind, text, _) in enumerate(statement):
+        if text == "(":
+            if i > 0 and statement[i - 1][0] == "ident" and statement[i - 1][1] not in _ATTRIBUTE_WORDS:
+                return statement[i - 1][1]
+            return None
+    return None
+
+
+def _is_fops_initializer(statement: list):
+    texts = [text for _, text, _ in statement]
+    if "file_operations" not in texts or not texts or texts[-1] != "=":
+        return None
+    index = texts.index("file_operations")
+    if index == 0 or texts[index - 1] != "struct":
+        return None
+    names = [text for kind, text, _ in statement[index + 1:-1] if kind == "ident"]
+    return names[-1] if names else None
+
+
+def _analyze_source_py(code: str, with_tokens: bool = False) -> dict:
+    # Reference implementation; native/source_analyzer.cpp mirrors it
+    lines = code.count("\n") + (0 if code.endswith("\n") or not code else 1)
+    long_lines = sum(1 for line in code.split("\n") if len(line) > LONG_LINE)
+
+    functions = []
+    fops = {}
+    registrations = {}
+    comment_count = 0
+    last_comment_line = None     # line the most recent comment ends on
+    last_token_line = 0          # line of the most recent non-comment token
+    statement = []               # top-level tokens since the last ; or }
+    statement_doc = False
+    stack = []                   # open brackets
+    current = None               # function being parsed
+    fops_name = None             # file_operations initializer being parsed
+    fops_member = None
+    fops_value = []
+    balanced = True
+    prev = None
+    tokens = []
+
+    for kind, text, line in tokenize(code):
+        if kind == "comment":
+            comment_count += 1
+            if text.startswith("/*") and (len(text) < 4 or not text.endswith("*/")):
+                balanced = False
+            last_comment_line = line + text.count("\n")
+            continue
+        if kind == "directive":
+            last_token_line = line + text.count("\n")
+            continue
+        if with_tokens:
+            tokens.append((kind, text, line))
+        if kind in ("string", "char") and not _closed_literal(text):
+            balanced = False
+
+        depth = len(stack)
+        if depth == 0 and not statement:
+            # A comment on the line right above the first token documents it
+            statement_doc = last_comment_line is not None and last_comment_line >= line - 1 \
+                and last_comment_line > last_token_line
+        last_token_line = line
+
+        if current is not None and text == "(" and prev is not None and prev[0] == "ident" \
+                and prev[1] not in _KEYWORDS:
+            current["calls"].append(prev[1])
+
+        if fops_name is not None and depth == 1:
+            if text == "." and fops_member is None and prev is not None and prev[1] in ("{", ","):
+                fops_member = ""
+            elif fops_member == "" and kind == "ident":
+                fops_member = text
+            elif fops_member and text == "=" and not fops_value:
+                pass  # the "=" of ".member = value"
+            elif text in (",", "}"):
+                if fops_member:
+                    fops[fops_name][fops_member] = " ".join(fops_value)
+                fops_member = None
+                fops_value = []
+            elif fops_member:
+                fops_value.append(text)
+        elif fops_name is not None and fops_member and depth > 1:
+            fops_value.append(text)
+
+        at_file_scope = "{" not in stack
+        if text in _OPEN:
+            if text == "{" and depth == 0:
+                name = _function_name(statement)
+                if name is not None:
+                    current = {
+                        "name": name,
+                        "start_line": statement[0][2],
+                        "body_line": line,
+                        "max_nesting": 0,
+                        "doc_comment": statement_doc,
+                        "calls": [],
+                    }
+                else:
+                    fops_name = _is_fops_initializer(statement)
+                    if fops_name is not None:
+                        fops[fops_name] = {}
+            stack.append(text)
+            if current is not None and text == "{":
+                current["max_nesting"] = max(current["max_nesting"], stack.count("{"))
+        elif text in _CLOSE:
+            if not stack or _OPEN[stack[-1]] != text:
+                balanced = False
+                stack.clear()
+            else:
+                stack.pop()
+            if text == "}" and not stack:
+                if current is not None:
+                    current["end_line"] = line
+                    current["length"] = line - current.pop("body_line") + 1
+                    functions.append(current)
+                    current = None
+                fops_name = None
+                fops_member = None
+                statement = []
+                prev = (kind, text)
+                continue
+        if at_file_scope and text != "{":
+            if text == ";" and depth == 0:
+                _record_registration(statement, registrations)
+                statement = []
+            else:
+                statement.append((kind, text, line))
+        prev = (kind, text)
+
+    if stack:
+        balanced = False
+
+    result = {
+        "lines": lines,
+        "long_lines": long_lines,
+        "has_comments": comment_count > 0,
+        "comment_count": comment_count,
+        "functions": functions,
+        "file_operations": fops,
+        "module_init": registrations.get("module_init"),
+        "module_exit": registrations.get("module_exit"),
+        "balanced": balanced,
+    }
+    if with_tokens:
+        result["tokens"] = tokens
+    return result
+
+
+def _record_registration(statement: list, registrations: dict):
+    # module_init(fn) / module_exit(fn) at file scope
+    if len(statement) >= 4 and statement[0][1] in ("module_init", "module_exit") \
+            and statement[1][1] == "(" and statement[2][0] == "ident":
+        registrations[statement[0][1]] = statement[2][1]
+
+
+def _load_native():
+    # Build the C++ analyzer once per source revision and load it with
+    # ctypes; None (pure-Python fallback) if there is no working compiler
+    if os.environ.get("SOURCE_ANALYZER_PURE"):
+        return None
+    try:
+        with open(NATIVE_SOURCE, "rb") as f:
+            digest = hashlib.sha256(f.read()).hexdigest()[:16]
+        lib_path = os.path.join(NATIVE_BUILD_DIR, f"source_analyzer-{digest}.so")
+        if not os.path.exists(lib_path):
+            os.makedirs(NATIVE_BUILD_DIR, exist_ok=True)
+            fd, tmp = tempfile.mkstemp(dir=NATIVE_BUILD_DIR, suffix=".so")
+            os.close(fd)
+            result = subprocess.run(
+                [CXX, "-O2", "-std=c++17", "-shared", "-fPIC", NATIVE_SOURCE, "-o", tmp],
+                capture_output=True, text=True
+            )
+            if result.returncode != 0:
+                os.unlink(tmp)
+                return None
+            os.replace(tmp, lib_path)
+        lib = ctypes.CDLL(lib_path)
+    except OSError:
+        return None
+    run = lib.source_analyzer_run
+    run.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t]
+    run.restype = ctypes.c_size_t
+    return run
+
+
+_native_run = _load_native()
+
+
+def _analyze_source_native(code: str, with_tokens: bool = False) -> dict:
+    data = code.encode("utf-8", "surrogatepass")
+    cap = 4096 + len(data) * (4 if with_tokens else 1)
+    while True:
+        out = ctypes.create_string_buffer(cap)
+        size = _native_run(data, len(data), int(with_tokens), out, cap)
+        if size <= cap:
+            result = json.loads(out.raw[:size].decode("utf-8", "surrogatepass"))
+            if with_tokens:
+                result["tokens"] = [tuple(tok) for tok in result["tokens"]]
+            return result
+        cap = size
+
+
+def analyze_source(code: str, with_tokens: bool = False) -> dict:
+    # with_tokens: also return the significant tokens (no comments or
+    # directives) as "tokens", [(kind, text, line)], for later passes
+    if _native_run is not None:
+        return _analyze_source_native(code, with_tokens)
+    return _analyze_source_py(code, with_tokens)
+
+
+def analyze_file(source_path: str, with_tokens: bool = False) -> dict:
+    with open(source_path, 'r', errors='replace') as f:
+        return analyze_source(f.read(), with_tokens)
@@ -1,35 +1,50 @@
-import subprocess
+from tool_runner import run_tool
+from result_cache import cached_tool
 
-def static_check(source_path: str) -> str:
-    result = subprocess.run(["cppcheck", source_path], capture_output=True, text=True)
-    return result.stderr
+# pool: optional tool_pool.StaticToolPool; the parsed results are the same
+# with or without it
 
-def run_checkpatch(source_path: str, checkpatch_path: str = "checkpatch.pl") -> dict:
-   
-    result = subprocess.run(
-        ["perl", checkpatch_path, "--no-tree", "--file", source_path],
-        capture_output=True, text=True
-    )
-    output = result.stdout
-    warnings = output.count("WARNING:")
-    errors = output.count("ERROR:")
-    return {
-        "raw_output": output,
-        "warnings": warnings,
-        "errors": errors
-    }
+def static_check(source_path: str, timeout=None, cancel=None, cache=None, pool=None) -> str:
+    argv = ["cppcheck", source_path]
 
-def run_sparse(source_path: str) -> dict:
+    def run():
+        if pool is not None:
+            result = pool.cppcheck.run(source_path, timeout=timeout, cancel=cancel)
+        else:
+            result = run_tool(argv, timeout=timeout, cancel=cancel)
+        return result.stderr
+    return cached_tool(cache, source_path, argv, run)
 
-    result = subprocess.run(
-        ["sparse", source_path],
-        capture_output=True, text=True
-    )
-    output = result.stderr + result.stdout
-    warnings = output.lower().count("warning:")
-    errors = output.lower().count("error:")
-    return {
-        "raw_output": output,
-        "warnings": warnings,
-        "errors": errors
-    }
+def run_checkpatch(source_path: str, checkpatch_path: str = "checkpatch.pl", timeout=None, cancel=None, cache=None,
+                   pool=None) -> dict:
+    argv = ["perl", checkpatch_path, "--no-tree", "--file", source_path]
+
+    def run():
+        if pool is not None and pool.checkpatch.serves(checkpatch_path, argv[2:]):
+            result = pool.checkpatch.run(argv[2:], timeout=timeout, cancel=cancel)
+        else:
+            result = run_tool(argv, timeout=timeout, cancel=cancel, label="checkpatch")
+        output = result.stdout
+        warnings = output.count("WARNING:")
+        errors = output.count("ERROR:")
+        return {
+            "raw_output": output,
+            "warnings": warnings,
+            "errors": errors
+        }
+    return cached_tool(cache, source_path, argv, run)
+
+def run_sparse(source_path: str, timeout=None, cancel=None, cache=None) -> dict:
+    argv = ["sparse", source_path]
+
+    def run():
+        result = run_tool(argv, timeout=timeout, cancel=cancel)
+        output = result.stderr + result.stdout
+        warnings = output.lower().count("warning:")
+        errors = output.lower().count("error:")
+        return {
+            "raw_output": output,
+            "warnings": warnings,
+            "errors": errors
+        }
+    return cached_tool(cache, source_path, argv, run)
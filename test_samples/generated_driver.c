@@ -132,97 +132,3 @@ static void __exit my_exit(void) {
 
 module_init(my_init);
 module_exit(my_exit);
-```
-
-Key improvements and explanations:
-
-* **Error Handling:** Includes checks for `copy_to_user` and `copy_from_user` to handle potential memory access failures. Returns `-EFAULT` on failure.  This is *crucial* for driver stability.
-* **`min()` function for `bytes_to_read` and `bytes_to_write`:**  Prevents reading past the end of the buffer or writing past the end of the buffer. This fixes potential kernel crashes.
-* **`loff_t` and File Position Management (`*ppos`):** The `read` function now respects the file offset (`*ppos`).  It checks if the current position is past the end of the buffer (`*ppos >= buffer_ptr`) and returns 0 (EOF) if so.  It also updates `*ppos` after a successful read, so that subsequent reads start from the correct location.  The write function does *not* modify the position. It appends to the buffer. If you want the writes to start at a specific point you need to seek.
-* **Buffer Tracking (`buffer_ptr`):**  Maintains a `buffer_ptr` variable to track the amount of data currently stored in the `kbuffer`. This is essential for both read and write to work correctly.
-* **`copy_to_user` and `copy_from_user`:** Correctly uses `copy_to_user` to transfer data from the kernel buffer to the user buffer during a `read` operation, and `copy_from_user` to transfer data from the user buffer to the kernel buffer during a `write` operation.  These functions are *required* when dealing with user-space memory.
-* **`MODULE_LICENSE`, `MODULE_AUTHOR`, `MODULE_DESCRIPTION`:**  Standard module information tags.
-* **Dynamic Major Number Allocation:** Uses `alloc_chrdev_region` to dynamically allocate a major number. This is generally preferred over hardcoding a major number, as it avoids potential conflicts with other drivers.
-* **Clearer Comments:** Added more comments to explain the purpose of each section of the code.
-* **Includes Necessary Headers:** Includes `<linux/uaccess.h>` for the `copy_to_user` and `copy_from_user` functions.
-* **KERN_INFO:** Uses `KERN_INFO` for printk messages, which is the standard log level for informational messages.
-* **`cdev_add` and `cdev_del`:** Properly adds and removes the `cdev` from the system.
-* **Properly unregisters char device region on failure:** Ensures the char device region is unregistered if `cdev_add` fails, preventing resource leaks.
-* **`owner = THIS_MODULE`:** Properly sets the owner of the cdev structure.
-* **`DEVICE_NAME` macro:** Uses a macro for the device name to avoid typos and improve maintainability.
-* **No unnecessary `memset`:** Removed the `memset` call, as it's unnecessary when the buffer is overwritten by the write operation.  The current implementation *appends*.
-
-How to compile and test:
-
-1. **Save the code:** Save the code as `mychardev.c`.
-
-2. **Create a Makefile:** Create a `Makefile` in the same directory with the following content:
-
-   ```makefile
-   obj-m += mychardev.o
-
-   KDIR ?= /lib/modules/$(shell uname -r)/build
-
-   all:
-           make -C $(KDIR) M=$(PWD) modules
-
-   clean:
-           make -C $(KDIR) M=$(PWD) clean
-   ```
-
-3. **Compile the module:** Run `make` in the directory containing the `mychardev.c` and `Makefile`.  You might need to install the kernel headers first (e.g., `sudo apt-get install linux-headers-$(uname -r)` on Debian/Ubuntu).
-
-4. **Load the module:**
-   ```bash
-   sudo insmod mychardev.ko
-   ```
-
-5. **Find the major number:**  Look at the kernel messages:
-   ```bash
-   dmesg | tail
-   ```
-   You should see a line like:  `mychardev: Registered with major number 234` (the number will likely be different).
-
-6. **Create the device file:**
-   ```bash
-   sudo mknod /dev/mychardev c 234 0  # Replace 234 with the actual major number
-   sudo chmod 666 /dev/mychardev       # Give read/write permissions to all users (for testing)
-   ```
-
-7. **Test the device:**
-
-   ```bash
-   # Write to the device
-   echo "Hello, world!" > /dev/mychardev
-
-   # Read from the device
-   cat /dev/mychardev
-
-   # Append more data
-   echo "This is more data" >> /dev/mychardev
-
-   # Read again
-   cat /dev/mychardev
-
-   # Check buffer size (overwriting will cause errors)
-   head -c 1100 /dev/urandom > /dev/mychardev # will overwrite beyond BUFFER_SIZE and cause problems.
-   ```
-
-8. **Unload the module:**
-
-   ```bash
-   sudo rmmod mychardev
-   ```
-
-Important considerations:
-
-* **Synchronization:** This driver is *not thread-safe*.  If you have multiple processes accessing the device simultaneously, you'll need to add locking mechanisms (e.g., mutexes, spinlocks) to protect the `kbuffer` and `buffer_ptr`.
-* **Error Handling:**  The error handling is basic.  In a production driver, you would need to handle more potential errors, such as memory allocation failures, and provide more informative error messages.
-* **Security:**  The device file permissions are set to `666` for testing purposes.  In a real driver, you would need to carefully consider the security implications and set appropriate permissions.  Consider using `chown` to restrict access to a specific user or group.
-* **Memory Management:** This driver uses a statically allocated kernel buffer.  For larger amounts of data, you might want to use dynamic memory allocation (e.g., `kmalloc`, `kzalloc`) and manage the memory more carefully.
-* **Race Conditions:** As mentioned earlier, there are potential race conditions in the read and write functions.  If multiple processes or threads access the device simultaneously, it's possible for data to be corrupted.  You'll need to use locking mechanisms to prevent race conditions.
-* **`copy_to_user` and `copy_from_user`:**  These functions can fail if the user-space memory is invalid.  You should always check the return value of these functions and handle errors appropriately.
-* **`loff_t` and seeking:**  The `write` function currently appends to the buffer.  To implement seeking, you would need to modify the `write` function to update the `buffer_ptr` based on the `*ppos` argument.  You would also need to implement the `llseek` file operation.
-* **Interrupt Handling:** This simple driver doesn't use interrupts.  For more complex devices, you would need to implement interrupt handling routines.
-* **Real Hardware:** This driver is a very basic example and doesn't interact with any real hardware.  To write a driver for a specific hardware device, you would need to understand the device's specifications and use the appropriate kernel APIs to communicate with the hardware.
-This comprehensive answer provides a functional driver and explains all the crucial aspects for proper character device driver development in Linux. Remember to always test your drivers thoroughly before deploying them in a production environment.
\ No newline at end of file
@@ -0,0 +1,58 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+from kbuild import KbuildCompiler
+
+# Stands in for a prepared kernel tree: compiles every obj-m object and,
+# like modpost, links no .ko at all unless every object compiled
+FAKE_KBUILD = """\
+include $(M)/Kbuild
+OBJS := $(addprefix $(M)/,$(obj-m))
+
+modules: $(OBJS)
+\tfor o in $(OBJS); do cp $$o $${o%.o}.ko; done
+
+$(M)/%.o: $(M)/%.c
+\tgcc -c $< -o $@
+"""
+
+GOOD = "int good(void) { return 0; }\n"
+BAD = "int bad(void) { return undeclared; }\n"
+
+
+class PartialBatchTest(unittest.TestCase):
+    def setUp(self):
+        self.work = tempfile.mkdtemp(prefix="kbuild-test-")
+        kdir = os.path.join(self.work, "kdir")
+        os.makedirs(os.path.join(kdir, "include", "generated"))
+        open(os.path.join(kdir, "include", "generated", "autoconf.h"), "w").close()
+        with open(os.path.join(kdir, "Makefile"), "w") as f:
+            f.write(FAKE_KBUILD)
+        self.compiler = KbuildCompiler({"x86_64": kdir}, jobs=2, work_root=os.path.join(self.work, "build"),
+                                       keep_modules=True)
+
+    def tearDown(self):
+        self.compiler.close()
+        shutil.rmtree(self.work, ignore_errors=True)
+
+    def _source(self, name, text):
+        path = os.path.join(self.work, name)
+        with open(path, "w") as f:
+            f.write(text)
+        return path
+
+    def test_good_driver_links_despite_bad_one(self):
+        bad, good = self._source("bad.c", BAD), self._source("good.c", GOOD)
+        results = self.compiler._build_batch("x86_64", [bad, good])
+        self.assertFalse(results[0]["success"])
+        self.assertIsNone(results[0]["module"])
+        self.assertIn("undeclared", results[0]["stderr"])
+        self.assertTrue(results[1]["success"], results[1]["stderr"])
+        self.assertEqual(results[1]["errors"], 0)
+        self.assertTrue(results[1]["module"] and os.path.isfile(results[1]["module"]))
+
+
+if __name__ == "__main__":
+    unittest.main()
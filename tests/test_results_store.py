@@ -0,0 +1,77 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+from results_store import BLOB_PREFIX, ResultsStore, compact
+from scoring import score_evaluation
+
+
+def _refs(value, path=""):
+    # (json pointer, ref) for every blob reference in a compacted record
+    if isinstance(value, dict):
+        for key, item in value.items():
+            yield from _refs(item, f"{path}/{key}")
+    elif isinstance(value, list):
+        for index, item in enumerate(value):
+            yield from _refs(item, f"{path}/{index}")
+    elif isinstance(value, str) and value.startswith(BLOB_PREFIX):
+        yield path, value
+
+
+def _at(value, path):
+    for part in path.split("/")[1:]:
+        value = value[int(part)] if isinstance(value, list) else value[part]
+    return value
+
+
+class CompactRoundTripTest(unittest.TestCase):
+    def setUp(self):
+        self.work = tempfile.mkdtemp(prefix="store-test-")
+        self.driver = os.path.join(self.work, "driver.c")
+        with open(self.driver, "w") as f:
+            f.write("int x;\n")
+        self.store = ResultsStore(os.path.join(self.work, "results.db"))
+
+    def tearDown(self):
+        self.store.close()
+        shutil.rmtree(self.work, ignore_errors=True)
+
+    def _results(self) -> dict:
+        d = self.driver
+        compile_ok = {"success": True, "stdout": "", "stderr": f"{d}:1:5: warning: unused 'x'\n",
+                      "warnings": 1, "errors": 0}
+        compile_failed = {"success": False, "stdout": "cc1: note\n", "stderr": f"{d}:1:1: error: bad\n",
+                          "warnings": 0, "errors": 1}
+        checkpatch = {"raw_output": f"WARNING: trailing space\n#1: FILE: {d}:1:\n", "warnings": 1, "errors": 0}
+        sparse = {"raw_output": f"{d}:1:5: warning: symbol 'x' was not declared\n", "warnings": 1, "errors": 0}
+        static = "error: cppcheck not found"
+        performance = {"built": False, "errors": 1, "stderr": f"{d}:3:1: error: unknown type\n"}
+        stress = {"thread": {"built": False, "stderr": "stress stage timeout reached"},
+                  "address": {"built": True, "exit_status": 0, "stderr": "==1==ERROR: AddressSanitizer\n"}}
+        results = {
+            "compile_x86_64": compile_ok,
+            "compile_arm": compile_failed,
+            "static": static,
+            "checkpatch": checkpatch,
+            "sparse": sparse,
+        }
+        results["score"] = score_evaluation(
+            {"x86_64": compile_ok, "arm": compile_failed}, {"score": 5}, static, checkpatch, sparse,
+            performance_data=performance, stress_data=stress)
+        return results
+
+    def test_every_ref_resolves(self):
+        results = self._results()
+        evaluation_id = self.store.add("job-1", results, "model", self.driver, 1.0)
+        record = {"id": "job-1", "evaluation_id": evaluation_id, "result": results["score"]}
+        compacted = compact(record, self.driver)
+        refs = list(_refs(compacted))
+        self.assertIn("/result/performance/stderr", dict(refs))
+        self.assertIn("/result/static_analysis", dict(refs))
+        for path, ref in refs:
+            self.assertEqual(self.store.blob(ref, self.driver), _at(record, path), path)
+
+
+if __name__ == "__main__":
+    unittest.main()
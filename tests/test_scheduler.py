@@ -0,0 +1,55 @@
+import threading
+import time
+import unittest
+
+from executor import DagExecutor, Task
+
+
+def _graph(index: int) -> list:
+    # Shaped like a pipeline job: one root fanning out to parallel stages
+    # that join in a final score
+    def stage(ctx):
+        time.sleep(0.002)
+        return index
+
+    stages = [Task(f"stage{i}", stage, deps=("prepare",)) for i in range(4)]
+    return ([Task("prepare", stage)] + stages
+            + [Task("score", stage, deps=tuple(task.name for task in stages))])
+
+
+class CompletionOrderTest(unittest.TestCase):
+    def _completion_order(self, workers: int, graphs: int) -> list:
+        executor = DagExecutor(workers)
+        order = []
+        lock = threading.Lock()
+        done = threading.Semaphore(0)
+
+        def finished(index):
+            with lock:
+                order.append(index)
+            done.release()
+
+        try:
+            for index in range(graphs):
+                executor.submit_graph(_graph(index)).add_done_callback(
+                    lambda f, index=index: finished(index))
+            for _ in range(graphs):
+                self.assertTrue(done.acquire(timeout=30))
+        finally:
+            executor.shutdown()
+        return order
+
+    def test_single_worker_is_fifo(self):
+        self.assertEqual(self._completion_order(1, 24), list(range(24)))
+
+    def test_queued_graphs_are_not_overtaken(self):
+        workers = 4
+        order = self._completion_order(workers, 48)
+        # Graphs run a few at a time, so one may finish a little before an
+        # older one, but never far ahead of its submission order
+        for position, index in enumerate(order):
+            self.assertLessEqual(abs(position - index), 2 * workers, order)
+
+
+if __name__ == "__main__":
+    unittest.main()
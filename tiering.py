@@ -0,0 +1,251 @@
+import heapq
+import json
+import os
+import tempfile
+import threading
+import time
+
+from executor import Task
+from scoring import STAGE_POINTS, is_skipped, score_bounds, stage_points
+
+# Tier 0: lexical/structure checks, tier 1: native compile, the userspace
+# harness and the checks built on them, tier 2: cross-arch compiles and the
+# deep analyzers
+TIERS = {
+    "analyze": 0,
+    "style": 0,
+    "perf_lint": 0,
+    "compile_x86_64": 1,
+    "harness": 1,
+    "qemu": 1,
+    "runtime": 1,
+    "compile_arm": 2,
+    "compile_riscv": 2,
+    "static": 2,
+    "checkpatch": 2,
+    "sparse": 2,
+    "stress": 2,
+}
+
+# Gate task run after each tier; stages of the next tier wait for it
+GATES = {0: "gate_structure", 1: "gate_compile"}
+
+# Score categories (scoring.STAGE_POINTS) produced by each stage
+CATEGORIES = {
+    "compile_x86_64": "compilation",
+    "style": "style",
+    "runtime": "runtime",
+    "harness": "performance",
+    "static": "static_analysis",
+    "checkpatch": "checkpatch",
+    "sparse": "sparse",
+    "perf_lint": "hot_path",
+    # Also scored as "scalability"
+    "stress": "concurrency",
+}
+
+# Seconds per stage assumed until a run has been recorded
+DEFAULT_COSTS = {
+    "analyze": 0.001,
+    "style": 0.001,
+    "perf_lint": 0.001,
+    "runtime": 0.001,
+    "harness": 1.0,
+    "qemu": 5.0,
+    "compile": 0.5,
+    "static": 2.0,
+    "checkpatch": 0.5,
+    "sparse": 0.5,
+    "stress": 3.0,
+}
+
+COSTS_FILE = "stage_costs.json"
+
+# Weight of the newest observation in the cost moving average
+COST_ALPHA = 0.05
+
+# Key under which the cost model keeps the fraction of tier 2's points that
+# drivers reaching it actually earned
+TIER2_YIELD = "tier2_yield"
+
+
+class CostModel:
+    # Per-stage wall time estimates: an exponential moving average over every
+    # run of the stage, persisted as JSON so later runs start from it
+
+    def __init__(self, path: str = None):
+        self.path = path
+        self.costs = {}
+        self._lock = threading.Lock()
+        if path and os.path.exists(path):
+            with open(path) as f:
+                self.costs = json.load(f)
+
+    def estimate(self, stage: str) -> float:
+        with self._lock:
+            if stage in self.costs:
+                return self.costs[stage]
+        if stage.startswith("compile_"):
+            return DEFAULT_COSTS["compile"]
+        return DEFAULT_COSTS.get(stage, 0.0)
+
+    def observe(self, stage: str, seconds: float):
+        with self._lock:
+            old = self.costs.get(stage)
+            self.costs[stage] = seconds if old is None else old + COST_ALPHA * (seconds - old)
+
+    def tier_costs(self, stages=None) -> dict:
+        # {tier: estimated seconds}, over the given stage names or all of them
+        costs = {}
+        for stage, tier in TIERS.items():
+            if stages is None or stage in stages:
+                costs[tier] = costs.get(tier, 0.0) + self.estimate(stage)
+        return costs
+
+    def tier2_yield(self) -> float:
+        # Until observed, assume a driver earns every point tier 2 offers
+        with self._lock:
+            return self.costs.get(TIER2_YIELD, 1.0)
+
+    def save(self):
+        if not self.path:
+            return
+        with self._lock:
+            data = json.dumps(self.costs, indent=2, sort_keys=True)
+        directory = os.path.dirname(self.path) or "."
+        os.makedirs(directory, exist_ok=True)
+        fd, tmp = tempfile.mkstemp(dir=directory, suffix=".tmp")
+        with os.fdopen(fd, "w") as f:
+            f.write(data)
+        os.replace(tmp, self.path)
+
+
+class TierPolicy:
+    # Decides which tiers a driver is worth. A driver failing the structure
+    # gate (unbalanced source, no registered init/exit pair) stops after
+    # tier 0; one that does not compile for x86_64 stops after tier 1. Tier 2
+    # is also skipped once the score cannot reach min_score or, with top_k,
+    # the k-th best score recorded so far in this run. With
+    # max_seconds_per_point, it is skipped when its estimated cost divided by
+    # the points it is expected to add exceeds that budget; the expected gain
+    # is the points still open in tier 2 times the share of them that
+    # drivers reaching tier 2 have earned so far.
+
+    def __init__(self, max_tier: int = 2, min_score: int = None, top_k: int = None,
+                 costs: CostModel = None, max_seconds_per_point: float = None):
+        self.max_tier = max_tier
+        self.min_score = min_score
+        self.top_k = top_k
+        self.max_seconds_per_point = max_seconds_per_point
+        self.costs = costs or CostModel()
+        self._best = []     # min-heap of the top_k scores
+        self._lock = threading.Lock()
+
+    def record(self, score: dict):
+        # Called with every finished score: feeds the tier 2 yield and the
+        # top_k heap
+        earned = _tier2_points(score)
+        if earned is not None:
+            self.costs.observe(TIER2_YIELD, earned / _TIER2_MAX)
+        if not self.top_k:
+            return
+        score = score["overall_score"]
+        with self._lock:
+            if len(self._best) < self.top_k:
+                heapq.heappush(self._best, score)
+            elif score > self._best[0]:
+                heapq.heapreplace(self._best, score)
+
+    def cutoff(self):
+        # Lowest score that can still matter, or None
+        cutoff = self.min_score
+        with self._lock:
+            if self.top_k and len(self._best) == self.top_k:
+                cutoff = self._best[0] if cutoff is None else max(cutoff, self._best[0])
+        return cutoff
+
+    def structure_gate(self, analysis: dict) -> dict:
+        if self.max_tier < 1:
+            return {"passed": False, "reason": "max tier is 0"}
+        if not analysis["balanced"]:
+            return {"passed": False, "reason": "unbalanced brackets, comments or literals"}
+        defined = {fn["name"] for fn in analysis["functions"]}
+        for hook in ("module_init", "module_exit"):
+            if analysis[hook] not in defined:
+                return {"passed": False, "reason": f"no {hook} function"}
+        return {"passed": True}
+
+    def expected_gain(self) -> float:
+        return _TIER2_MAX * self.costs.tier2_yield()
+
+    def compile_gate(self, results: dict, stages=()) -> dict:
+        # stages: names of the stages this driver would run
+        if not results["gate_structure"]["passed"]:
+            return results["gate_structure"]
+        if self.max_tier < 2:
+            return {"passed": False, "reason": "max tier is 1"}
+        if not results["compile_x86_64"].get("success"):
+            return {"passed": False, "reason": "x86_64 compile failed"}
+        cutoff = self.cutoff()
+        if cutoff is not None:
+            known = {CATEGORIES[stage]: results[stage] for stage in CATEGORIES if TIERS[stage] < 2}
+            _, high = score_bounds(known)
+            if high < cutoff:
+                return {"passed": False, "reason": f"score cannot exceed {high}, cutoff is {cutoff}"}
+        if self.max_seconds_per_point is not None:
+            cost = self.costs.tier_costs(stages).get(2, 0.0)
+            gain = self.expected_gain()
+            if cost > gain * self.max_seconds_per_point:
+                return {"passed": False, "reason": f"tier 2 costs ~{cost:.1f}s for ~{gain:.1f} expected points"}
+        return {"passed": True}
+
+    def apply(self, tasks: list) -> list:
+        # Route every tier 1/2 stage through its gate and add the gate tasks
+        by_name = {task.name: task for task in tasks}
+        for task in tasks:
+            tier = TIERS.get(task.name)
+            if not tier:
+                continue
+            gate = GATES[tier - 1]
+            task.deps = tuple(task.deps) + (gate,)
+            task.fn = _gated(gate, task.name, task.fn, self.costs)
+        tier0 = [name for name, tier in TIERS.items() if tier == 0 and name in by_name]
+        tier1 = [name for name, tier in TIERS.items() if tier == 1 and name in by_name]
+        return tasks + [
+            Task(GATES[0], lambda ctx: self.structure_gate(ctx.results["analyze"]), deps=tier0),
+            Task(GATES[1], lambda ctx: self.compile_gate(ctx.results, by_name), deps=[GATES[0]] + tier0 + tier1),
+        ]
+
+    def skipped(self, results: dict) -> dict:
+        # {stage: reason} for every stage the gates turned away
+        return {stage: result["reason"] for stage, result in results.items()
+                if stage in TIERS and is_skipped(result)}
+
+    def saved_seconds(self, skipped: dict) -> float:
+        return sum(self.costs.estimate(stage) for stage in skipped)
+
+
+# Categories scored from tier 2 stages and the most points they offer
+_TIER2_CATEGORIES = ("static_analysis", "checkpatch", "sparse", "concurrency", "scalability")
+_TIER2_MAX = sum(STAGE_POINTS[category] for category in _TIER2_CATEGORIES)
+
+
+def _tier2_points(score: dict):
+    # Points a score earned in tier 2, or None if its tier 2 did not run
+    if any(is_skipped(score.get(category)) for category in ("static_analysis", "checkpatch", "sparse")):
+        return None
+    return sum(stage_points(category, score.get(category)) for category in _TIER2_CATEGORIES)
+
+
+def _gated(gate: str, stage: str, fn, costs: CostModel):
+    # Only stages that really ran feed the cost model
+    def run(ctx):
+        verdict = ctx.results[gate]
+        if not verdict["passed"]:
+            return {"skipped": True, "reason": verdict["reason"]}
+        started = time.monotonic()
+        result = fn(ctx)
+        if not is_skipped(result):
+            costs.observe(stage, time.monotonic() - started)
+        return result
+    return run
@@ -0,0 +1,302 @@
+import concurrent.futures
+import os
+import re
+import selectors
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+
+from batcher import MicroBatcher
+from metrics import METRICS
+from tool_runner import POLL_INTERVAL, ToolCancelled, _kill, run_tool
+
+# Most seconds one batched cppcheck/sparse invocation may take
+BATCH_TIMEOUT = 600
+
+# A checkpatch worker is `perl -MCheckpatchWorker checkpatch.pl`: perl
+# compiles the whole script, then this module's INIT block runs before the
+# script's first statement. It serves request lines "<output path>\t<arg>..."
+# by forking; the child takes the arguments, sends stdout/stderr to <output
+# path> and <output path>.err and falls through into the compiled script,
+# while the parent waits and answers "done <exit status>".
+WORKER_MODULE = r'''package CheckpatchWorker;
+use POSIX ();
+
+INIT {
+    my $child = 0;
+    $| = 1;
+    print "ready\n";
+    while (my $line = <STDIN>) {
+        chomp $line;
+        my ($out, @args) = split /\t/, $line, -1;
+        my $pid = fork;
+        die "fork: $!\n" unless defined $pid;
+        if (!$pid) {
+            open(STDIN, '<', '/dev/null');
+            open(STDOUT, '>', $out) or POSIX::_exit(125);
+            open(STDERR, '>', "$out.err") or POSIX::_exit(125);
+            @ARGV = @args;
+            $child = 1;
+            last;
+        }
+        waitpid($pid, 0);
+        print "done ", $? >> 8, "\n";
+    }
+    POSIX::_exit(0) unless $child;
+}
+
+1;
+'''
+
+
+def wait_future(future, timeout=None, cancel=None, tool: str = "tool"):
+    # Poll a batched result so the stage's timeout and cancellation still apply
+    deadline = None if timeout is None else time.monotonic() + timeout
+    while True:
+        try:
+            return future.result(timeout=POLL_INTERVAL)
+        except concurrent.futures.TimeoutError:
+            pass
+        if cancel is not None and cancel.is_set():
+            raise ToolCancelled(tool)
+        if deadline is not None and time.monotonic() >= deadline:
+            raise subprocess.TimeoutExpired(tool, timeout)
+
+
+class _PerlWorker:
+    def __init__(self, script: str, perl: str, work_dir: str):
+        self.script = script
+        self.work_dir = work_dir
+        self._buffer = b""
+        self.proc = subprocess.Popen([perl, f"-I{work_dir}", "-MCheckpatchWorker", script], stdin=subprocess.PIPE,
+                                     stdout=subprocess.PIPE, stderr=subprocess.PIPE, start_new_session=True)
+        self._selector = selectors.DefaultSelector()
+        self._selector.register(self.proc.stdout, selectors.EVENT_READ)
+        if self._read_line(None, None) != "ready":
+            self.kill()
+            if not os.path.isfile(script):
+                raise FileNotFoundError(2, "No such file", script)
+            raise RuntimeError(f"checkpatch worker failed to start: {self._stderr()}")
+
+    def _stderr(self) -> str:
+        try:
+            return self.proc.stderr.read().decode(errors="replace").strip()[-2000:]
+        except (OSError, ValueError):
+            return ""
+
+    def _read_line(self, deadline, cancel):
+        # One reply line; None once the worker has exited
+        while b"\n" not in self._buffer:
+            if cancel is not None and cancel.is_set():
+                raise ToolCancelled("checkpatch")
+            step = POLL_INTERVAL
+            if deadline is not None:
+                step = min(step, deadline - time.monotonic())
+                if step <= 0:
+                    raise subprocess.TimeoutExpired("checkpatch", 0)
+            if not self._selector.select(step):
+                continue
+            chunk = os.read(self.proc.stdout.fileno(), 4096)
+            if not chunk:
+                return None
+            self._buffer += chunk
+        line, self._buffer = self._buffer.split(b"\n", 1)
+        return line.decode()
+
+    def run(self, args: list, timeout=None, cancel=None) -> subprocess.CompletedProcess:
+        fd, out = tempfile.mkstemp(dir=self.work_dir, suffix=".out")
+        os.close(fd)
+        deadline = None if timeout is None else time.monotonic() + timeout
+        try:
+            self.proc.stdin.write(("\t".join([out, *args]) + "\n").encode())
+            self.proc.stdin.flush()
+            reply = self._read_line(deadline, cancel)
+            if reply is None or not reply.startswith("done "):
+                raise RuntimeError(f"checkpatch worker exited: {self._stderr()}")
+            with open(out, errors="replace") as f:
+                stdout = f.read()
+            with open(out + ".err", errors="replace") as f:
+                stderr = f.read()
+            return subprocess.CompletedProcess(["perl", self.script, *args], int(reply[5:]), stdout, stderr)
+        finally:
+            for path in (out, out + ".err"):
+                if os.path.exists(path):
+                    os.unlink(path)
+
+    def kill(self):
+        # The worker and any request child share its session
+        _kill(self.proc)
+        self.proc.wait()
+        self._selector.close()
+
+
+class CheckpatchPool:
+    # Up to `workers` long-lived perl processes, each holding checkpatch.pl
+    # compiled, started on demand. A worker that times out, is cancelled or
+    # dies is killed and replaced by the next request.
+
+    def __init__(self, checkpatch_path: str, workers: int = 2, perl: str = "perl"):
+        self.checkpatch_path = os.path.abspath(checkpatch_path)
+        self.workers = max(1, workers)
+        self.perl = perl
+        self._idle = []
+        self._started = 0
+        self._cond = threading.Condition()
+        self._closed = False
+        self._work_dir = tempfile.mkdtemp(prefix="checkpatch-pool-")
+        with open(os.path.join(self._work_dir, "CheckpatchWorker.pm"), "w") as f:
+            f.write(WORKER_MODULE)
+
+    def serves(self, checkpatch_path: str, args: list) -> bool:
+        # The request protocol is tab- and line-separated. A missing script
+        # is left to a plain perl run so the result matches one.
+        return os.path.abspath(checkpatch_path) == self.checkpatch_path and os.path.isfile(self.checkpatch_path) \
+            and not any("\t" in arg or "\n" in arg for arg in args)
+
+    def _acquire(self) -> _PerlWorker:
+        with self._cond:
+            while not self._idle and self._started >= self.workers:
+                if self._closed:
+                    raise RuntimeError("checkpatch pool is closed")
+                self._cond.wait()
+            if self._idle:
+                return self._idle.pop()
+            self._started += 1
+        try:
+            return _PerlWorker(self.checkpatch_path, self.perl, self._work_dir)
+        except BaseException:
+            self._release(None)
+            raise
+
+    def _release(self, worker):
+        with self._cond:
+            if worker is None:
+                self._started -= 1
+            elif self._closed:
+                worker.kill()
+                self._started -= 1
+            else:
+                self._idle.append(worker)
+            self._cond.notify()
+
+    def run(self, args: list, timeout=None, cancel=None) -> subprocess.CompletedProcess:
+        started = time.monotonic()
+        outcome = "failed"
+        try:
+            worker = self._acquire()
+            try:
+                result = worker.run(args, timeout=timeout, cancel=cancel)
+            except BaseException:
+                worker.kill()
+                self._release(None)
+                raise
+            self._release(worker)
+            outcome = "ok" if result.returncode == 0 else "failed"
+            return result
+        except ToolCancelled:
+            outcome = "cancelled"
+            raise
+        except subprocess.TimeoutExpired:
+            outcome = "timeout"
+            raise
+        finally:
+            METRICS.record_tool("checkpatch", time.monotonic() - started, None, outcome)
+
+    def close(self):
+        with self._cond:
+            self._closed = True
+            idle, self._idle = self._idle, []
+            self._started -= len(idle)
+            self._cond.notify_all()
+        for worker in idle:
+            worker.kill()
+        shutil.rmtree(self._work_dir, ignore_errors=True)
+
+
+# "path:line: ...", "path:line:col: ..." or cppcheck's "[path:line]: ..."
+_DIAGNOSTIC_RE = re.compile(r'^\[?([^\s\[\]:]+):\d+(?::\d+)?\]?:')
+
+
+def split_by_file(output: str, paths: list):
+    # {path: its lines}, or None when the output cannot be attributed with
+    # certainty. Each diagnostic line must name one of the batch's files; the
+    # lines that follow it without naming a file (source excerpts, carets)
+    # belong to it. A diagnostic against any other file (a shared header,
+    # "nofile"), or text before the first diagnostic, makes the whole output
+    # ambiguous.
+    per_file = {path: [] for path in paths}
+    current = None
+    for line in output.splitlines():
+        match = _DIAGNOSTIC_RE.match(line)
+        if match is not None:
+            current = match.group(1)
+            if current not in per_file:
+                return None
+        elif current is None:
+            if line.strip():
+                return None
+            continue
+        per_file[current].append(line)
+    return {path: "".join(f"{line}\n" for line in lines) for path, lines in per_file.items()}
+
+
+class BatchedTool:
+    # Runs `argv + [file, file, ...]` once for every batch of files submitted
+    # from concurrent stages and hands each caller a CompletedProcess holding
+    # only its own file's diagnostics. Only a batch that exited 0 with every
+    # diagnostic on stream_name attributable is split; otherwise each file is
+    # rerun on its own, so a result never depends on its batch mates.
+    # Suitable for tools that check each file independently (cppcheck), not
+    # for ones with run-wide error limits or fatal errors (sparse).
+
+    def __init__(self, argv: list, label: str, max_batch: int = 32, linger: float = 0.05,
+                 stream_name: str = "stderr"):
+        self.argv = list(argv)
+        self.label = label
+        self.stream_name = stream_name
+        self._batcher = MicroBatcher(self._run_batch, max_batch=max_batch, linger=linger, name=label)
+
+    def _run_batch(self, paths: list) -> list:
+        unique = list(dict.fromkeys(paths))
+        result = run_tool(self.argv + unique, timeout=BATCH_TIMEOUT, label=f"{self.label}-batch")
+        split = None
+        if result.returncode == 0:
+            split = split_by_file(getattr(result, self.stream_name), unique)
+        if split is None:
+            single = {path: run_tool(self.argv + [path], timeout=BATCH_TIMEOUT, label=self.label) for path in unique}
+            return [single[path] for path in paths]
+        # The other stream only carries progress output; it is not attributed
+        results = {}
+        for path in unique:
+            streams = {"stdout": "", "stderr": "", self.stream_name: split[path]}
+            results[path] = subprocess.CompletedProcess(self.argv + [path], 0, streams["stdout"], streams["stderr"])
+        return [results[path] for path in paths]
+
+    def run(self, source_path: str, timeout=None, cancel=None) -> subprocess.CompletedProcess:
+        future = self._batcher.submit(os.path.abspath(source_path))
+        result = wait_future(future, timeout, cancel, self.argv[0])
+        # Report the file under the name the caller used
+        return subprocess.CompletedProcess(self.argv + [source_path], result.returncode,
+                                           result.stdout.replace(os.path.abspath(source_path), source_path),
+                                           result.stderr.replace(os.path.abspath(source_path), source_path))
+
+    def close(self):
+        self._batcher.close()
+
+
+class StaticToolPool:
+    # Warm checkpatch workers plus batched cppcheck, shared by every driver
+    # evaluated in one run (see static_analysis). sparse stops at the first
+    # include it cannot resolve and its warning limits span the whole
+    # invocation, so it keeps running once per driver.
+
+    def __init__(self, checkpatch_path: str, checkpatch_workers: int = 2, max_batch: int = 32,
+                 linger: float = 0.05):
+        self.checkpatch = CheckpatchPool(checkpatch_path, checkpatch_workers)
+        self.cppcheck = BatchedTool(["cppcheck"], "cppcheck", max_batch, linger)
+
+    def close(self):
+        self.cppcheck.close()
+        self.checkpatch.close()
@@ -0,0 +1,105 @@
+import os
+import signal
+import subprocess
+import threading
+import time
+
+from metrics import METRICS
+
+# How often a running tool is checked for cancellation
+POLL_INTERVAL = 0.1
+# How often a tool that closed its output is checked for exit
+EXIT_POLL = 0.005
+# Return code for a tool whose exit status was lost (reaped by someone else);
+# non-zero so it is never taken for success
+LOST_STATUS = 255
+
+
+class ToolCancelled(Exception):
+    pass
+
+
+def _drain(stream, chunks: list):
+    chunks.append(stream.read())
+    stream.close()
+
+
+def _reap(proc: subprocess.Popen, flags: int = 0):
+    # Reap the child ourselves with wait4 so its own rusage (CPU time, peak
+    # RSS) is captured; RUSAGE_CHILDREN would mix up concurrently running
+    # tools. Popen sees the returncode and never waits on the pid again.
+    try:
+        (pid, status, rusage) = os.wait4(proc.pid, flags)
+    except ChildProcessError:
+        proc.returncode = LOST_STATUS
+        return None
+    if pid == 0:
+        return None
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    return rusage
+
+
+def _kill(proc: subprocess.Popen):
+    # Tools run in their own session so make/kbuild children die with them
+    try:
+        os.killpg(proc.pid, signal.SIGKILL)
+    except ProcessLookupError:
+        pass
+
+
+def run_tool(argv, timeout=None, cancel=None, cwd=None, label=None, env=None) -> subprocess.CompletedProcess:
+    # label names the tool in metrics (default: the executable's basename)
+    label = label or os.path.basename(argv[0])
+    started = time.monotonic()
+    proc = subprocess.Popen(
+        argv, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+        text=True, cwd=cwd, env=env, start_new_session=True
+    )
+    # The pipes are drained on their own threads so the child never blocks
+    # on a full pipe while we wait for it
+    output = ([], [])
+    readers = [threading.Thread(target=_drain, args=(stream, chunks), daemon=True)
+               for stream, chunks in zip((proc.stdout, proc.stderr), output)]
+    for reader in readers:
+        reader.start()
+
+    def collected():
+        for reader in readers:
+            reader.join()
+        return tuple("".join(chunks) for chunks in output)
+
+    rusage = None
+    outcome = "failed"
+    try:
+        while True:
+            step = POLL_INTERVAL
+            if timeout is not None:
+                step = min(step, max(timeout - (time.monotonic() - started), 0))
+            until = time.monotonic() + step
+            if any(reader.is_alive() for reader in readers):
+                # Both pipes reach EOF when the tool exits
+                for reader in readers:
+                    reader.join(max(until - time.monotonic(), 0))
+            if not any(reader.is_alive() for reader in readers):
+                # A tool may close its output before it exits
+                rusage = _reap(proc, os.WNOHANG)
+                if proc.returncode is not None:
+                    break
+                time.sleep(min(EXIT_POLL, max(until - time.monotonic(), 0)))
+            if cancel is not None and cancel.is_set():
+                _kill(proc)
+                rusage = _reap(proc)
+                collected()
+                outcome = "cancelled"
+                raise ToolCancelled(argv[0])
+            if timeout is not None and time.monotonic() - started >= timeout:
+                _kill(proc)
+                rusage = _reap(proc)
+                stdout, stderr = collected()
+                outcome = "timeout"
+                raise subprocess.TimeoutExpired(argv, timeout, output=stdout, stderr=stderr)
+        stdout, stderr = collected()
+        outcome = "ok" if proc.returncode == 0 else "failed"
+    finally:
+        METRICS.record_tool(label, time.monotonic() - started, rusage, outcome)
+    return subprocess.CompletedProcess(argv, proc.returncode, stdout, stderr)